@@ -0,0 +1,72 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "utils.h"
+
+// Architecture traits map the kinds of dynamic relocations sold handles to
+// the relocation types of each architecture. Code for relocations is
+// written once as templates over them.
+struct X86_64Traits {
+    static constexpr Elf_Half kMachine = EM_X86_64;
+    static constexpr uint32_t kNone = R_X86_64_NONE;
+    static constexpr uint32_t kRelative = R_X86_64_RELATIVE;
+    static constexpr uint32_t kAbsolute = R_X86_64_64;
+    static constexpr uint32_t kGlobDat = R_X86_64_GLOB_DAT;
+    static constexpr uint32_t kJumpSlot = R_X86_64_JUMP_SLOT;
+    static constexpr uint32_t kCopy = R_X86_64_COPY;
+    static constexpr uint32_t kTLSModule = R_X86_64_DTPMOD64;
+    static constexpr uint32_t kTLSDTPOffset = R_X86_64_DTPOFF64;
+    static constexpr uint32_t kTLSTPOffset = R_X86_64_TPOFF64;
+    static constexpr uint32_t kTLSDesc = R_X86_64_TLSDESC;
+    static constexpr uint32_t kIRelative = R_X86_64_IRELATIVE;
+    // Whether DTPMOD, DTPOFF and TPOFF relocations are handled. They are
+    // tested only on x86-64.
+    static constexpr bool kTraditionalTLS = true;
+};
+
+struct AArch64Traits {
+    static constexpr Elf_Half kMachine = EM_AARCH64;
+    static constexpr uint32_t kNone = R_AARCH64_NONE;
+    static constexpr uint32_t kRelative = R_AARCH64_RELATIVE;
+    static constexpr uint32_t kAbsolute = R_AARCH64_ABS64;
+    static constexpr uint32_t kGlobDat = R_AARCH64_GLOB_DAT;
+    static constexpr uint32_t kJumpSlot = R_AARCH64_JUMP_SLOT;
+    static constexpr uint32_t kCopy = R_AARCH64_COPY;
+    static constexpr uint32_t kTLSModule = R_AARCH64_TLS_DTPMOD;
+    static constexpr uint32_t kTLSDTPOffset = R_AARCH64_TLS_DTPREL;
+    static constexpr uint32_t kTLSTPOffset = R_AARCH64_TLS_TPREL;
+    static constexpr uint32_t kTLSDesc = R_AARCH64_TLSDESC;
+    static constexpr uint32_t kIRelative = R_AARCH64_IRELATIVE;
+    static constexpr bool kTraditionalTLS = false;
+};
+
+// WithArch calls `f` with the traits of `machine`. `f` is usually a generic
+// lambda, which is instantiated for each architecture.
+template <class F>
+void WithArch(Elf_Half machine, F f) {
+    switch (machine) {
+        case EM_X86_64:
+            f(X86_64Traits());
+            break;
+        case EM_AARCH64:
+            f(AArch64Traits());
+            break;
+        default:
+            LOG(FATAL) << "sold does not support " << SOLD_LOG_KEY(machine) << ".";
+    }
+}
@@ -0,0 +1,71 @@
+#! /bin/bash -eu
+
+# Throws exceptions through frames of two bundled libraries and compares the
+# time per throw of the original executable and its sold output. Fails when
+# they catch different exceptions. The time is only reported unless
+# UNWIND_MAX_RATIO is set, in which case the script also fails when the
+# output is more than UNWIND_MAX_RATIO times slower.
+
+cd "$(dirname "$0")"
+mkdir -p out
+
+cat > out/unwind_thrower.cc <<EOS
+#include <stdexcept>
+__attribute__((noinline)) void Throw(int depth) {
+    if (depth == 0) throw std::runtime_error("unwind");
+    Throw(depth - 1);
+    asm volatile("");
+}
+EOS
+cat > out/unwind_middle.cc <<EOS
+void Throw(int depth);
+__attribute__((noinline)) void Middle(int depth) {
+    if (depth == 0) {
+        Throw(8);
+        return;
+    }
+    Middle(depth - 1);
+    asm volatile("");
+}
+EOS
+cat > out/unwind_main.cc <<EOS
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+void Middle(int depth);
+int main(int argc, char** argv) {
+    const int n = atoi(argv[1]);
+    int caught = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        try {
+            Middle(8);
+        } catch (const std::runtime_error& e) {
+            caught++;
+        }
+    }
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("%d %lld\n", caught, static_cast<long long>(ns / n));
+}
+EOS
+
+g++ -O2 -fPIC -shared -Wl,-soname,libunwind_thrower.so -o out/libunwind_thrower.so out/unwind_thrower.cc
+g++ -O2 -fPIC -shared -Wl,-soname,libunwind_middle.so -o out/libunwind_middle.so out/unwind_middle.cc -Lout -lunwind_thrower
+g++ -O2 -o out/unwind_main out/unwind_main.cc -Lout -lunwind_middle -lunwind_thrower
+LD_LIBRARY_PATH=out ${SOLD:-../build/sold} out/unwind_main -o out/unwind_main.soldout --section-headers --check-output
+
+n=${NUM_THROWS:-20000}
+read -r original_caught original_ns <<< "$(LD_LIBRARY_PATH=out out/unwind_main $n)"
+read -r sold_caught sold_ns <<< "$(out/unwind_main.soldout $n)"
+echo "original: ${original_ns} ns/throw"
+echo "sold:     ${sold_ns} ns/throw"
+
+if [ "$original_caught" != "$n" ] || [ "$sold_caught" != "$n" ]; then
+    echo "caught $original_caught and $sold_caught of $n exceptions"
+    exit 1
+fi
+if [ -n "${UNWIND_MAX_RATIO:-}" ] && [ "$sold_ns" -gt $((original_ns * UNWIND_MAX_RATIO)) ]; then
+    echo "unwinding in the sold output is too slow"
+    exit 1
+fi
@@ -0,0 +1,103 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// relative_relocs times the kernels for RELATIVE relocations against their
+// scalar versions on the relocations of a binary, and then the whole link
+// of it. See relative_relocs.sh for the input.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "elf_binary.h"
+#include "libsold.h"
+#include "relative_relocs.h"
+
+namespace {
+
+const int kIterations = 5;
+
+template <class F>
+double Time(F f) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / kIterations;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " LIBRARY" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<ELFBinary> bin = ReadELF(argv[1]);
+    const Elf_Rel* rels = bin->rel();
+    const size_t num = bin->num_rels();
+    CHECK(rels);
+    const uint64_t relative_info = ELF_R_INFO(0, bin->ehdr()->e_machine == EM_AARCH64 ? R_AARCH64_RELATIVE : R_X86_64_RELATIVE);
+    const Elf_Phdr* tls = bin->tls();
+    const Range ranges[kNumRelativeRanges] = {
+        tls ? Range{tls->p_vaddr, tls->p_vaddr + tls->p_filesz} : Range{0, 0},
+        Range{bin->init_array_addr(), bin->init_array_addr() + bin->init_arraysz()},
+        Range{bin->fini_array_addr(), bin->fini_array_addr() + bin->fini_arraysz()},
+    };
+
+    // Walk the table as Sold::RelocateSymbols does but skip other relocations.
+    std::vector<Elf_Rel> out(rels, rels + num);
+    auto walk = [&](size_t (*run_length)(const Elf_Rel*, size_t, uint64_t, const Range*), void (*rebase)(Elf_Rel*, size_t, uintptr_t)) {
+        size_t num_relatives = 0;
+        for (size_t i = 0; i < num;) {
+            const size_t n = run_length(&rels[i], num - i, relative_info, ranges);
+            rebase(&out[i], n, 0x1000);
+            num_relatives += n;
+            i += n ? n : 1;
+        }
+        return num_relatives;
+    };
+    size_t scalar_relatives = 0;
+    const double scalar_msec = Time([&]() { scalar_relatives = walk(RelativeRunLengthScalar, RebaseRelativesScalar); });
+    size_t vector_relatives = 0;
+    const double vector_msec = Time([&]() { vector_relatives = walk(RelativeRunLength, RebaseRelatives); });
+    CHECK_EQ(scalar_relatives, vector_relatives);
+
+    int fd = open(argv[1], O_RDONLY);
+    CHECK(fd >= 0) << argv[1] << ": " << strerror(errno);
+    SoldInput input;
+    input.name = argv[1];
+    input.fd = fd;
+    std::vector<char> output;
+    SoldOptions options;
+    options.in_process = true;
+    const double link_msec = Time([&]() {
+        output.clear();
+        CHECK(SoldLink(input, options, &output).ok);
+    });
+    close(fd);
+
+    std::cout << num << " relocations, " << vector_relatives << " in runs of RELATIVE" << std::endl;
+    std::cout << "scalar: " << scalar_msec << " ms" << std::endl;
+    std::cout << "vector: " << vector_msec << " ms (" << scalar_msec / vector_msec << "x)" << std::endl;
+    std::cout << "link: " << link_msec << " ms" << std::endl;
+    return 0;
+}
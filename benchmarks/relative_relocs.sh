@@ -0,0 +1,20 @@
+#! /bin/bash -eu
+
+# Generates a shared object with 5M RELATIVE relocations and compares the
+# vectorized and the scalar kernels for them.
+
+cd "$(dirname "$0")"
+mkdir -p out
+
+n=${NUM_RELATIVES:-5000000}
+cat > out/relatives.s <<EOS
+    .data
+    .p2align 3
+table:
+    .rept $n
+    .quad table
+    .endr
+EOS
+gcc -shared -Wa,--noexecstack -o out/librelatives.so out/relatives.s
+
+${RELATIVE_RELOCS:-../build/relative_relocs} out/librelatives.so
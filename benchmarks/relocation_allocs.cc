@@ -0,0 +1,116 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// relocation_allocs links two shared objects which differ only in the
+// number of relocations and reports the allocations and the time of each
+// link. The relocation loop must not allocate, so the difference of the
+// allocations must be zero. See relocation_allocs.sh for the inputs.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "elf_binary.h"
+#include "libsold.h"
+
+namespace {
+
+std::atomic<uint64_t> num_allocs{0};
+
+struct Result {
+    size_t num_rels;
+    uint64_t allocs;
+    double msec;
+};
+
+Result Measure(const std::string& filename, int iterations) {
+    size_t num_rels;
+    {
+        std::unique_ptr<ELFBinary> bin = ReadELF(filename);
+        num_rels = bin->num_rels() + bin->num_plt_rels();
+    }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    CHECK(fd >= 0) << filename << ": " << strerror(errno);
+    SoldInput input;
+    input.name = filename;
+    input.fd = fd;
+    SoldOptions options;
+    // Allocations are counted in this process.
+    options.in_process = true;
+
+    std::vector<char> output;
+    // The first link warms up caches such as the search of libraries.
+    CHECK(SoldLink(input, options, &output).ok);
+
+    Result result{num_rels, 0, 0};
+    const uint64_t start_allocs = num_allocs;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        output.clear();
+        CHECK(SoldLink(input, options, &output).ok);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    result.allocs = (num_allocs - start_allocs) / iterations;
+    result.msec = std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+    close(fd);
+    return result;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    num_allocs++;
+    if (void* p = malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+int main(int argc, char* argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " SMALL LARGE" << std::endl;
+        return 1;
+    }
+
+    const int iterations = 5;
+    const Result small = Measure(argv[1], iterations);
+    const Result large = Measure(argv[2], iterations);
+    for (const Result& r : {small, large}) {
+        std::cout << r.num_rels << " relocations: " << r.allocs << " allocations, " << r.msec << " ms" << std::endl;
+    }
+
+    CHECK_GT(large.num_rels, small.num_rels);
+    const int64_t extra_allocs = large.allocs - small.allocs;
+    std::cout << "Allocations for " << large.num_rels - small.num_rels << " extra relocations: " << extra_allocs << std::endl;
+    if (extra_allocs > 0) {
+        std::cerr << "The relocation loop allocates." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+#! /bin/bash -eu
+
+# Generates two shared objects with 10000 and 40000 relocations referring to
+# the same symbols and checks the relocation loop of sold does not allocate.
+
+cd "$(dirname "$0")"
+mkdir -p out
+
+gen() {
+    local n=$1
+    echo "int v0, v1, v2, v3;"
+    echo "void f0(void) {} void f1(void) {} void f2(void) {} void f3(void) {}"
+    echo "static int local_var;"
+    echo "void* symbols[] = {"
+    seq 0 $((n / 2 - 1)) | awk '{ printf("    %s%d,\n", ($1 % 2) ? "&v" : "f", $1 % 4) }'
+    echo "};"
+    echo "void* locals[] = {"
+    seq 0 $((n / 2 - 1)) | awk '{ print "    &local_var," }'
+    echo "};"
+}
+
+for n in 10000 40000; do
+    gen $n > out/relocs_$n.c
+    gcc -fPIC -shared -o out/librelocs_$n.so out/relocs_$n.c
+done
+
+${RELOCATION_ALLOCS:-../build/relocation_allocs} out/librelocs_10000.so out/librelocs_40000.so
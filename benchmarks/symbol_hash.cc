@@ -0,0 +1,85 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// symbol_hash checks and times every batched GNU and SysV hash kernel the
+// CPU supports against the scalar one on the names in .dynsym of a library. See symbol_hash.sh
+// for the input.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "elf_binary.h"
+#include "hash.h"
+
+namespace {
+
+const int kIterations = 20;
+
+template <class F>
+double Time(F f) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / kIterations;
+}
+
+// Compare checks every kernel agrees with the scalar one and times them.
+void Compare(const char* title, void (*hash)(const std::string_view*, size_t, uint32_t*, HashKernel),
+             const std::vector<std::string_view>& names) {
+    std::vector<uint32_t> expected(names.size());
+    const double scalar_msec = Time([&]() { hash(names.data(), names.size(), expected.data(), HashKernel::kScalar); });
+    std::cout << title << " scalar: " << scalar_msec << " ms" << std::endl;
+    for (HashKernel kernel : SupportedHashKernels()) {
+        if (kernel == HashKernel::kScalar) continue;
+        std::vector<uint32_t> actual(names.size());
+        const double msec = Time([&]() { hash(names.data(), names.size(), actual.data(), kernel); });
+        for (size_t i = 0; i < names.size(); i++) {
+            CHECK_EQ(expected[i], actual[i]) << title << " of " << names[i] << " with " << HashKernelName(kernel);
+        }
+        std::cout << title << " " << HashKernelName(kernel) << ": " << msec << " ms (" << scalar_msec / msec << "x)" << std::endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    if (argc != 2 && argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " LIBRARY [REPEAT]" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<ELFBinary> bin = ReadELF(argv[1]);
+    const std::vector<bool> marks = bin->CollectSymbolsFromDynamic();
+    const int repeat = argc == 3 ? atoi(argv[2]) : 1;
+    std::vector<std::string_view> names;
+    size_t bytes = 0;
+    for (int i = 0; i < repeat; i++) {
+        for (size_t idx = 0; idx < marks.size(); idx++) {
+            if (!marks[idx] || !bin->symtab()[idx].st_name) continue;
+            names.push_back(bin->strtab() + bin->symtab()[idx].st_name);
+            bytes += names.back().size();
+        }
+    }
+    CHECK(!names.empty()) << argv[1] << " has no symbols";
+
+    std::cout << names.size() << " names, " << bytes / names.size() << " bytes on average" << std::endl;
+    Compare("GNU hash", CalcGnuHashes, names);
+    Compare("SysV hash", CalcHashes, names);
+    return 0;
+}
@@ -0,0 +1,9 @@
+#! /bin/bash -eu
+
+# Compares the batched and the scalar symbol hash functions on the mangled
+# C++ names exported by libstdc++, repeated to about 600k names.
+
+cd "$(dirname "$0")"
+
+lib=${SYMBOL_HASH_LIBRARY:-$(g++ -print-file-name=libstdc++.so)}
+${SYMBOL_HASH:-../build/symbol_hash} "$(readlink -f "$lib")" ${SYMBOL_HASH_REPEAT:-100}
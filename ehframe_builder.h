@@ -15,6 +15,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 #include "utils.h"
 
 class EHFrameBuilder {
@@ -26,7 +29,25 @@ public:
         eh_frame_header_.table_enc = DW_EH_PE_sdata4 | DW_EH_PE_datarel;
         eh_frame_header_.eh_frame_ptr = 0;
         eh_frame_header_.fde_count = 0;
-        eh_frame_header_.table = std::vector<EHFrameHeader::FDETableEntry>();
+        eh_frame_header_.table_base = 0;
+    }
+
+    // SizeFor returns the size of .eh_frame_hdr with `num_fdes` entries.
+    static uintptr_t SizeFor(size_t num_fdes) {
+        return sizeof(EHFrameHeader::version) + sizeof(EHFrameHeader::eh_frame_ptr_enc) + sizeof(EHFrameHeader::fde_count_enc) +
+               sizeof(EHFrameHeader::table_enc) + sizeof(EHFrameHeader::eh_frame_ptr) + sizeof(EHFrameHeader::fde_count) +
+               num_fdes * (sizeof(EHFrameHeader::FDETableEntry::fde_ptr) + sizeof(EHFrameHeader::FDETableEntry::initial_loc));
+    }
+
+    // Fits returns whether the 32 bit entries can hold the table of an input
+    // placed at `load_offset`. The unwinder of libgcc binary-searches only
+    // tables with 32 bit entries, so sold never emits wider ones.
+    static bool Fits(const EHFrameHeader& efh, const uintptr_t efh_vaddr, const uintptr_t load_offset, const uintptr_t new_efh_vaddr) {
+        const int64_t delta = Delta(efh_vaddr, load_offset, new_efh_vaddr);
+        auto fits = [](int64_t v) { return v == static_cast<int32_t>(v); };
+        return std::all_of(efh.table.begin(), efh.table.end(), [delta, &fits](const EHFrameHeader::FDETableEntry& te) {
+            return fits(delta + te.initial_loc) && fits(delta + te.fde_ptr);
+        });
     }
 
     void Emit(FILE* fp) {
@@ -36,40 +57,68 @@ public:
         Write(fp, eh_frame_header_.table_enc);
         Write(fp, eh_frame_header_.eh_frame_ptr);
         Write(fp, eh_frame_header_.fde_count);
-        for (const EHFrameHeader::FDETableEntry te : eh_frame_header_.table) {
-            Write(fp, te.initial_loc);
-            Write(fp, te.fde_ptr);
+        for (const Entry& e : entries_) {
+            Write(fp, static_cast<int32_t>(e.initial_loc));
+            Write(fp, static_cast<int32_t>(e.fde_ptr));
         }
     }
 
-    uintptr_t Size() const {
-        return sizeof(eh_frame_header_.version) + sizeof(eh_frame_header_.eh_frame_ptr_enc) + sizeof(eh_frame_header_.fde_count_enc) +
-               sizeof(eh_frame_header_.table_enc) + sizeof(eh_frame_header_.eh_frame_ptr) + sizeof(eh_frame_header_.fde_count) +
-               eh_frame_header_.fde_count *
-                   (sizeof(EHFrameHeader::FDETableEntry::fde_ptr) + sizeof(EHFrameHeader::FDETableEntry::initial_loc));
-    }
+    uintptr_t Size() const { return SizeFor(eh_frame_header_.fde_count); }
 
+    // Add appends the table of an input. `efh_vaddr` is the address which
+    // the table is relative to and `load_offset` is where the input is
+    // placed in the output.
     void Add(const std::string& name, const EHFrameHeader& efh, const uintptr_t efh_vaddr, const uintptr_t load_offset,
              const uintptr_t new_efh_vaddr) {
         LOG(INFO) << "EHFrameBuilder" << SOLD_LOG_BITS(efh.version) << SOLD_LOG_DWEHPE(efh.eh_frame_ptr_enc)
                   << SOLD_LOG_DWEHPE(efh.fde_count_enc) << SOLD_LOG_DWEHPE(efh.table_enc) << SOLD_LOG_BITS(efh.eh_frame_ptr)
                   << SOLD_LOG_BITS(efh.fde_count);
-        for (const auto te : efh.table) {
-            LOG(INFO) << "EHFrameBuilder" << SOLD_LOG_BITS(te.fde_ptr) << SOLD_LOG_BITS(te.initial_loc);
-        }
+        CHECK(Fits(efh, efh_vaddr, load_offset, new_efh_vaddr)) << "The output is too large for .eh_frame_hdr: " << name;
 
+        const int64_t delta = Delta(efh_vaddr, load_offset, new_efh_vaddr);
         eh_frame_header_.fde_count += efh.fde_count;
-        for (const auto te : efh.table) {
-            EHFrameHeader::FDETableEntry new_te;
-            new_te.fde_ptr = static_cast<int32_t>(efh_vaddr) + te.fde_ptr + static_cast<int32_t>(load_offset) - new_efh_vaddr;
-            new_te.initial_loc = static_cast<int32_t>(efh_vaddr) + te.initial_loc + static_cast<int32_t>(load_offset) - new_efh_vaddr;
-            eh_frame_header_.table.emplace_back(new_te);
-            LOG(INFO) << "EHFrameBuilder" << SOLD_LOG_BITS(new_te.fde_ptr) << SOLD_LOG_BITS(new_te.initial_loc);
+        for (size_t i = 0; i < efh.table.size(); i++) {
+            const EHFrameHeader::FDETableEntry& te = efh.table[i];
+            entries_.push_back(Entry{delta + te.initial_loc, delta + te.fde_ptr, efh.fdes[i].pc_range});
+            VLOG(1) << "EHFrameBuilder" << SOLD_LOG_BITS(te.fde_ptr) << SOLD_LOG_BITS(te.initial_loc) << SOLD_LOG_BITS(entries_.back().fde_ptr)
+                    << SOLD_LOG_BITS(entries_.back().initial_loc);
         }
     }
 
+    // Finalize sorts the merged table by the addresses of functions and
+    // verifies that the unwinder can binary search it. Tables of inputs have
+    // no duplicates, so a duplicate here means inputs overlap.
+    void Finalize() {
+        CHECK_EQ(entries_.size(), eh_frame_header_.fde_count);
+        std::stable_sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) { return a.initial_loc < b.initial_loc; });
+
+        size_t num_overlaps = 0;
+        for (size_t i = 1; i < entries_.size(); i++) {
+            const Entry& prev = entries_[i - 1];
+            CHECK_LT(prev.initial_loc, entries_[i].initial_loc) << "Two FDEs for " << HexString(entries_[i].initial_loc);
+            if (prev.initial_loc + static_cast<int64_t>(prev.pc_range) > entries_[i].initial_loc) {
+                num_overlaps++;
+                VLOG(1) << "EHFrameBuilder overlap" << SOLD_LOG_BITS(prev.initial_loc) << SOLD_LOG_BITS(prev.pc_range)
+                        << SOLD_LOG_BITS(entries_[i].initial_loc);
+            }
+        }
+        if (num_overlaps) LOG(WARNING) << num_overlaps << " FDEs overlap with the next ones in .eh_frame_hdr";
+    }
+
     uint32_t fde_count() const { return eh_frame_header_.fde_count; }
 
 private:
+    struct Entry {
+        int64_t initial_loc;
+        int64_t fde_ptr;
+        uint64_t pc_range;
+    };
+
+    // Computed in 64 bits, as outputs may be larger than 2GiB.
+    static int64_t Delta(const uintptr_t efh_vaddr, const uintptr_t load_offset, const uintptr_t new_efh_vaddr) {
+        return static_cast<int64_t>(efh_vaddr + load_offset) - static_cast<int64_t>(new_efh_vaddr);
+    }
+
     EHFrameHeader eh_frame_header_;
+    std::vector<Entry> entries_;
 };
@@ -21,6 +21,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
 #include <numeric>
 #include <set>
@@ -28,9 +29,21 @@
 
 #include "version_builder.h"
 
-ELFBinary::ELFBinary(const std::string& filename, int fd, char* head, size_t mapped_size, size_t filesize)
-    : filename_(filename), fd_(fd), head_(head), mapped_size_(mapped_size), filesize_(filesize) {
+ELFBinary::ELFBinary(const std::string& filename, int fd, char* head, size_t mapped_size, size_t filesize,
+                     MetadataCache* metadata_cache, bool writable, bool summary_only)
+    : filename_(filename),
+      fd_(fd),
+      head_(head),
+      mapped_size_(mapped_size),
+      filesize_(filesize),
+      writable_(writable),
+      metadata_cache_(summary_only ? nullptr : metadata_cache) {
     ehdr_ = reinterpret_cast<Elf_Ehdr*>(head);
+    if (writable_) {
+        mapped_ranges_.push_back(Range{0, filesize_});
+    } else {
+        mapped_ranges_ = LoadRelevantRanges(ehdr_, reinterpret_cast<Elf_Phdr*>(head_ + ehdr_->e_phoff), filesize_);
+    }
 
     CHECK_EQ(ehdr_->e_type, ET_DYN);
     CHECK_EQ(ehdr_->e_ident[EI_DATA], ELFDATA2LSB);
@@ -47,11 +60,48 @@ ELFBinary::ELFBinary(const std::string& filename, int fd, char* head, size_t map
     }
 
     ParsePhdrs();
+    if (summary_only) {
+        ReleaseContents();
+        return;
+    }
+
+    if (metadata_cache_) {
+        metadata_content_hash_ = MetadataContentHash();
+        cached_ = metadata_cache_->Lookup(filename_, fd_, metadata_content_hash_);
+    }
 }
 
 ELFBinary::~ELFBinary() {
-    munmap(head_, mapped_size_);
-    close(fd_);
+    if (head_ && mapped_size_) munmap(head_, mapped_size_);
+    if (fd_ >= 0) close(fd_);
+}
+
+void ELFBinary::ReleaseContents() {
+    if (mapped_size_) munmap(head_, mapped_size_);
+    if (fd_ >= 0) close(fd_);
+    head_ = nullptr;
+    fd_ = -1;
+    mapped_ranges_.clear();
+
+    // Drop all pointers to the contents. Names are kept in std::string.
+    ehdr_ = nullptr;
+    phdrs_.clear();
+    loads_.clear();
+    loads_by_vaddr_.clear();
+    loads_by_offset_.clear();
+    tls_ = gnu_stack_ = gnu_relro_ = nullptr;
+    strtab_ = nullptr;
+    symtab_ = nullptr;
+    rel_ = plt_rel_ = nullptr;
+    rels_by_offset_.clear();
+    rels_indexed_ = false;
+    gnu_hash_ = nullptr;
+    hash_ = nullptr;
+    init_array_offset_ = fini_array_offset_ = nullptr;
+    versym_ = nullptr;
+    verneed_ = nullptr;
+    verdef_ = nullptr;
+    eh_frame_header_ = EHFrameHeader();
 }
 
 bool ELFBinary::IsELF(const char* p) {
@@ -61,6 +111,44 @@ bool ELFBinary::IsELF(const char* p) {
     return true;
 }
 
+std::vector<Range> ELFBinary::LoadRelevantRanges(const Elf_Ehdr* ehdr, const Elf_Phdr* phdrs, size_t filesize) {
+    std::vector<Range> ranges;
+    auto add = [&ranges, filesize](uintptr_t offset, uintptr_t size) {
+        if (offset >= filesize || size == 0) return;
+        ranges.push_back(Range{offset, std::min<uintptr_t>(offset + size, filesize)});
+    };
+    add(0, sizeof(Elf_Ehdr));
+    add(ehdr->e_phoff, ehdr->e_phnum * sizeof(Elf_Phdr));
+    for (int i = 0; i < ehdr->e_phnum; ++i) {
+        const Elf_Phdr& phdr = phdrs[i];
+        if (phdr.p_type == PT_LOAD || phdr.p_type == PT_DYNAMIC || phdr.p_type == PT_GNU_EH_FRAME || phdr.p_type == PT_TLS ||
+            phdr.p_type == PT_INTERP) {
+            add(phdr.p_offset, phdr.p_filesz);
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+    std::vector<Range> merged;
+    for (const Range& r : ranges) {
+        if (!merged.empty() && r.start <= merged.back().end) {
+            merged.back().end = std::max(merged.back().end, r.end);
+        } else {
+            merged.push_back(r);
+        }
+    }
+    return merged;
+}
+
+void ELFBinary::Advise(uintptr_t offset, size_t size, int advice) const {
+    CHECK(head_);
+    // Borrowed buffers may be anything, e.g., anonymous memory.
+    if (!mapped_size_) return;
+    const uintptr_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+    const uintptr_t start = offset & ~page_mask;
+    // madvise is only a hint, so errors are ignored.
+    madvise(head_ + start, offset + size - start, advice);
+}
+
 Range ELFBinary::GetRange() const {
     Range range{std::numeric_limits<uintptr_t>::max(), std::numeric_limits<uintptr_t>::min()};
     for (Elf_Phdr* phdr : loads_) {
@@ -72,13 +160,13 @@ Range ELFBinary::GetRange() const {
 
 bool ELFBinary::IsAddrInInitarray(uintptr_t addr) const {
     CHECK(init_array_addr_ != 0);
-    LOG(INFO) << SOLD_LOG_BITS(addr) << SOLD_LOG_BITS(init_array_addr_) << SOLD_LOG_BITS(init_arraysz_);
+    VLOG(1) << SOLD_LOG_BITS(addr) << SOLD_LOG_BITS(init_array_addr_) << SOLD_LOG_BITS(init_arraysz_);
     return reinterpret_cast<uintptr_t>(init_array_addr_) <= addr && addr < reinterpret_cast<uintptr_t>(init_array_addr_ + init_arraysz_);
 }
 
 bool ELFBinary::IsAddrInFiniarray(uintptr_t addr) const {
     CHECK(fini_array_addr_ != 0);
-    LOG(INFO) << SOLD_LOG_BITS(addr) << SOLD_LOG_BITS(fini_array_addr_) << SOLD_LOG_BITS(fini_arraysz_);
+    VLOG(1) << SOLD_LOG_BITS(addr) << SOLD_LOG_BITS(fini_array_addr_) << SOLD_LOG_BITS(fini_arraysz_);
     return reinterpret_cast<uintptr_t>(fini_array_addr_) <= addr && addr < reinterpret_cast<uintptr_t>(fini_array_addr_ + fini_arraysz_);
 }
 
@@ -105,17 +193,30 @@ bool ELFBinary::IsOffsetInTLSBSS(uintptr_t tls_offset) const {
 
 namespace {
 
-std::set<int> CollectSymbolsFromReloc(const Elf_Rel* rels, size_t num) {
-    std::set<int> indices;
+void CollectSymbolsFromReloc(const Elf_Rel* rels, size_t num, std::vector<bool>* marks) {
     for (size_t i = 0; i < num; ++i) {
-        const Elf_Rel* rel = &rels[i];
-        indices.insert(ELF_R_SYM(rel->r_info));
+        (*marks)[ELF_R_SYM(rels[i].r_info)] = true;
     }
-    return indices;
 }
 
-std::set<int> CollectSymbolsFromGnuHash(Elf_GnuHash* gnu_hash) {
-    std::set<int> indices;
+size_t MaxSymbolInReloc(const Elf_Rel* rels, size_t num) {
+    size_t max_index = 0;
+    for (size_t i = 0; i < num; ++i) max_index = std::max<size_t>(max_index, ELF_R_SYM(rels[i].r_info));
+    return max_index;
+}
+
+// The chains of GNU hash are sorted by their buckets, so the chain from the
+// largest bucket ends at the last symbol.
+size_t NumSymbolsInGnuHash(Elf_GnuHash* gnu_hash) {
+    const uint32_t* buckets = gnu_hash->buckets();
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < gnu_hash->nbuckets; ++i) n = std::max(n, buckets[i]);
+    if (n < gnu_hash->symndx) return gnu_hash->symndx;
+    for (const uint32_t* hv = &gnu_hash->hashvals()[n - gnu_hash->symndx]; !(*hv & 1); ++hv) ++n;
+    return n + 1;
+}
+
+void CollectSymbolsFromGnuHash(Elf_GnuHash* gnu_hash, std::vector<bool>* marks) {
     const uint32_t* buckets = gnu_hash->buckets();
     const uint32_t* hashvals = gnu_hash->hashvals();
     for (int i = 0; i < gnu_hash->nbuckets; ++i) {
@@ -124,80 +225,197 @@ std::set<int> CollectSymbolsFromGnuHash(Elf_GnuHash* gnu_hash) {
         const uint32_t* hv = &hashvals[n - gnu_hash->symndx];
         for (;; ++n) {
             uint32_t h2 = *hv++;
-            CHECK(indices.insert(n).second);
+            CHECK(!(*marks)[n]);
+            (*marks)[n] = true;
             if (h2 & 1) break;
         }
     }
     for (size_t n = 0; n < gnu_hash->symndx; ++n) {
-        indices.insert(n);
+        (*marks)[n] = true;
     }
-    return indices;
 }
 
-std::set<int> CollectSymbolsFromElfHash(const std::string& name, Elf_Hash* hash) {
-    std::set<int> indices;
+void CollectSymbolsFromElfHash(Elf_Hash* hash, std::vector<bool>* marks) {
     const uint32_t* buckets = hash->buckets();
     const uint32_t* chains = hash->chains();
     for (size_t i = 0; i < hash->nbuckets; ++i) {
         for (int n = buckets[i]; n != STN_UNDEF; n = chains[n]) {
-            indices.insert(n);
+            (*marks)[n] = true;
         }
     }
-    return indices;
 }
 
 }  // namespace
 
-std::set<int> ELFBinary::CollectSymbolsFromDynamic() {
-    // Since we only rely on program headers and do not read section headers
-    // at all, we do not know the exact size of .dynsym section. We collect
-    // indices in .dynsym from both (GNU or ELF) hash and relocs.
+size_t ELFBinary::NumSymbolsFromSectionHeaders() const {
+    Elf_Shdr shdr;
+    if (!FindSection(".dynsym", &shdr) || shdr.sh_type != SHT_DYNSYM || shdr.sh_entsize != sizeof(Elf_Sym)) return 0;
+    if (shdr.sh_offset > filesize_ || shdr.sh_size > filesize_ - shdr.sh_offset) return 0;
+    return shdr.sh_size / sizeof(Elf_Sym);
+}
 
-    std::set<int> indices;
+size_t ELFBinary::NumDynSymbols() const {
+    size_t num = std::max(MaxSymbolInReloc(rel_, num_rels_), MaxSymbolInReloc(plt_rel_, num_plt_rels_)) + 1;
     if (gnu_hash_) {
-        indices = CollectSymbolsFromGnuHash(gnu_hash_);
+        num = std::max(num, NumSymbolsInGnuHash(gnu_hash_));
     } else {
         CHECK(hash_);
-        indices = CollectSymbolsFromElfHash(name(), hash_);
+        num = std::max<size_t>(num, hash_->nchains);
     }
+    return std::max(num, NumSymbolsFromSectionHeaders());
+}
 
-    for (int idx : CollectSymbolsFromReloc(rel_, num_rels_)) indices.insert(idx);
-    for (int idx : CollectSymbolsFromReloc(plt_rel_, num_plt_rels_)) indices.insert(idx);
+std::vector<bool> ELFBinary::CollectSymbolsFromDynamic() {
+    // Since we only rely on program headers and do not read section headers
+    // at all, we do not know the exact size of .dynsym section. We collect
+    // indices in .dynsym from both (GNU or ELF) hash and relocs.
+    std::vector<bool> marks(NumDynSymbols());
+    if (gnu_hash_) {
+        CollectSymbolsFromGnuHash(gnu_hash_, &marks);
+    } else {
+        CollectSymbolsFromElfHash(hash_, &marks);
+    }
+    CollectSymbolsFromReloc(rel_, num_rels_, &marks);
+    CollectSymbolsFromReloc(plt_rel_, num_plt_rels_, &marks);
+    return marks;
+}
 
-    return indices;
+// The summary holds the decoded .eh_frame_hdr and the version references of
+// the symbols in .dynsym, so they are hashed with the headers which locate
+// them. Names are not hashed because they are read from .dynstr every time.
+uint64_t ELFBinary::MetadataContentHash() const {
+    uint64_t h = HashBytes(head_, sizeof(Elf_Ehdr));
+    h = HashBytes(head_ + ehdr_->e_phoff, ehdr_->e_phnum * sizeof(Elf_Phdr), h);
+    for (const Elf_Phdr* phdr : phdrs_) {
+        if (phdr->p_type != PT_DYNAMIC && phdr->p_type != PT_GNU_EH_FRAME) continue;
+        h = HashBytes(head_ + phdr->p_offset, phdr->p_filesz, h);
+    }
+    if (symtab_) {
+        const size_t num = NumDynSymbols();
+        h = HashBytes(symtab_, num * sizeof(Elf_Sym), h);
+        if (versym_) h = HashBytes(versym_, num * sizeof(Elf_Versym), h);
+    }
+    return h;
 }
 
-void ELFBinary::ReadDynSymtab(const std::map<std::string, std::string>& filename_to_soname) {
+void ELFBinary::ReadDynSymtab() {
     CHECK(symtab_);
+    std::lock_guard<std::mutex> lock(syms_mu_);
+    if (syms_read_) return;
+    syms_read_ = true;
     LOG(INFO) << "Read dynsymtab of " << name();
+    if (gnu_hash_) num_gnu_hashed_ = NumSymbolsInGnuHash(gnu_hash_);
+
+    if (cached_ && cached_->has_symbols()) {
+        ReadDynSymtabFromCache();
+        return;
+    }
 
     // Since we only rely on program headers and do not read section headers
     // at all, we do not know the exact size of .dynsym section. We collect
     // indices in .dynsym from both (GNU or ELF) hash and relocs.
 
-    std::set<int> indices = CollectSymbolsFromDynamic();
+    const std::vector<bool> marks = CollectSymbolsFromDynamic();
     std::set<std::tuple<std::string, std::string, std::string>> duplicate_check;
+    std::vector<MetadataCache::SymbolSource> sources;
+    std::vector<size_t> indices;
+    for (size_t idx = 0; idx < marks.size(); ++idx) {
+        if (marks[idx] && symtab_[idx].st_name != 0) indices.push_back(idx);
+    }
+    FillSymbolGnuHashes(indices);
 
-    for (int idx : indices) {
+    for (size_t idx : indices) {
         Elf_Sym* sym = &symtab_[idx];
-        if (sym->st_name == 0) continue;
         const std::string symname(strtab_ + sym->st_name);
+        const uint32_t gnu_hash = sym_gnu_hashes_[idx];
 
         nsyms_++;
         LOG(INFO) << symname << "@" << name() << " index in .dynsym = " << idx;
 
         // Get version information coresspoinds to idx
-        std::string soname, version;
-        std::tie(soname, version) = GetVersion(idx, filename_to_soname);
+        std::string file, version;
+        VersionRefKind kind = GetVersionRef(idx, &file, &version);
         Elf_Versym v = versym_ ? versym_[idx] : NO_VERSION_INFO;
 
-        syms_.push_back(Syminfo{symname, soname, version, v, sym});
-        CHECK(duplicate_check.insert({symname, soname, version}).second)
-            << SOLD_LOG_KEY(symname) << SOLD_LOG_KEY(soname) << SOLD_LOG_KEY(version);
+        syms_.push_back(Syminfo{symname, file, version, v, sym, gnu_hash});
+        sym_version_kinds_.push_back(kind);
+        CHECK(duplicate_check.insert({symname, file, version}).second)
+            << SOLD_LOG_KEY(symname) << SOLD_LOG_KEY(file) << SOLD_LOG_KEY(version);
         LOG(INFO) << "duplicate_check: " << SOLD_LOG_KEY(symname) << SOLD_LOG_KEY(version);
+
+        if (metadata_cache_) sources.push_back(MetadataCache::SymbolSource{static_cast<uint32_t>(idx), kind, file, version, v});
     }
 
     LOG(INFO) << "nsyms_ = " << nsyms_;
+
+    if (metadata_cache_) {
+        metadata_cache_->Store(filename_, fd_, metadata_content_hash_, head_, FindPhdr(PT_GNU_EH_FRAME) ? eh_frame_header() : nullptr,
+                               &sources);
+    }
+}
+
+// The symbols in the cache were already checked for duplicates when they
+// were stored.
+void ELFBinary::ReadDynSymtabFromCache() {
+    const MetadataCache::Symbol* syms = cached_->symbols();
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < cached_->num_symbols(); i++) indices.push_back(syms[i].index);
+    FillSymbolGnuHashes(indices);
+
+    for (size_t i = 0; i < cached_->num_symbols(); i++) {
+        const MetadataCache::Symbol& s = syms[i];
+        Elf_Sym* sym = &symtab_[s.index];
+        syms_.push_back(
+            Syminfo{strtab_ + sym->st_name, cached_->Str(s.file), cached_->Str(s.version), s.versym, sym, sym_gnu_hashes_[s.index]});
+        sym_version_kinds_.push_back(static_cast<VersionRefKind>(s.version_kind));
+        nsyms_++;
+    }
+    LOG(INFO) << "nsyms_ = " << nsyms_ << " (cached)";
+}
+
+std::vector<Syminfo> ELFBinary::GetSymbolMap(const std::map<std::string, std::string>& filename_to_soname) const {
+    std::vector<Syminfo> syms = syms_;
+    for (size_t i = 0; i < syms.size(); i++) syms[i].soname = ResolveVersionFile(sym_version_kinds_[i], syms[i].soname, filename_to_soname);
+    return syms;
+}
+
+// The chains of .gnu.hash keep the hash of each symbol from symndx with its
+// lowest bit replaced, which is exactly GnuHashKey.
+bool ELFBinary::InGnuHashChains(size_t index) const {
+    return gnu_hash_ && index >= gnu_hash_->symndx && index < num_gnu_hashed_;
+}
+
+uint32_t ELFBinary::InputGnuHash(size_t index, const char* name) const {
+    if (InGnuHashChains(index)) return gnu_hash_->hashvals()[index - gnu_hash_->symndx] & ~1;
+    return GnuHashKey(name);
+}
+
+// FillSymbolGnuHashes fills sym_gnu_hashes_ for the symbols at `indices`.
+// Symbols outside the chains of .gnu.hash are hashed in a batch.
+void ELFBinary::FillSymbolGnuHashes(const std::vector<size_t>& indices) {
+    std::vector<size_t> missing;
+    std::vector<std::string_view> names;
+    for (size_t idx : indices) {
+        if (sym_gnu_hashes_.size() <= idx) sym_gnu_hashes_.resize(idx + 1);
+        if (InGnuHashChains(idx)) {
+            sym_gnu_hashes_[idx] = gnu_hash_->hashvals()[idx - gnu_hash_->symndx] & ~1;
+        } else {
+            missing.push_back(idx);
+            names.push_back(strtab_ + symtab_[idx].st_name);
+        }
+    }
+    std::vector<uint32_t> hashes(names.size());
+    CalcGnuHashes(names.data(), names.size(), hashes.data());
+    for (size_t i = 0; i < missing.size(); ++i) {
+        sym_gnu_hashes_[missing[i]] = hashes[i] & ~1;
+    }
+}
+
+uint32_t ELFBinary::SymbolGnuHash(uint32_t index) {
+    CHECK(syms_read_);
+    // 0 is also a valid hash, in which case we just compute it again.
+    const uint32_t h = index < sym_gnu_hashes_.size() ? sym_gnu_hashes_[index] : 0;
+    return h ? h : InputGnuHash(index, Str(symtab_[index].st_name));
 }
 
 Elf_Phdr* ELFBinary::FindPhdr(uint64_t type) {
@@ -218,14 +436,32 @@ const Elf_Phdr& ELFBinary::GetPhdr(uint64_t type) {
 // GetVersion returns (soname, version)
 std::pair<std::string, std::string> ELFBinary::GetVersion(int index, const std::map<std::string, std::string>& filename_to_soname) {
     LOG(INFO) << "GetVersion";
+    std::string file, version;
+    VersionRefKind kind = GetVersionRef(index, &file, &version);
+    return std::make_pair(ResolveVersionFile(kind, file, filename_to_soname), version);
+}
+
+std::string ELFBinary::ResolveVersionFile(VersionRefKind kind, const std::string& file,
+                                          const std::map<std::string, std::string>& filename_to_soname) {
+    if (kind != kVerneedRef) return file;
+    auto found = filename_to_soname.find(file);
+    if (found == filename_to_soname.end()) {
+        LOG(FATAL) << "There is no entry for " << file << " in filename_to_soname.";
+    }
+    return found->second;
+}
+
+ELFBinary::VersionRefKind ELFBinary::GetVersionRef(int index, std::string* file, std::string* version) {
+    file->clear();
+    version->clear();
     if (!versym_) {
-        return std::make_pair("", "");
+        return kNoVersionRef;
     }
 
     LOG(INFO) << SOLD_LOG_KEY(versym_[index]);
 
     if (is_special_ver_ndx(versym_[index])) {
-        return std::make_pair("", "");
+        return kNoVersionRef;
     } else {
         if (verneed_) {
             Elf_Verneed* vn = verneed_;
@@ -241,13 +477,9 @@ std::pair<std::string, std::string> ELFBinary::GetVersion(int index, const std::
                         LOG(INFO) << "Find Elf_Vernaux corresponds to " << versym_[index] << SOLD_LOG_KEY(strtab_ + vn->vn_file)
                                   << SOLD_LOG_KEY(strtab_ + vna->vna_name);
 
-                        std::string filename = std::string(strtab_ + vn->vn_file);
-                        auto found = filename_to_soname.find(filename);
-                        if (found != filename_to_soname.end()) {
-                            return std::make_pair(found->second, std::string(strtab_ + vna->vna_name));
-                        } else {
-                            LOG(FATAL) << "There is no entry for " << filename << " in filename_to_soname.";
-                        }
+                        *file = strtab_ + vn->vn_file;
+                        *version = strtab_ + vna->vna_name;
+                        return kVerneedRef;
                     }
 
                     vna = (Elf_Vernaux*)((char*)vna + vna->vna_next);
@@ -257,7 +489,7 @@ std::pair<std::string, std::string> ELFBinary::GetVersion(int index, const std::
         }
         if (verdef_) {
             Elf_Verdef* vd = verdef_;
-            std::string soname, version;
+            std::string soname, version_name;
             for (int i = 0; i < verdefnum_; ++i) {
                 Elf_Verdaux* vda = (Elf_Verdaux*)((char*)vd + vd->vd_aux);
 
@@ -265,19 +497,21 @@ std::pair<std::string, std::string> ELFBinary::GetVersion(int index, const std::
                     soname = std::string(strtab_ + vda->vda_name);
                 }
                 if (vd->vd_ndx == versym_[index]) {
-                    version = std::string(strtab_ + vda->vda_name);
+                    version_name = std::string(strtab_ + vda->vda_name);
                 }
 
                 vd = (Elf_Verdef*)((char*)vd + vd->vd_next);
             }
-            if (soname != "" && version != "") {
-                LOG(INFO) << "Find Elf_Verdef corresponds to " << versym_[index] << SOLD_LOG_KEY(soname) << SOLD_LOG_KEY(version);
-                return std::make_pair(soname, version);
+            if (soname != "" && version_name != "") {
+                LOG(INFO) << "Find Elf_Verdef corresponds to " << versym_[index] << SOLD_LOG_KEY(soname) << SOLD_LOG_KEY(version_name);
+                *file = soname;
+                *version = version_name;
+                return kVerdefRef;
             }
         }
 
         LOG(WARNING) << "Find no entry corresponds to " << versym_[index];
-        return std::make_pair("", "");
+        return kNoVersionRef;
     }
 }
 
@@ -332,18 +566,21 @@ void ELFBinary::ParsePhdrs() {
         phdrs_.push_back(phdr);
         if (phdr->p_type == PT_LOAD) {
             loads_.push_back(phdr);
+            if (phdr->p_memsz) loads_by_vaddr_.push_back(phdr);
+            if (phdr->p_filesz) loads_by_offset_.push_back(phdr);
         } else if (phdr->p_type == PT_TLS) {
             tls_ = phdr;
         }
     }
+    std::sort(loads_by_vaddr_.begin(), loads_by_vaddr_.end(), [](const Elf_Phdr* a, const Elf_Phdr* b) { return a->p_vaddr < b->p_vaddr; });
+    std::sort(loads_by_offset_.begin(), loads_by_offset_.end(),
+              [](const Elf_Phdr* a, const Elf_Phdr* b) { return a->p_offset < b->p_offset; });
 
     for (Elf_Phdr* phdr : phdrs_) {
         if (phdr->p_type == PT_DYNAMIC) {
             ParseDynamic(phdr->p_offset, phdr->p_filesz);
         } else if (phdr->p_type == PT_INTERP) {
             LOG(INFO) << "Found PT_INTERP.";
-        } else if (phdr->p_type == PT_GNU_EH_FRAME) {
-            ParseEHFrameHeader(phdr->p_offset, phdr->p_filesz);
         } else if (phdr->p_type == PT_GNU_STACK) {
             gnu_stack_ = phdr;
         } else if (phdr->p_type == PT_GNU_RELRO) {
@@ -358,7 +595,246 @@ void ELFBinary::ParsePhdrs() {
     CHECK(!phdrs_.empty());
 }
 
-void ELFBinary::ParseEHFrameHeader(size_t off, size_t size) {
+namespace {
+
+// ReadEncodedPointer decodes a DW_EH_PE_* encoded pointer at `p` whose
+// address in the input is `vaddr`. Unlike read_encoded_value_with_base, the
+// result is an address in the input. Returns nullptr for encodings which
+// cannot be resolved statically.
+const char* ReadEncodedPointer(uint8_t enc, const char* p, Elf_Addr vaddr, Elf_Addr datarel_base, Elf_Addr* val) {
+    auto load = [&p](auto v) {
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return static_cast<uint64_t>(static_cast<int64_t>(v));
+    };
+    // Without the 'R' augmentation, pointers in FDEs are absolute.
+    if (enc == DW_EH_PE_SOLD_DUMMY) enc = DW_EH_PE_absptr;
+    uint64_t v;
+    switch (enc & 0x0f) {
+        case DW_EH_PE_absptr:
+        case DW_EH_PE_udata8:
+        case DW_EH_PE_sdata8:
+            v = load(uint64_t());
+            break;
+        case DW_EH_PE_udata4:
+            v = static_cast<uint32_t>(load(uint32_t()));
+            break;
+        case DW_EH_PE_sdata4:
+            v = load(int32_t());
+            break;
+        case DW_EH_PE_udata2:
+            v = static_cast<uint16_t>(load(uint16_t()));
+            break;
+        case DW_EH_PE_sdata2:
+            v = load(int16_t());
+            break;
+        case DW_EH_PE_uleb128: {
+            uint32_t tmp;
+            p = read_uleb128(p, &tmp);
+            v = tmp;
+        } break;
+        case DW_EH_PE_sleb128: {
+            int32_t tmp;
+            p = read_sleb128(p, &tmp);
+            v = static_cast<int64_t>(tmp);
+        } break;
+        default:
+            return nullptr;
+    }
+
+    if (enc & DW_EH_PE_indirect) return nullptr;
+    // As glibc does, 0 is kept as is. Linkers use it for discarded FDEs.
+    if (v != 0) {
+        switch (enc & 0x70) {
+            case DW_EH_PE_absptr:
+                break;
+            case DW_EH_PE_pcrel:
+                v += vaddr;
+                break;
+            case DW_EH_PE_datarel:
+                if (!datarel_base) return nullptr;
+                v += datarel_base;
+                break;
+            default:
+                return nullptr;
+        }
+    }
+    *val = v;
+    return p;
+}
+
+// pc_range has the format of pc_begin but is never relative.
+const char* ReadPCRange(uint8_t enc, const char* p, Elf_Addr* val) {
+    if (enc == DW_EH_PE_SOLD_DUMMY) enc = DW_EH_PE_absptr;
+    return ReadEncodedPointer(enc & 0x0f, p, 0, 0, val);
+}
+
+// SortFDETable sorts the table by the addresses of functions, which the
+// binary search in the unwinder relies on. Only the first one of FDEs for
+// the same function is kept.
+void SortFDETable(EHFrameHeader* efh, const std::string& filename) {
+    const std::vector<EHFrameHeader::FDETableEntry>& table = efh->table;
+    auto not_ascending = [](const EHFrameHeader::FDETableEntry& a, const EHFrameHeader::FDETableEntry& b) {
+        return a.initial_loc >= b.initial_loc;
+    };
+    if (std::adjacent_find(table.begin(), table.end(), not_ascending) == table.end()) return;
+
+    std::vector<size_t> order(table.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&table](size_t a, size_t b) { return table[a].initial_loc < table[b].initial_loc; });
+    EHFrameHeader sorted = *efh;
+    sorted.table.clear();
+    sorted.fdes.clear();
+    size_t num_dups = 0;
+    for (size_t i : order) {
+        if (!sorted.table.empty() && sorted.table.back().initial_loc == table[i].initial_loc) {
+            num_dups++;
+            continue;
+        }
+        sorted.table.push_back(table[i]);
+        sorted.fdes.push_back(efh->fdes[i]);
+    }
+    sorted.fde_count = sorted.table.size();
+    if (num_dups) LOG(WARNING) << "Dropped " << num_dups << " FDEs for the same functions in " << filename;
+    *efh = std::move(sorted);
+}
+
+int32_t ToInt32(Elf_Addr v, const std::string& filename) {
+    CHECK(static_cast<int64_t>(v) == static_cast<int32_t>(v)) << HexString(v) << " does not fit in .eh_frame_hdr" << SOLD_LOG_KEY(filename);
+    return static_cast<int32_t>(v);
+}
+
+}  // namespace
+
+const EHFrameHeader* ELFBinary::eh_frame_header(bool validate) const {
+    std::lock_guard<std::mutex> lock(eh_frame_header_mu_);
+    const Elf_Phdr* efh_phdr = nullptr;
+    for (const Elf_Phdr* phdr : phdrs_) {
+        if (phdr->p_type == PT_GNU_EH_FRAME) efh_phdr = phdr;
+    }
+
+    if (eh_frame_header_parsed_) {
+        // A pooled binary may have been parsed by an earlier link without
+        // validation. The result is the same, so it is only checked.
+        if (validate && efh_phdr && !eh_frame_header_validated_) {
+            EHFrameHeader efh;
+            ParseEHFrameHeader(efh_phdr->p_offset, efh_phdr->p_filesz, true, &efh);
+            eh_frame_header_validated_ = true;
+        }
+        return &eh_frame_header_;
+    }
+    eh_frame_header_parsed_ = true;
+
+    Elf_Shdr shdr;
+    if (efh_phdr && cached_ && cached_->has_eh_frame_header() && !validate) {
+        cached_->GetEHFrameHeader(head_, &eh_frame_header_);
+    } else if (efh_phdr) {
+        ParseEHFrameHeader(efh_phdr->p_offset, efh_phdr->p_filesz, validate, &eh_frame_header_);
+        eh_frame_header_validated_ = validate;
+    } else if (FindSection(".eh_frame", &shdr) && (shdr.sh_flags & SHF_ALLOC)) {
+        LOG(INFO) << "No PT_GNU_EH_FRAME in " << filename_ << ", use .eh_frame at " << HexString(shdr.sh_addr);
+        SynthesizeEHFrameHeader(shdr.sh_addr, shdr.sh_addr + shdr.sh_size, &eh_frame_header_);
+    }
+    return &eh_frame_header_;
+}
+
+bool ELFBinary::ReadFileRange(uintptr_t offset, size_t size, void* out) const {
+    if (offset > filesize_ || size > filesize_ - offset) return false;
+    for (const Range& r : mapped_ranges_) {
+        if (r.start <= offset && offset + size <= r.end) {
+            memcpy(out, head_ + offset, size);
+            return true;
+        }
+    }
+    return fd_ >= 0 && pread(fd_, out, size, offset) == static_cast<ssize_t>(size);
+}
+
+bool ELFBinary::FindSection(const char* name, Elf_Shdr* out) const {
+    if (!ehdr_ || !ehdr_->e_shoff || ehdr_->e_shentsize != sizeof(Elf_Shdr) || ehdr_->e_shstrndx >= ehdr_->e_shnum) return false;
+    std::vector<Elf_Shdr> shdrs(ehdr_->e_shnum);
+    if (!ReadFileRange(ehdr_->e_shoff, shdrs.size() * sizeof(Elf_Shdr), shdrs.data())) return false;
+    const Elf_Shdr& shstrtab = shdrs[ehdr_->e_shstrndx];
+    // One more byte so that a broken .shstrtab is terminated.
+    std::string names(shstrtab.sh_size + 1, '\0');
+    if (!ReadFileRange(shstrtab.sh_offset, shstrtab.sh_size, &names[0])) return false;
+    for (const Elf_Shdr& shdr : shdrs) {
+        if (shdr.sh_name < shstrtab.sh_size && strcmp(names.c_str() + shdr.sh_name, name) == 0) {
+            *out = shdr;
+            return true;
+        }
+    }
+    return false;
+}
+
+EHFrameHeader::CIE ELFBinary::ParseCIE(const char* cie_base) const {
+    EHFrameHeader::CIE cie = {};
+    cie.FDE_encoding = DW_EH_PE_SOLD_DUMMY;
+    cie.LSDA_encoding = DW_EH_PE_SOLD_DUMMY;
+
+    int cie_offset = 0;
+    auto cie_read = [cie_base, &cie_offset](auto* p) {
+        memcpy(p, cie_base + cie_offset, sizeof(*p));
+        cie_offset += sizeof(*p);
+    };
+    uint32_t utmp;
+    int32_t stmp;
+
+    cie_read(&cie.length);
+    cie_read(&cie.CIE_id);
+    cie_read(&cie.version);
+    cie.aug_str = cie_base + cie_offset;
+    while (*(cie_base + cie_offset) != '\0') cie_offset++;
+    cie_offset++;
+    cie_offset = read_uleb128(reinterpret_cast<const char*>(cie_base + cie_offset), &utmp) - cie_base;  // Skip code alignment factor
+    cie_offset = read_sleb128(reinterpret_cast<const char*>(cie_base + cie_offset), &stmp) - cie_base;  // Skip data alignment factor
+    cie_offset = read_uleb128(reinterpret_cast<const char*>(cie_base + cie_offset), &utmp) - cie_base;  // Skip augmentation factor
+
+    const char* aug_head = cie.aug_str;
+    if (*aug_head == 'z') {
+        aug_head++;
+        cie_offset++;
+
+        VLOG(1) << SOLD_LOG_8BITS(*(cie_base + cie_offset)) << SOLD_LOG_KEY(*aug_head);
+
+        // Copy from sysdeps/generic/unwind-dw2-fde.c in glibc
+        while (1) {
+            if (*aug_head == 'R') {
+                cie_read(&cie.FDE_encoding);
+            } else if (*aug_head == 'P') {
+                /* Personality encoding and pointer.  */
+                /* ??? Avoid dereferencing indirect pointers, since we're
+                   faking the base address.  Gotta keep DW_EH_PE_aligned
+                   intact, however.  */
+                cie_offset = read_encoded_value_with_base(*(cie_base + cie_offset) & 0x7F, 0, cie_base + cie_offset + 1, &utmp) - cie_base;
+            } else if (*aug_head == 'L') {
+                cie_read(&cie.LSDA_encoding);
+            } else {
+                if (*aug_head != '\0') {
+                    LOG(WARNING) << "unknown augmentation" << SOLD_LOG_KEY(*aug_head) << SOLD_LOG_8BITS(*aug_head);
+                }
+                break;
+            }
+            aug_head++;
+        }
+    }
+
+    LOG(INFO) << "ParseCIE {" << SOLD_LOG_32BITS(cie.length) << SOLD_LOG_32BITS(cie.CIE_id) << SOLD_LOG_8BITS(cie.version)
+              << SOLD_LOG_KEY(cie.aug_str) << SOLD_LOG_DWEHPE(cie.FDE_encoding) << SOLD_LOG_DWEHPE(cie.LSDA_encoding) << "}";
+
+    return cie;
+}
+
+uint32_t ELFBinary::FindOrParseCIE(const char* cie_base, std::map<const char*, uint32_t>* indices,
+                                   std::vector<EHFrameHeader::CIE>* cies) const {
+    auto found = indices->find(cie_base);
+    if (found != indices->end()) return found->second;
+    const uint32_t index = cies->size();
+    cies->push_back(ParseCIE(cie_base));
+    indices->emplace(cie_base, index);
+    return index;
+}
+
+void ELFBinary::ParseEHFrameHeader(size_t off, size_t size, bool validate, EHFrameHeader* efh) const {
     const char* const efh_base = head_ + off;
     int efh_offset = 0;
     auto efh_read = [efh_base, &efh_offset](auto* p) {
@@ -366,43 +842,60 @@ void ELFBinary::ParseEHFrameHeader(size_t off, size_t size) {
         efh_offset += sizeof(*p);
     };
 
-    efh_read(&eh_frame_header_.version);
-    efh_read(&eh_frame_header_.eh_frame_ptr_enc);
-    efh_read(&eh_frame_header_.fde_count_enc);
-    efh_read(&eh_frame_header_.table_enc);
-
-    CHECK(eh_frame_header_.version == 1);
-    CHECK(eh_frame_header_.eh_frame_ptr_enc == (DW_EH_PE_sdata4 | DW_EH_PE_pcrel));
-    CHECK(eh_frame_header_.fde_count_enc == DW_EH_PE_udata4);
-    CHECK(eh_frame_header_.table_enc == (DW_EH_PE_sdata4 | DW_EH_PE_datarel));
+    efh_read(&efh->version);
+    efh_read(&efh->eh_frame_ptr_enc);
+    efh_read(&efh->fde_count_enc);
+    efh_read(&efh->table_enc);
+
+    CHECK(efh->version == 1);
+    const Elf_Addr efh_vaddr = AddrFromOffset(off);
+    if (efh->eh_frame_ptr_enc != (DW_EH_PE_sdata4 | DW_EH_PE_pcrel) || efh->fde_count_enc != DW_EH_PE_udata4 ||
+        efh->table_enc != (DW_EH_PE_sdata4 | DW_EH_PE_datarel)) {
+        // Linkers omit the table when they cannot build it, e.g., for FDEs
+        // with unusual encodings. Walk .eh_frame up to its terminator or
+        // the end of its PT_LOAD.
+        Elf_Addr eh_frame_vaddr = 0;
+        CHECK(ReadEncodedPointer(efh->eh_frame_ptr_enc, efh_base + efh_offset, efh_vaddr + efh_offset, efh_vaddr,
+                                 &eh_frame_vaddr))
+            << "unsupported eh_frame_ptr_enc" << SOLD_LOG_DWEHPE(efh->eh_frame_ptr_enc) << SOLD_LOG_KEY(filename_);
+        LOG(INFO) << "No table in .eh_frame_hdr of " << filename_ << SOLD_LOG_DWEHPE(efh->table_enc)
+                  << ", use .eh_frame at " << HexString(eh_frame_vaddr);
+        for (const Elf_Phdr* load : loads_) {
+            if (load->p_vaddr <= eh_frame_vaddr && eh_frame_vaddr < load->p_vaddr + load->p_filesz) {
+                SynthesizeEHFrameHeader(eh_frame_vaddr, load->p_vaddr + load->p_filesz, efh);
+                return;
+            }
+        }
+        LOG(FATAL) << ".eh_frame at " << HexString(eh_frame_vaddr) << " is not in PT_LOAD" << SOLD_LOG_KEY(filename_);
+    }
 
-    efh_read(&eh_frame_header_.eh_frame_ptr);
-    efh_read(&eh_frame_header_.fde_count);
+    efh_read(&efh->eh_frame_ptr);
+    efh_read(&efh->fde_count);
 
-    LOG(INFO) << "ParseEHFrameHeader" << SOLD_LOG_KEY(off) << SOLD_LOG_KEY(size) << SOLD_LOG_8BITS(eh_frame_header_.version)
-              << SOLD_LOG_DWEHPE(eh_frame_header_.eh_frame_ptr_enc) << SOLD_LOG_DWEHPE(eh_frame_header_.fde_count_enc)
-              << SOLD_LOG_DWEHPE(eh_frame_header_.table_enc) << SOLD_LOG_32BITS(eh_frame_header_.eh_frame_ptr)
-              << SOLD_LOG_KEY(eh_frame_header_.fde_count);
+    LOG(INFO) << "ParseEHFrameHeader" << SOLD_LOG_KEY(off) << SOLD_LOG_KEY(size) << SOLD_LOG_8BITS(efh->version)
+              << SOLD_LOG_DWEHPE(efh->eh_frame_ptr_enc) << SOLD_LOG_DWEHPE(efh->fde_count_enc)
+              << SOLD_LOG_DWEHPE(efh->table_enc) << SOLD_LOG_32BITS(efh->eh_frame_ptr)
+              << SOLD_LOG_KEY(efh->fde_count);
 
-    CHECK(efh_offset + eh_frame_header_.fde_count * (sizeof(int32_t) * 2) <= size)
-        << SOLD_LOG_KEY(efh_offset + eh_frame_header_.fde_count * (sizeof(int32_t) * 2)) << SOLD_LOG_KEY(size);
+    CHECK(efh_offset + efh->fde_count * (sizeof(int32_t) * 2) <= size)
+        << SOLD_LOG_KEY(efh_offset + efh->fde_count * (sizeof(int32_t) * 2)) << SOLD_LOG_KEY(size);
 
-    for (int i = 0; i < eh_frame_header_.fde_count; i++) {
+    efh->table_base = efh_vaddr;
+    std::map<const char*, uint32_t> cie_indices;
+    efh->table.reserve(efh->fde_count);
+    efh->fdes.reserve(efh->fde_count);
+    for (uint32_t i = 0; i < efh->fde_count; i++) {
         EHFrameHeader::FDETableEntry e;
         efh_read(&e.initial_loc);
         efh_read(&e.fde_ptr);
-        eh_frame_header_.table.emplace_back(e);
+        efh->table.emplace_back(e);
 
-        LOG(INFO) << SOLD_LOG_32BITS(e.initial_loc) << SOLD_LOG_32BITS(e.fde_ptr) << SOLD_LOG_32BITS(off + e.fde_ptr)
-                  << SOLD_LOG_32BITS(AddrFromOffset(off)) << SOLD_LOG_32BITS(AddrFromOffset(off) + e.fde_ptr)
-                  << SOLD_LOG_32BITS(OffsetFromAddr(AddrFromOffset(off) + e.fde_ptr));
+        VLOG(1) << SOLD_LOG_32BITS(e.initial_loc) << SOLD_LOG_32BITS(e.fde_ptr) << SOLD_LOG_32BITS(off + e.fde_ptr)
+                << SOLD_LOG_32BITS(efh_vaddr) << SOLD_LOG_32BITS(efh_vaddr + e.fde_ptr) << SOLD_LOG_32BITS(OffsetFromAddr(efh_vaddr + e.fde_ptr));
 
         EHFrameHeader::FDE fde = {};
-        EHFrameHeader::CIE cie = {};
-        cie.FDE_encoding = DW_EH_PE_SOLD_DUMMY;
-        cie.LSDA_encoding = DW_EH_PE_SOLD_DUMMY;
-
-        const char* const fde_base = head_ + OffsetFromAddr(AddrFromOffset(off) + e.fde_ptr);
+        const Elf_Addr fde_vaddr = efh_vaddr + e.fde_ptr;
+        const char* const fde_base = head_ + OffsetFromAddr(fde_vaddr);
         int fde_offset = 0;
         auto fde_read = [fde_base, &fde_offset](auto* p) {
             memcpy(p, fde_base + fde_offset, sizeof(*p));
@@ -415,94 +908,119 @@ void ELFBinary::ParseEHFrameHeader(size_t off, size_t size) {
         }
         fde_read(&fde.CIE_delta);
 
-        // fde_base + fde_offset - sizeof(int32_t) is the address of fde.CIE_delta.
-        const char* const cie_base =
-            head_ + OffsetFromAddr(AddrFromOffset(fde_base + fde_offset - sizeof(int32_t) - head_) - fde.CIE_delta);
-        int cie_offset = 0;
-        auto cie_read = [cie_base, &cie_offset](auto* p) {
-            memcpy(p, cie_base + cie_offset, sizeof(*p));
-            cie_offset += sizeof(*p);
-        };
-        uint32_t utmp;
-        int32_t stmp;
-
-        cie_read(&cie.length);
-        cie_read(&cie.CIE_id);
-        cie_read(&cie.version);
-        cie.aug_str = cie_base + cie_offset;
-        while (*(cie_base + cie_offset) != '\0') cie_offset++;
-        cie_offset++;
-        cie_offset = read_uleb128(reinterpret_cast<const char*>(cie_base + cie_offset), &utmp) - cie_base;  // Skip code alignment factor
-        cie_offset = read_sleb128(reinterpret_cast<const char*>(cie_base + cie_offset), &stmp) - cie_base;  // Skip data alignment factor
-        cie_offset = read_uleb128(reinterpret_cast<const char*>(cie_base + cie_offset), &utmp) - cie_base;  // Skip augmentation factor
-
-        const char* aug_head = cie.aug_str;
-        if (*aug_head == 'z') {
-            aug_head++;
-            cie_offset++;
-
-            LOG(INFO) << SOLD_LOG_8BITS(*(cie_base + cie_offset)) << SOLD_LOG_KEY(*aug_head);
-
-            // Copy from sysdeps/generic/unwind-dw2-fde.c in glibc
-            while (1) {
-                if (*aug_head == 'R') {
-                    cie_read(&cie.FDE_encoding);
-                } else if (*aug_head == 'P') {
-                    /* Personality encoding and pointer.  */
-                    /* ??? Avoid dereferencing indirect pointers, since we're
-                       faking the base address.  Gotta keep DW_EH_PE_aligned
-                       intact, however.  */
-                    cie_offset =
-                        read_encoded_value_with_base(*(cie_base + cie_offset) & 0x7F, 0, cie_base + cie_offset + 1, &utmp) - cie_base;
-                } else if (*aug_head == 'L') {
-                    cie_read(&cie.LSDA_encoding);
-                } else {
-                    if (*aug_head != '\0') {
-                        LOG(WARNING) << "unknown augmentation" << SOLD_LOG_KEY(*aug_head) << SOLD_LOG_8BITS(*aug_head);
-                    }
-                    break;
-                }
-                aug_head++;
-            }
-        }
+        // fde_vaddr + fde_offset - sizeof(int32_t) is the address of fde.CIE_delta.
+        const char* const cie_base = head_ + OffsetFromAddr(fde_vaddr + fde_offset - sizeof(int32_t) - fde.CIE_delta);
+        fde.cie_index = FindOrParseCIE(cie_base, &cie_indices, &efh->cies);
+        const EHFrameHeader::CIE& cie = efh->cies[fde.cie_index];
 
+        const Elf_Addr initial_loc_vaddr = fde_vaddr + fde_offset;
+        Elf_Addr pc_begin = 0;
+        const char* const pc_range = ReadEncodedPointer(cie.FDE_encoding, fde_base + fde_offset, initial_loc_vaddr, 0, &pc_begin);
+        CHECK(pc_range && ReadPCRange(cie.FDE_encoding, pc_range, &fde.pc_range))
+            << "unsupported FDE encoding at " << HexString(fde_vaddr) << SOLD_LOG_DWEHPE(cie.FDE_encoding) << SOLD_LOG_KEY(filename_);
         fde_read(&fde.initial_loc);
 
-        LOG(INFO) << "ParseEHFrameHeader table[" << i << "] = {" << SOLD_LOG_32BITS(e.initial_loc) << SOLD_LOG_32BITS(e.fde_ptr)
-                  << "} FDE = {" << SOLD_LOG_32BITS(fde.length) << SOLD_LOG_64BITS(fde.extended_length) << SOLD_LOG_32BITS(fde.CIE_delta)
-                  << SOLD_LOG_32BITS(fde.initial_loc) << "} CIE = {" << SOLD_LOG_32BITS(cie.length) << SOLD_LOG_32BITS(cie.CIE_id)
-                  << SOLD_LOG_8BITS(cie.version) << SOLD_LOG_KEY(cie.aug_str) << SOLD_LOG_DWEHPE(cie.FDE_encoding)
-                  << SOLD_LOG_DWEHPE(cie.LSDA_encoding) << "}";
+        VLOG(1) << "ParseEHFrameHeader table[" << i << "] = {" << SOLD_LOG_32BITS(e.initial_loc) << SOLD_LOG_32BITS(e.fde_ptr)
+                << "} FDE = {" << SOLD_LOG_32BITS(fde.length) << SOLD_LOG_64BITS(fde.extended_length) << SOLD_LOG_32BITS(fde.CIE_delta)
+                << SOLD_LOG_32BITS(fde.initial_loc) << "}";
+
+        if (validate) {
+            // The table must be sorted and point to FDEs of the same
+            // functions.
+            CHECK(cie.CIE_id == 0) << "FDE at " << HexString(fde_vaddr) << " does not refer to a CIE" << SOLD_LOG_KEY(filename_);
+            CHECK(efh_vaddr + e.initial_loc == pc_begin)
+                << "FDE at " << HexString(fde_vaddr) << " is not for " << HexString(efh_vaddr + e.initial_loc) << SOLD_LOG_KEY(filename_);
+            CHECK(i == 0 || efh->table[i - 1].initial_loc <= e.initial_loc)
+                << ".eh_frame_hdr is not sorted at " << i << SOLD_LOG_KEY(filename_);
+        }
 
-        CHECK(cie.FDE_encoding == (DW_EH_PE_sdata4 | DW_EH_PE_pcrel));
-        CHECK(cie.LSDA_encoding == (DW_EH_PE_sdata4 | DW_EH_PE_pcrel) || cie.LSDA_encoding == DW_EH_PE_SOLD_DUMMY);
+        efh->fdes.emplace_back(fde);
+    }
+    SortFDETable(efh, filename_);
+    LOG(INFO) << "ParseEHFrameHeader " << SOLD_LOG_KEY(efh->fde_count) << SOLD_LOG_KEY(efh->cies.size());
+}
 
-        eh_frame_header_.fdes.emplace_back(fde);
-        eh_frame_header_.cies.emplace_back(cie);
+void ELFBinary::SynthesizeEHFrameHeader(Elf_Addr start, Elf_Addr end, EHFrameHeader* efh) const {
+    efh->version = 1;
+    efh->eh_frame_ptr_enc = DW_EH_PE_sdata4 | DW_EH_PE_pcrel;
+    efh->fde_count_enc = DW_EH_PE_udata4;
+    efh->table_enc = DW_EH_PE_sdata4 | DW_EH_PE_datarel;
+    efh->table_base = 0;
+    // As if .eh_frame_hdr were at address 0. eh_frame_ptr is at 4.
+    efh->eh_frame_ptr = ToInt32(start - 4, filename_);
+    efh->table.clear();
+    efh->fdes.clear();
+    efh->cies.clear();
+
+    const char* const eh_frame_base = head_ + OffsetFromAddr(start);
+    std::map<const char*, uint32_t> cie_indices;
+    for (Elf_Addr pos = start; pos + sizeof(uint32_t) <= end;) {
+        const char* const p = eh_frame_base + (pos - start);
+        EHFrameHeader::FDE fde = {};
+        memcpy(&fde.length, p, sizeof(fde.length));
+        // The terminator.
+        if (fde.length == 0) break;
+        uint64_t length = fde.length;
+        Elf_Addr cie_ptr_vaddr = pos + sizeof(fde.length);
+        if (fde.length == 0xffffffff) {
+            memcpy(&fde.extended_length, p + sizeof(fde.length), sizeof(fde.extended_length));
+            length = fde.extended_length;
+            cie_ptr_vaddr += sizeof(fde.extended_length);
+        }
+        const Elf_Addr next = cie_ptr_vaddr + length;
+        CHECK_LE(next, end) << ".eh_frame is truncated at " << HexString(pos) << SOLD_LOG_KEY(filename_);
+        const char* const cie_ptr = eh_frame_base + (cie_ptr_vaddr - start);
+        memcpy(&fde.CIE_delta, cie_ptr, sizeof(fde.CIE_delta));
+
+        // CIEs have 0 in place of CIE_delta.
+        if (fde.CIE_delta != 0) {
+            const char* const cie_base = head_ + OffsetFromAddr(cie_ptr_vaddr - fde.CIE_delta);
+            fde.cie_index = FindOrParseCIE(cie_base, &cie_indices, &efh->cies);
+            const EHFrameHeader::CIE& cie = efh->cies[fde.cie_index];
+
+            const Elf_Addr pc_begin_vaddr = cie_ptr_vaddr + sizeof(fde.CIE_delta);
+            Elf_Addr pc_begin = 0;
+            const char* const pc_range = ReadEncodedPointer(cie.FDE_encoding, cie_ptr + sizeof(fde.CIE_delta), pc_begin_vaddr, 0, &pc_begin);
+            CHECK(pc_range && ReadPCRange(cie.FDE_encoding, pc_range, &fde.pc_range))
+                << "unsupported FDE encoding at " << HexString(pos) << SOLD_LOG_DWEHPE(cie.FDE_encoding) << SOLD_LOG_KEY(filename_);
+            // FDEs of discarded functions have 0.
+            if (pc_begin) {
+                fde.initial_loc = ToInt32(pc_begin - pc_begin_vaddr, filename_);
+                efh->table.push_back(EHFrameHeader::FDETableEntry{ToInt32(pc_begin, filename_), ToInt32(pos, filename_)});
+                efh->fdes.push_back(fde);
+            }
+        }
+        pos = next;
     }
+
+    efh->fde_count = efh->table.size();
+    SortFDETable(efh, filename_);
+    LOG(INFO) << "SynthesizeEHFrameHeader " << SOLD_LOG_KEY(efh->fde_count) << SOLD_LOG_KEY(efh->cies.size()) << SOLD_LOG_KEY(filename_);
 }
 
 std::string ELFBinary::ShowEHFrame() {
+    const EHFrameHeader& efh = *eh_frame_header();
     std::stringstream ss;
 
-    ss << "version: " << HexString(eh_frame_header_.version) << "\n";
-    ss << "eh_frame_ptr_enc: " << ShowDW_EH_PE(eh_frame_header_.eh_frame_ptr_enc) << "\n";
-    ss << "fde_count_enc: " << ShowDW_EH_PE(eh_frame_header_.fde_count_enc) << "\n";
-    ss << "table_enc: " << ShowDW_EH_PE(eh_frame_header_.table_enc) << "\n";
-    ss << "eh_frame_ptr: " << HexString(eh_frame_header_.eh_frame_ptr) << "\n";
-    ss << "fde_count: " << eh_frame_header_.fde_count << "\n";
-    for (int i = 0; i < eh_frame_header_.fde_count; i++) {
+    ss << "version: " << HexString(efh.version) << "\n";
+    ss << "eh_frame_ptr_enc: " << ShowDW_EH_PE(efh.eh_frame_ptr_enc) << "\n";
+    ss << "fde_count_enc: " << ShowDW_EH_PE(efh.fde_count_enc) << "\n";
+    ss << "table_enc: " << ShowDW_EH_PE(efh.table_enc) << "\n";
+    ss << "eh_frame_ptr: " << HexString(efh.eh_frame_ptr) << "\n";
+    ss << "fde_count: " << efh.fde_count << "\n";
+    for (uint32_t i = 0; i < efh.fde_count; i++) {
+        const EHFrameHeader::CIE& cie = efh.cies[efh.fdes[i].cie_index];
         ss << "---------- table[" << i << "] ----------\n";
-        ss << "initial_loc: " << HexString(eh_frame_header_.table[i].initial_loc) << "\n";
-        ss << "fde_ptr: " << HexString(eh_frame_header_.table[i].fde_ptr) << "\n";
-        ss << "cie.length: " << HexString(eh_frame_header_.cies[i].length) << "\n";
-        ss << "cie.CIE_id: " << HexString(eh_frame_header_.cies[i].CIE_id) << "\n";
-        ss << "cie.version: " << HexString(eh_frame_header_.cies[i].version) << "\n";
-        ss << "cie.FDE_encoding: " << ShowDW_EH_PE(eh_frame_header_.cies[i].FDE_encoding) << "\n";
-        ss << "cie.LSDA_encoding: " << ShowDW_EH_PE(eh_frame_header_.cies[i].LSDA_encoding) << "\n";
-        ss << "fde.length: " << HexString(eh_frame_header_.fdes[i].length) << "\n";
-        ss << "fde.CIE_delta: " << HexString(eh_frame_header_.fdes[i].CIE_delta) << "\n";
-        ss << "fde.initial_loc: " << HexString(eh_frame_header_.fdes[i].initial_loc) << "\n";
+        ss << "initial_loc: " << HexString(efh.table[i].initial_loc) << "\n";
+        ss << "fde_ptr: " << HexString(efh.table[i].fde_ptr) << "\n";
+        ss << "cie.length: " << HexString(cie.length) << "\n";
+        ss << "cie.CIE_id: " << HexString(cie.CIE_id) << "\n";
+        ss << "cie.version: " << HexString(cie.version) << "\n";
+        ss << "cie.FDE_encoding: " << ShowDW_EH_PE(cie.FDE_encoding) << "\n";
+        ss << "cie.LSDA_encoding: " << ShowDW_EH_PE(cie.LSDA_encoding) << "\n";
+        ss << "fde.length: " << HexString(efh.fdes[i].length) << "\n";
+        ss << "fde.CIE_delta: " << HexString(efh.fdes[i].CIE_delta) << "\n";
+        ss << "fde.initial_loc: " << HexString(efh.fdes[i].initial_loc) << "\n";
     }
 
     return ss.str();
@@ -592,8 +1110,12 @@ void ELFBinary::ParseFuncArray(uintptr_t* array, uintptr_t size, std::vector<uin
 }
 
 Elf_Addr ELFBinary::OffsetFromAddr(const Elf_Addr addr) const {
-    for (Elf_Phdr* phdr : loads_) {
-        if (phdr->p_vaddr <= addr && addr < phdr->p_vaddr + phdr->p_memsz) {
+    // The last PT_LOAD which starts at or before addr.
+    auto found = std::upper_bound(loads_by_vaddr_.begin(), loads_by_vaddr_.end(), addr,
+                                  [](Elf_Addr a, const Elf_Phdr* phdr) { return a < phdr->p_vaddr; });
+    if (found != loads_by_vaddr_.begin()) {
+        const Elf_Phdr* phdr = *std::prev(found);
+        if (addr < phdr->p_vaddr + phdr->p_memsz) {
             return addr - phdr->p_vaddr + phdr->p_offset;
         }
     }
@@ -604,8 +1126,11 @@ Elf_Addr ELFBinary::OffsetFromAddr(const Elf_Addr addr) const {
 }
 
 Elf_Addr ELFBinary::AddrFromOffset(const Elf_Addr offset) const {
-    for (Elf_Phdr* phdr : loads_) {
-        if (phdr->p_offset <= offset && offset < phdr->p_offset + phdr->p_filesz) {
+    auto found = std::upper_bound(loads_by_offset_.begin(), loads_by_offset_.end(), offset,
+                                  [](Elf_Addr o, const Elf_Phdr* phdr) { return o < phdr->p_offset; });
+    if (found != loads_by_offset_.begin()) {
+        const Elf_Phdr* phdr = *std::prev(found);
+        if (offset < phdr->p_offset + phdr->p_filesz) {
             return offset - phdr->p_offset + phdr->p_vaddr;
         }
     }
@@ -615,10 +1140,27 @@ Elf_Addr ELFBinary::AddrFromOffset(const Elf_Addr offset) const {
     LOG(FATAL) << "Offset " << HexString(offset, 16) << " cannot be resolved";
 }
 
-std::string ELFBinary::ShowDynSymtab() {
+std::pair<ELFBinary::RelIterator, ELFBinary::RelIterator> ELFBinary::FindRels(Elf_Addr start, Elf_Addr end) {
+    {
+        std::lock_guard<std::mutex> lock(rels_by_offset_mu_);
+        if (!rels_indexed_) {
+            rels_indexed_ = true;
+            rels_by_offset_.reserve(num_rels_);
+            for (size_t i = 0; i < num_rels_; ++i) rels_by_offset_.push_back(&rel_[i]);
+            std::stable_sort(rels_by_offset_.begin(), rels_by_offset_.end(),
+                             [](const Elf_Rel* a, const Elf_Rel* b) { return a->r_offset < b->r_offset; });
+        }
+    }
+    auto less = [](const Elf_Rel* rel, Elf_Addr addr) { return rel->r_offset < addr; };
+    RelIterator first = std::lower_bound(rels_by_offset_.cbegin(), rels_by_offset_.cend(), start, less);
+    RelIterator last = std::lower_bound(first, rels_by_offset_.cend(), end, less);
+    return std::make_pair(first, last);
+}
+
+std::string ELFBinary::ShowDynSymtab(const std::map<std::string, std::string>& filename_to_soname) {
     LOG(INFO) << "ShowDynSymtab";
     std::stringstream ss;
-    for (auto it : syms_) {
+    for (const Syminfo& it : GetSymbolMap(filename_to_soname)) {
         ss << it.name << ": ";
 
         if (it.versym == NO_VERSION_INFO) {
@@ -674,24 +1216,86 @@ std::string ELFBinary::ShowTLS() {
     return ss.str();
 }
 
-std::unique_ptr<ELFBinary> ReadELF(const std::string& filename) {
-    int fd = open(filename.c_str(), O_RDONLY);
-    if (fd < 0) err(1, "open failed: %s", filename.c_str());
+namespace {
 
+std::unique_ptr<ELFBinary> ReadELFImpl(const std::string& filename, int fd, MetadataCache* metadata_cache, bool writable, bool summary_only) {
     size_t size = lseek(fd, 0, SEEK_END);
     if (size < 8 + 16) err(1, "too small file: %s", filename.c_str());
 
-    size_t mapped_size = (size + 0xfff) & ~0xfff;
+    Elf_Ehdr ehdr = {};
+    if (pread(fd, &ehdr, sizeof(ehdr), 0) < EI_NIDENT) err(1, "read failed: %s", filename.c_str());
+    if (!ELFBinary::IsELF(reinterpret_cast<const char*>(ehdr.e_ident))) err(1, "unknown file format: %s", filename.c_str());
+    if (ehdr.e_ident[EI_CLASS] != ELFCLASS64) {
+        // TODO(hamaji): Non 64bit ELF isn't supported yet.
+        close(fd);
+        return nullptr;
+    }
 
-    char* p = (char*)mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
-    if (p == MAP_FAILED) err(1, "mmap failed: %s", filename.c_str());
+    const uintptr_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+    size_t mapped_size = (size + page_mask) & ~page_mask;
 
-    if (ELFBinary::IsELF(p)) {
-        if (p[EI_CLASS] != ELFCLASS64) {
-            // TODO(hamaji): Non 64bit ELF isn't supported yet.
-            return nullptr;
+    char* p;
+    if (writable) {
+        p = (char*)mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) err(1, "mmap failed: %s", filename.c_str());
+    } else {
+        CHECK_EQ(ehdr.e_phentsize, sizeof(Elf_Phdr)) << filename;
+        std::vector<Elf_Phdr> phdrs(ehdr.e_phnum);
+        const ssize_t phdrs_size = phdrs.size() * sizeof(Elf_Phdr);
+        if (pread(fd, phdrs.data(), phdrs_size, ehdr.e_phoff) != phdrs_size) err(1, "read failed: %s", filename.c_str());
+
+        // Reserve the address space of the whole file so that file offsets
+        // can be used as they are, and map only the ranges which are read.
+        p = (char*)mmap(NULL, mapped_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) err(1, "mmap failed: %s", filename.c_str());
+        uintptr_t mapped_end = 0;
+        for (const Range& r : ELFBinary::LoadRelevantRanges(&ehdr, phdrs.data(), size)) {
+            const uintptr_t start = std::max(r.start & ~page_mask, mapped_end);
+            const uintptr_t end = (r.end + page_mask) & ~page_mask;
+            if (start >= end) continue;
+            if (mmap(p + start, end - start, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, start) == MAP_FAILED) {
+                err(1, "mmap failed: %s", filename.c_str());
+            }
+            mapped_end = end;
+        }
+
+        // The dynamic section and eh_frame_hdr are parsed soon.
+        for (const Elf_Phdr& phdr : phdrs) {
+            if (phdr.p_type != PT_DYNAMIC && (phdr.p_type != PT_GNU_EH_FRAME || summary_only)) continue;
+            if (phdr.p_offset >= size) continue;
+            const uintptr_t start = phdr.p_offset & ~page_mask;
+            madvise(p + start, std::min<uintptr_t>(phdr.p_offset + phdr.p_filesz, size) - start, MADV_WILLNEED);
         }
-        return std::make_unique<ELFBinary>(filename.c_str(), fd, p, mapped_size, size);
     }
-    err(1, "unknown file format: %s", filename.c_str());
+
+    return std::make_unique<ELFBinary>(filename.c_str(), fd, p, mapped_size, size, metadata_cache, writable, summary_only);
+}
+
+int OpenOrDie(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) err(1, "open failed: %s", filename.c_str());
+    return fd;
+}
+
+}  // namespace
+
+std::unique_ptr<ELFBinary> ReadELF(const std::string& filename, MetadataCache* metadata_cache, bool writable) {
+    return ReadELFImpl(filename, OpenOrDie(filename), metadata_cache, writable, /*summary_only=*/false);
+}
+
+std::unique_ptr<ELFBinary> ReadELFSummary(const std::string& filename) {
+    return ReadELFImpl(filename, OpenOrDie(filename), nullptr, /*writable=*/false, /*summary_only=*/true);
+}
+
+std::unique_ptr<ELFBinary> ReadELFFromFd(const std::string& filename, int fd, MetadataCache* metadata_cache) {
+    return ReadELFImpl(filename, fd, metadata_cache, /*writable=*/false, /*summary_only=*/false);
+}
+
+std::unique_ptr<ELFBinary> ReadELFFromMemory(const std::string& filename, const char* data, size_t size) {
+    if (size < sizeof(Elf_Ehdr) || !ELFBinary::IsELF(data)) errx(1, "unknown file format: %s", filename.c_str());
+    CHECK_EQ(reinterpret_cast<uintptr_t>(data) % 8, 0) << filename << " must be aligned to 8 bytes";
+    const Elf_Ehdr* ehdr = reinterpret_cast<const Elf_Ehdr*>(data);
+    // TODO(hamaji): Non 64bit ELF isn't supported yet.
+    if (ehdr->e_ident[EI_CLASS] != ELFCLASS64) return nullptr;
+    return std::make_unique<ELFBinary>(filename, -1, const_cast<char*>(data), 0, size);
 }
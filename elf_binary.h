@@ -16,27 +16,51 @@
 #pragma once
 
 #include "hash.h"
+#include "metadata_cache.h"
 #include "utils.h"
 
 #include <cassert>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 
 class ELFBinary {
 public:
-    ELFBinary(const std::string& filename, int fd, char* head, size_t mapped_size, size_t filesize);
+    // The kind of the version reference returned by GetVersionRef.
+    enum VersionRefKind : uint32_t {
+        kNoVersionRef = 0,
+        // The file is the vn_file of Elf_Verneed.
+        kVerneedRef = 1,
+        // The file is the soname in Elf_Verdef.
+        kVerdefRef = 2,
+    };
+
+    // When `summary_only` is true, the contents are released after the
+    // dynamic section is parsed. See ReadELFSummary. When `mapped_size` is
+    // 0, `head` is borrowed from the caller and never unmapped.
+    ELFBinary(const std::string& filename, int fd, char* head, size_t mapped_size, size_t filesize,
+              MetadataCache* metadata_cache = nullptr, bool writable = false, bool summary_only = false);
 
     ~ELFBinary();
 
     static bool IsELF(const char* p);
 
+    // LoadRelevantRanges returns the sorted file ranges which sold reads: the
+    // ELF header, the program headers and the contents of PT_LOAD,
+    // PT_DYNAMIC, PT_GNU_EH_FRAME, PT_TLS and PT_INTERP. Others such as
+    // section headers and .debug_* sections are never read.
+    static std::vector<Range> LoadRelevantRanges(const Elf_Ehdr* ehdr, const Elf_Phdr* phdrs, size_t filesize);
+
     const std::string& filename() const { return filename_; }
 
     const Elf_Ehdr* ehdr() const { return ehdr_; }
     const std::vector<Elf_Phdr*> phdrs() const { return phdrs_; }
-    std::vector<Elf_Phdr*> phdrs_mut() const { return phdrs_; }
+    std::vector<Elf_Phdr*> phdrs_mut() const {
+        CHECK(writable_);
+        return phdrs_;
+    }
     const std::vector<Elf_Phdr*> loads() const { return loads_; }
     const Elf_Phdr* tls() const { return tls_; }
     const Elf_Phdr* gnu_stack() const { return gnu_stack_; }
@@ -48,22 +72,46 @@ public:
     const std::string& rpath() const { return rpath_; }
 
     const Elf_Sym* symtab() const { return symtab_; }
-    Elf_Sym* symtab_mut() const { return symtab_; }
+    Elf_Sym* symtab_mut() const {
+        CHECK(writable_);
+        return symtab_;
+    }
     const Elf_Verneed* verneed() const { return verneed_; }
-    Elf_Verneed* verneed_mut() const { return verneed_; }
+    Elf_Verneed* verneed_mut() const {
+        CHECK(writable_);
+        return verneed_;
+    }
     const Elf_Versym* versym() const { return versym_; }
     const Elf_Xword verneednum() const { return verneednum_; }
     const Elf_Rel* rel() const { return rel_; }
     size_t num_rels() const { return num_rels_; }
     const Elf_Rel* plt_rel() const { return plt_rel_; }
     size_t num_plt_rels() const { return num_plt_rels_; }
-    const EHFrameHeader* eh_frame_header() const { return &eh_frame_header_; }
+    // eh_frame_header parses PT_GNU_EH_FRAME at the first call, so only
+    // bundled libraries pay for it. When the input has no usable table in
+    // .eh_frame_hdr, the table is built from .eh_frame, which is found by
+    // eh_frame_ptr or the section headers. fde_count is 0 when neither is
+    // available.
+    // With `validate`, every FDE is checked against .eh_frame_hdr. This is
+    // for debugging sold and its inputs.
+    const EHFrameHeader* eh_frame_header(bool validate = false) const;
     const char* strtab() const { return strtab_; }
 
     const char* head() const { return head_; }
-    char* head_mut() const { return head_; }
+    char* head_mut() const {
+        CHECK(writable_);
+        return head_;
+    }
     size_t filesize() const { return filesize_; }
     size_t mapped_size() const { return mapped_size_; }
+    // Only names such as soname() and neededs() are available when this is
+    // false.
+    bool has_contents() const { return head_ != nullptr; }
+    // File ranges accessible through head().
+    const std::vector<Range>& mapped_ranges() const { return mapped_ranges_; }
+
+    // Advise passes `advice` of madvise(2) for the file range.
+    void Advise(uintptr_t offset, size_t size, int advice) const;
 
     const std::string& name() const { return name_; }
 
@@ -71,10 +119,15 @@ public:
     uintptr_t fini() const { return fini_; }
     const uintptr_t init_array_addr() const { return init_array_addr_; };
     const uintptr_t fini_array_addr() const { return fini_array_addr_; };
+    uintptr_t init_arraysz() const { return init_arraysz_; }
+    uintptr_t fini_arraysz() const { return fini_arraysz_; }
     const std::vector<uintptr_t>& init_array() const { return init_array_; }
     const std::vector<uintptr_t>& fini_array() const { return fini_array_; }
 
-    const std::vector<Syminfo>& GetSymbolMap() const { return syms_; }
+    // GetSymbolMap returns the symbols read by ReadDynSymtab with vn_file of
+    // their version references resolved by `filename_to_soname` of the
+    // link, which can differ between links sharing a pooled binary.
+    std::vector<Syminfo> GetSymbolMap(const std::map<std::string, std::string>& filename_to_soname) const;
 
     Range GetRange() const;
 
@@ -85,8 +138,16 @@ public:
     bool IsOffsetInTLSData(uintptr_t offset) const;
     bool IsOffsetInTLSBSS(uintptr_t offset) const;
 
-    std::set<int> CollectSymbolsFromDynamic();
-    void ReadDynSymtab(const std::map<std::string, std::string>& filename_to_soname);
+    // CollectSymbolsFromDynamic marks the indices in .dynsym found in the
+    // (GNU or ELF) hash table and the relocations. The size of the result is
+    // the number of symbols as far as they and section headers tell.
+    std::vector<bool> CollectSymbolsFromDynamic();
+    // ReadDynSymtab fills GetSymbolMap. It reads .dynsym only at the first
+    // call because an ELFBinary in LibraryPool is shared by Sold instances.
+    void ReadDynSymtab();
+    // SymbolGnuHash returns GnuHashKey of the index-th symbol in .dynsym,
+    // taken from .gnu.hash when the symbol is in its chains.
+    uint32_t SymbolGnuHash(uint32_t index);
 
     const char* Str(uintptr_t name) { return strtab_ + name; }
 
@@ -100,39 +161,86 @@ public:
 
     void PrintVersyms();
 
-    std::string ShowDynSymtab();
+    std::string ShowDynSymtab(const std::map<std::string, std::string>& filename_to_soname);
     std::string ShowDtRela();
     std::string ShowVersion();
     std::string ShowTLS();
     std::string ShowEHFrame();
 
     std::pair<std::string, std::string> GetVersion(int index, const std::map<std::string, std::string>& filename_to_soname);
+    // GetVersionRef returns the version of the symbol without resolving
+    // vn_file to a soname. This does not depend on other libraries.
+    VersionRefKind GetVersionRef(int index, std::string* file, std::string* version);
 
     Elf_Addr OffsetFromAddr(const Elf_Addr addr) const;
     Elf_Addr AddrFromOffset(const Elf_Addr offset) const;
 
+    using RelIterator = std::vector<const Elf_Rel*>::const_iterator;
+    // FindRels returns the entries of rel() whose r_offset is in [start, end)
+    // sorted by r_offset. The index is built at the first call.
+    std::pair<RelIterator, RelIterator> FindRels(Elf_Addr start, Elf_Addr end);
+
 private:
     void ParsePhdrs();
-    void ParseEHFrameHeader(size_t off, size_t size);
+    // NumSymbolsFromSectionHeaders returns the size of .dynsym in section
+    // headers, or 0 when the input has no usable section headers.
+    size_t NumSymbolsFromSectionHeaders() const;
+    // NumDynSymbols returns an upper bound of the indices in .dynsym used by
+    // the hash tables, relocations and section headers.
+    size_t NumDynSymbols() const;
+    // MetadataContentHash hashes the parts of the input which a summary in
+    // MetadataCache depends on.
+    uint64_t MetadataContentHash() const;
+    // FindSection reads the section headers, which are usually not mapped,
+    // and returns the one named `name`.
+    bool FindSection(const char* name, Elf_Shdr* out) const;
+    bool ReadFileRange(uintptr_t offset, size_t size, void* out) const;
+    void ParseEHFrameHeader(size_t off, size_t size, bool validate, EHFrameHeader* efh) const;
+    // SynthesizeEHFrameHeader walks .eh_frame in [start, end) and builds the
+    // table sorted by the addresses of functions.
+    void SynthesizeEHFrameHeader(Elf_Addr start, Elf_Addr end, EHFrameHeader* efh) const;
+    EHFrameHeader::CIE ParseCIE(const char* cie_base) const;
+    // FindOrParseCIE returns the index in `cies` of the CIE at `cie_base`,
+    // which is parsed and appended at its first use.
+    uint32_t FindOrParseCIE(const char* cie_base, std::map<const char*, uint32_t>* indices, std::vector<EHFrameHeader::CIE>* cies) const;
     void ParseDynamic(size_t off, size_t size);
     void ParseFuncArray(uintptr_t* array, uintptr_t size, std::vector<uintptr_t>* out);
+    void ReadDynSymtabFromCache();
+    bool InGnuHashChains(size_t index) const;
+    uint32_t InputGnuHash(size_t index, const char* name) const;
+    void FillSymbolGnuHashes(const std::vector<size_t>& indices);
+    static std::string ResolveVersionFile(VersionRefKind kind, const std::string& file,
+                                          const std::map<std::string, std::string>& filename_to_soname);
+    void ReleaseContents();
 
     const std::string filename_;
     int fd_;
     char* head_;
     size_t filesize_;
+    // 0 when head_ is borrowed. See ReadELFFromMemory.
     size_t mapped_size_;
+    std::vector<Range> mapped_ranges_;
+    // Only renamer modifies inputs. Sold uses Overlay instead.
+    const bool writable_;
 
     Elf_Ehdr* ehdr_{nullptr};
     std::vector<Elf_Phdr*> phdrs_;
     std::vector<Elf_Phdr*> loads_;
+    // PT_LOADs sorted by p_vaddr and by p_offset for OffsetFromAddr and
+    // AddrFromOffset. PT_LOADs never overlap in either space. Empty ranges
+    // are omitted.
+    std::vector<const Elf_Phdr*> loads_by_vaddr_;
+    std::vector<const Elf_Phdr*> loads_by_offset_;
     Elf_Phdr* tls_{nullptr};
     Elf_Phdr* gnu_stack_{nullptr};
     Elf_Phdr* gnu_relro_{nullptr};
     const char* strtab_{nullptr};
     Elf_Sym* symtab_{nullptr};
 
-    EHFrameHeader eh_frame_header_;
+    mutable EHFrameHeader eh_frame_header_{};
+    mutable std::mutex eh_frame_header_mu_;
+    mutable bool eh_frame_header_parsed_{false};
+    mutable bool eh_frame_header_validated_{false};
 
     std::vector<std::string> neededs_;
     // This is the name specified in the DT_SONAME field.
@@ -144,6 +252,10 @@ private:
     size_t num_rels_{0};
     Elf_Rel* plt_rel_{nullptr};
     size_t num_plt_rels_{0};
+    // rel_ sorted by r_offset for FindRels.
+    std::vector<const Elf_Rel*> rels_by_offset_;
+    std::mutex rels_by_offset_mu_;
+    bool rels_indexed_{false};
 
     Elf_GnuHash* gnu_hash_{nullptr};
     Elf_Hash* hash_{nullptr};
@@ -162,7 +274,15 @@ private:
 
     // This is the name on the filsysytem
     std::string name_;
+    // The soname of each symbol is vn_file as is for version references
+    // of kind kVerneedRef in sym_version_kinds_.
     std::vector<Syminfo> syms_;
+    std::vector<VersionRefKind> sym_version_kinds_;
+    std::mutex syms_mu_;
+    bool syms_read_{false};
+    // GnuHashKey of symbols read by ReadDynSymtab, indexed as .dynsym.
+    std::vector<uint32_t> sym_gnu_hashes_;
+    size_t num_gnu_hashed_{0};
 
     int nsyms_{0};
 
@@ -171,6 +291,26 @@ private:
     Elf_Verdef* verdef_{nullptr};
     Elf_Xword verneednum_{0};
     Elf_Xword verdefnum_{0};
+
+    MetadataCache* metadata_cache_{nullptr};
+    uint64_t metadata_content_hash_{0};
+    std::unique_ptr<MetadataCache::Entry> cached_;
 };
 
-std::unique_ptr<ELFBinary> ReadELF(const std::string& filename);
+// ReadELF maps LoadRelevantRanges of the input read-only. When `writable` is
+// true, the whole input is mapped copy-on-write so that it can be modified
+// through *_mut().
+std::unique_ptr<ELFBinary> ReadELF(const std::string& filename, MetadataCache* metadata_cache = nullptr, bool writable = false);
+
+// ReadELFSummary reads only the names in the dynamic section, e.g., soname,
+// DT_NEEDED and DT_RUNPATH, and unmaps the file. This is enough for
+// libraries which are not linked.
+std::unique_ptr<ELFBinary> ReadELFSummary(const std::string& filename);
+
+// ReadELFFromFd is ReadELF for an opened file. The result takes `fd`.
+// `filename` is used as the name of the binary, e.g., for $ORIGIN.
+std::unique_ptr<ELFBinary> ReadELFFromFd(const std::string& filename, int fd, MetadataCache* metadata_cache = nullptr);
+
+// ReadELFFromMemory reads a binary in a buffer without copying it. `data`
+// must be aligned to 8 bytes and outlive the result.
+std::unique_ptr<ELFBinary> ReadELFFromMemory(const std::string& filename, const char* data, size_t size);
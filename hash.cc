@@ -15,21 +15,338 @@
 
 #include "hash.h"
 
-uint32_t CalcGnuHash(const std::string& name) {
-    uint32_t h = 5381;
-    for (unsigned char c : name) {
-        h = h * 33 + c;
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Update of the hashers hashes `size` bytes from `p` on top of `h`.
+struct GnuHasher {
+    static constexpr uint32_t kInit = 5381;
+    static constexpr bool kSysV = false;
+
+    static uint32_t Update(uint32_t h, const unsigned char* p, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            h = h * 33 + p[i];
+        }
+        return h;
+    }
+};
+
+struct SysVHasher {
+    static constexpr uint32_t kInit = 0;
+    static constexpr bool kSysV = true;
+
+    static uint32_t Update(uint32_t h, const unsigned char* p, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            h = (h << 4) + p[i];
+            const uint32_t g = h & 0xf0000000;
+            h ^= g >> 24;
+            h ^= g;
+        }
+        return h;
+    }
+};
+
+template <class Hasher>
+uint32_t Hash(std::string_view name) {
+    return Hasher::Update(Hasher::kInit, reinterpret_cast<const unsigned char*>(name.data()), name.size());
+}
+
+template <class Hasher>
+void HashScalar(const std::string_view* names, size_t num, uint32_t* hashes) {
+    for (size_t i = 0; i < num; i++) {
+        hashes[i] = Hash<Hasher>(names[i]);
+    }
+}
+
+// MultiBufferHash hashes N names at once. `kernel(h, p, steps)` hashes
+// 4 * steps bytes from p[i] into h[i] for all lanes. Names in a window are
+// grouped by their lengths, so the lanes of a group run the kernel for the
+// shortest one and only finish a few bytes in scalar.
+template <size_t N, class Hasher, class Kernel>
+void MultiBufferHash(const std::string_view* names, size_t num, uint32_t* hashes, Kernel kernel) {
+    // Windows keep the names being hashed in cache.
+    constexpr size_t kWindow = 1024;
+    // Counting sort by length. Longer names share the last bucket.
+    constexpr size_t kMaxBucket = 128;
+    size_t starts[kMaxBucket + 2];
+    uint16_t order[kWindow];
+
+    for (size_t w = 0; w < num; w += kWindow) {
+        const std::string_view* window = names + w;
+        const size_t size = std::min(kWindow, num - w);
+        std::fill(starts, starts + kMaxBucket + 2, 0);
+        for (size_t i = 0; i < size; i++) {
+            starts[std::min(window[i].size(), kMaxBucket) + 1]++;
+        }
+        for (size_t b = 1; b < kMaxBucket + 2; b++) {
+            starts[b] += starts[b - 1];
+        }
+        for (size_t i = 0; i < size; i++) {
+            order[starts[std::min(window[i].size(), kMaxBucket)]++] = i;
+        }
+
+        size_t g = 0;
+        for (; g + N <= size; g += N) {
+            uint32_t h[N];
+            const unsigned char* p[N];
+            size_t steps = window[order[g]].size() / 4;
+            for (size_t l = 0; l < N; l++) {
+                h[l] = Hasher::kInit;
+                p[l] = reinterpret_cast<const unsigned char*>(window[order[g + l]].data());
+                steps = std::min(steps, window[order[g + l]].size() / 4);
+            }
+            if (steps) kernel(h, p, steps);
+            for (size_t l = 0; l < N; l++) {
+                hashes[w + order[g + l]] = Hasher::Update(h[l], p[l] + steps * 4, window[order[g + l]].size() - steps * 4);
+            }
+        }
+        for (; g < size; g++) {
+            hashes[w + order[g]] = Hash<Hasher>(window[order[g]]);
+        }
+    }
+}
+
+#if defined(__x86_64__)
+
+bool HasAVX2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+bool HasAVX512() {
+    static const bool has_avx512 = __builtin_cpu_supports("avx512f");
+    return has_avx512;
+}
+
+// The gathers load 4 bytes of each lane at base + offsets[i], where base is
+// the pointer of the first lane.
+
+template <class Hasher>
+__attribute__((target("avx2"))) __m256i HashByteAVX2(__m256i h, __m256i c) {
+    if constexpr (Hasher::kSysV) {
+        h = _mm256_add_epi32(_mm256_slli_epi32(h, 4), c);
+        const __m256i g = _mm256_and_si256(h, _mm256_set1_epi32(0xf0000000));
+        return _mm256_xor_si256(_mm256_xor_si256(h, _mm256_srli_epi32(g, 24)), g);
+    } else {
+        return _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(h, 5), h), c);
+    }
+}
+
+template <class Hasher>
+__attribute__((target("avx2"))) void HashKernelAVX2(uint32_t* h, const unsigned char* const* p, size_t steps) {
+    const intptr_t b = reinterpret_cast<intptr_t>(p[0]);
+    const __m256i lo = _mm256_set_epi64x(reinterpret_cast<intptr_t>(p[3]) - b, reinterpret_cast<intptr_t>(p[2]) - b,
+                                         reinterpret_cast<intptr_t>(p[1]) - b, 0);
+    const __m256i hi = _mm256_set_epi64x(reinterpret_cast<intptr_t>(p[7]) - b, reinterpret_cast<intptr_t>(p[6]) - b,
+                                         reinterpret_cast<intptr_t>(p[5]) - b, reinterpret_cast<intptr_t>(p[4]) - b);
+    const __m256i byte = _mm256_set1_epi32(0xff);
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h));
+    for (size_t s = 0; s < steps; s++) {
+        const int* base = reinterpret_cast<const int*>(p[0] + s * 4);
+        const __m256i w = _mm256_set_m128i(_mm256_i64gather_epi32(base, hi, 1), _mm256_i64gather_epi32(base, lo, 1));
+        v = HashByteAVX2<Hasher>(v, _mm256_and_si256(w, byte));
+        v = HashByteAVX2<Hasher>(v, _mm256_and_si256(_mm256_srli_epi32(w, 8), byte));
+        v = HashByteAVX2<Hasher>(v, _mm256_and_si256(_mm256_srli_epi32(w, 16), byte));
+        v = HashByteAVX2<Hasher>(v, _mm256_srli_epi32(w, 24));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(h), v);
+}
+
+// GCC implements the unmasked AVX-512 shifts, inserts and gathers with an
+// undefined passthrough operand, which -Wmaybe-uninitialized reports. Their
+// zero-masking forms with all lanes enabled are the same instructions.
+constexpr __mmask16 kAllLanes = 0xffff;
+constexpr __mmask8 kAllLanes64 = 0xff;
+
+template <class Hasher>
+__attribute__((target("avx512f"))) __m512i HashByteAVX512(__m512i h, __m512i c) {
+    if constexpr (Hasher::kSysV) {
+        h = _mm512_add_epi32(_mm512_maskz_slli_epi32(kAllLanes, h, 4), c);
+        const __m512i g = _mm512_and_si512(h, _mm512_set1_epi32(0xf0000000));
+        return _mm512_xor_si512(_mm512_xor_si512(h, _mm512_maskz_srli_epi32(kAllLanes, g, 24)), g);
+    } else {
+        return _mm512_add_epi32(_mm512_add_epi32(_mm512_maskz_slli_epi32(kAllLanes, h, 5), h), c);
     }
-    return h;
 }
 
-uint32_t CalcHash(const std::string& name) {
-    uint32_t h = 0, g;
-    for (unsigned char c : name) {
-        h = (h << 4) + c;
-        g = h & 0xf0000000;
-        h ^= g >> 24;
-        h ^= g;
+template <class Hasher>
+__attribute__((target("avx512f"))) void HashKernelAVX512(uint32_t* h, const unsigned char* const* p, size_t steps) {
+    int64_t offsets[16];
+    for (size_t l = 0; l < 16; l++) {
+        offsets[l] = reinterpret_cast<intptr_t>(p[l]) - reinterpret_cast<intptr_t>(p[0]);
     }
+    const __m512i lo = _mm512_loadu_si512(offsets);
+    const __m512i hi = _mm512_loadu_si512(offsets + 8);
+    const __m512i byte = _mm512_set1_epi32(0xff);
+    const __m256i zero = _mm256_setzero_si256();
+    __m512i v = _mm512_loadu_si512(h);
+    for (size_t s = 0; s < steps; s++) {
+        const void* base = p[0] + s * 4;
+        const __m256i w_lo = _mm512_mask_i64gather_epi32(zero, kAllLanes64, lo, base, 1);
+        const __m256i w_hi = _mm512_mask_i64gather_epi32(zero, kAllLanes64, hi, base, 1);
+        const __m512i w_lo512 = _mm512_maskz_inserti64x4(kAllLanes64, _mm512_setzero_si512(), w_lo, 0);
+        const __m512i w = _mm512_maskz_inserti64x4(kAllLanes64, w_lo512, w_hi, 1);
+        v = HashByteAVX512<Hasher>(v, _mm512_and_si512(w, byte));
+        v = HashByteAVX512<Hasher>(v, _mm512_and_si512(_mm512_maskz_srli_epi32(kAllLanes, w, 8), byte));
+        v = HashByteAVX512<Hasher>(v, _mm512_and_si512(_mm512_maskz_srli_epi32(kAllLanes, w, 16), byte));
+        v = HashByteAVX512<Hasher>(v, _mm512_maskz_srli_epi32(kAllLanes, w, 24));
+    }
+    _mm512_storeu_si512(h, v);
+}
+
+#elif defined(__aarch64__)
+
+template <class Hasher>
+uint32x4_t HashByteNEON(uint32x4_t h, uint32x4_t c) {
+    if constexpr (Hasher::kSysV) {
+        h = vaddq_u32(vshlq_n_u32(h, 4), c);
+        const uint32x4_t g = vandq_u32(h, vdupq_n_u32(0xf0000000));
+        return veorq_u32(veorq_u32(h, vshrq_n_u32(g, 24)), g);
+    } else {
+        return vaddq_u32(vaddq_u32(vshlq_n_u32(h, 5), h), c);
+    }
+}
+
+// NEON has no gathers, so the 4 bytes of each lane are loaded in scalar.
+template <class Hasher>
+void HashKernelNEON(uint32_t* h, const unsigned char* const* p, size_t steps) {
+    const uint32x4_t byte = vdupq_n_u32(0xff);
+    uint32x4_t v = vld1q_u32(h);
+    for (size_t s = 0; s < steps; s++) {
+        uint32_t words[4];
+        for (size_t l = 0; l < 4; l++) {
+            memcpy(&words[l], p[l] + s * 4, 4);
+        }
+        const uint32x4_t w = vld1q_u32(words);
+        v = HashByteNEON<Hasher>(v, vandq_u32(w, byte));
+        v = HashByteNEON<Hasher>(v, vandq_u32(vshrq_n_u32(w, 8), byte));
+        v = HashByteNEON<Hasher>(v, vandq_u32(vshrq_n_u32(w, 16), byte));
+        v = HashByteNEON<Hasher>(v, vshrq_n_u32(w, 24));
+    }
+    vst1q_u32(h, v);
+}
+
+#endif
+
+template <class Hasher>
+void HashBatch(const std::string_view* names, size_t num, uint32_t* hashes, HashKernel kernel) {
+    if (kernel == HashKernel::kAuto) kernel = SupportedHashKernels().front();
+    switch (kernel) {
+#if defined(__x86_64__)
+        case HashKernel::kAVX512:
+            CHECK(HasAVX512());
+            return MultiBufferHash<16, Hasher>(names, num, hashes, HashKernelAVX512<Hasher>);
+        case HashKernel::kAVX2:
+            CHECK(HasAVX2());
+            return MultiBufferHash<8, Hasher>(names, num, hashes, HashKernelAVX2<Hasher>);
+#elif defined(__aarch64__)
+        case HashKernel::kNEON:
+            return MultiBufferHash<4, Hasher>(names, num, hashes, HashKernelNEON<Hasher>);
+#endif
+        case HashKernel::kScalar:
+            return HashScalar<Hasher>(names, num, hashes);
+        default:
+            LOG(FATAL) << "Unsupported hash kernel: " << HashKernelName(kernel);
+    }
+}
+
+}  // namespace
+
+std::vector<HashKernel> SupportedHashKernels() {
+    std::vector<HashKernel> kernels;
+#if defined(__x86_64__)
+    if (HasAVX512()) kernels.push_back(HashKernel::kAVX512);
+    if (HasAVX2()) kernels.push_back(HashKernel::kAVX2);
+#elif defined(__aarch64__)
+    kernels.push_back(HashKernel::kNEON);
+#endif
+    kernels.push_back(HashKernel::kScalar);
+    return kernels;
+}
+
+const char* HashKernelName(HashKernel kernel) {
+    switch (kernel) {
+        case HashKernel::kAuto:
+            return "auto";
+        case HashKernel::kScalar:
+            return "scalar";
+        case HashKernel::kAVX2:
+            return "AVX2";
+        case HashKernel::kAVX512:
+            return "AVX-512";
+        case HashKernel::kNEON:
+            return "NEON";
+    }
+    return "unknown";
+}
+
+uint32_t CalcGnuHash(std::string_view name) {
+    return Hash<GnuHasher>(name);
+}
+
+uint32_t CalcHash(std::string_view name) {
+    return Hash<SysVHasher>(name);
+}
+
+void CalcGnuHashes(const std::string_view* names, size_t num, uint32_t* hashes, HashKernel kernel) {
+    HashBatch<GnuHasher>(names, num, hashes, kernel);
+}
+
+void CalcHashes(const std::string_view* names, size_t num, uint32_t* hashes, HashKernel kernel) {
+    HashBatch<SysVHasher>(names, num, hashes, kernel);
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + (size & ~static_cast<size_t>(7));
+    uint64_t h = seed ^ (size * m);
+
+    for (; p != end; p += 8) {
+        uint64_t k;
+        memcpy(&k, p, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (size & 7) {
+        case 7:
+            h ^= static_cast<uint64_t>(p[6]) << 48;
+            [[fallthrough]];
+        case 6:
+            h ^= static_cast<uint64_t>(p[5]) << 40;
+            [[fallthrough]];
+        case 5:
+            h ^= static_cast<uint64_t>(p[4]) << 32;
+            [[fallthrough]];
+        case 4:
+            h ^= static_cast<uint64_t>(p[3]) << 24;
+            [[fallthrough]];
+        case 3:
+            h ^= static_cast<uint64_t>(p[2]) << 16;
+            [[fallthrough]];
+        case 2:
+            h ^= static_cast<uint64_t>(p[1]) << 8;
+            [[fallthrough]];
+        case 1:
+            h ^= static_cast<uint64_t>(p[0]);
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
     return h;
 }
@@ -15,6 +15,9 @@
 
 #pragma once
 
+#include <string_view>
+#include <vector>
+
 #include "utils.h"
 
 struct Elf_GnuHash {
@@ -31,9 +34,36 @@ struct Elf_GnuHash {
     uint32_t* hashvals() { return reinterpret_cast<uint32_t*>(&buckets()[nbuckets]); }
 };
 
-uint32_t CalcGnuHash(const std::string& name);
+uint32_t CalcGnuHash(std::string_view name);
+
+uint32_t CalcHash(std::string_view name);
+
+// HashKernel selects the implementation of CalcGnuHashes and CalcHashes.
+// kAuto picks the best one the CPU supports.
+enum class HashKernel { kAuto, kScalar, kAVX2, kAVX512, kNEON };
+
+// SupportedHashKernels returns the kernels other than kAuto which can run on
+// this CPU.
+std::vector<HashKernel> SupportedHashKernels();
+
+const char* HashKernelName(HashKernel kernel);
+
+// CalcGnuHashes and CalcHashes store the hashes of names[i] to hashes[i].
+// They hash several names at once in SIMD lanes (AVX-512, AVX2 or NEON) when
+// the CPU supports them.
+void CalcGnuHashes(const std::string_view* names, size_t num, uint32_t* hashes, HashKernel kernel = HashKernel::kAuto);
+void CalcHashes(const std::string_view* names, size_t num, uint32_t* hashes, HashKernel kernel = HashKernel::kAuto);
+
+// GnuHashKey is CalcGnuHash without the lowest bit, which is the form kept in
+// the chains of .gnu.hash. Symbols are keyed on it so that the values in the
+// inputs can be reused.
+inline uint32_t GnuHashKey(std::string_view name) {
+    return CalcGnuHash(name) & ~1;
+}
 
-uint32_t CalcHash(const std::string& name);
+// HashBytes is a general purpose 64bit hash (MurmurHash64A) for digests of
+// file contents. Use CalcGnuHash or CalcHash for symbol names.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
 
 struct Elf_Hash {
     uint32_t nbuckets{0};
@@ -0,0 +1,112 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "layout_state.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr char kMagic[] = "sold-layout";
+constexpr int kVersion = 1;
+
+}  // namespace
+
+bool GetFileIdentity(const std::string& filename, FileIdentity* identity) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return false;
+    identity->size = st.st_size;
+    identity->mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+    identity->ino = st.st_ino;
+    return true;
+}
+
+std::string LayoutStateFilename(const std::string& out_filename) {
+    return out_filename + ".sold-layout";
+}
+
+// The format is line-based text:
+//
+//   sold-layout VERSION
+//   code_offset OFFSET
+//   output SIZE MTIME_NS INO
+//   binary SIZE MTIME_NS INO OVERLAY_DIGEST MEM_START MEM_END FILENAME
+//   load START END
+//   ...
+//
+// load lines belong to the last binary line.
+bool LayoutState::Read(const std::string& filename) {
+    std::ifstream ifs(filename);
+    std::string magic;
+    int version;
+    if (!(ifs >> magic >> version) || magic != kMagic || version != kVersion) return false;
+
+    std::string line;
+    bool has_output = false;
+    while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        std::string kind;
+        if (!(iss >> kind)) continue;
+        if (kind == "code_offset") {
+            if (!(iss >> code_offset)) return false;
+        } else if (kind == "output") {
+            if (!(iss >> output.size >> output.mtime_ns >> output.ino)) return false;
+            has_output = true;
+        } else if (kind == "binary") {
+            Binary b;
+            if (!(iss >> b.identity.size >> b.identity.mtime_ns >> b.identity.ino >> b.overlay_digest >> b.mem_slot.start >>
+                  b.mem_slot.end)) {
+                return false;
+            }
+            iss.get();
+            if (!std::getline(iss, b.filename) || b.filename.empty()) return false;
+            binaries.push_back(b);
+        } else if (kind == "load") {
+            Range r;
+            if (binaries.empty() || !(iss >> r.start >> r.end)) return false;
+            binaries.back().load_slots.push_back(r);
+        } else {
+            return false;
+        }
+    }
+    return code_offset != 0 && has_output && !binaries.empty();
+}
+
+void LayoutState::Write(const std::string& filename) const {
+    const std::string tmp = filename + TempSuffix();
+    {
+        std::ofstream ofs(tmp);
+        ofs << kMagic << " " << kVersion << "\n";
+        ofs << "code_offset " << code_offset << "\n";
+        ofs << "output " << output.size << " " << output.mtime_ns << " " << output.ino << "\n";
+        for (const Binary& b : binaries) {
+            ofs << "binary " << b.identity.size << " " << b.identity.mtime_ns << " " << b.identity.ino << " " << b.overlay_digest << " "
+                << b.mem_slot.start << " " << b.mem_slot.end << " " << b.filename << "\n";
+            for (const Range& r : b.load_slots) {
+                ofs << "load " << r.start << " " << r.end << "\n";
+            }
+        }
+        CHECK(ofs) << "Cannot write " << tmp;
+    }
+    if (rename(tmp.c_str(), filename.c_str()) != 0) {
+        LOG(WARNING) << "Cannot write " << filename << ": " << strerror(errno);
+        unlink(tmp.c_str());
+    }
+}
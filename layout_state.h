@@ -0,0 +1,62 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+// FileIdentity tells whether a file was modified without reading it.
+struct FileIdentity {
+    uint64_t size{0};
+    uint64_t mtime_ns{0};
+    uint64_t ino{0};
+
+    bool operator==(const FileIdentity& o) const { return size == o.size && mtime_ns == o.mtime_ns && ino == o.ino; }
+    bool operator!=(const FileIdentity& o) const { return !(*this == o); }
+};
+
+bool GetFileIdentity(const std::string& filename, FileIdentity* identity);
+
+// LayoutState is the layout of an output which --incremental saves as
+// <output>.sold-layout. The next incremental link reuses the slots when
+// all binaries still fit in them, and rewrites only the segments of
+// binaries whose identities changed.
+struct LayoutState {
+    struct Binary {
+        std::string filename;
+        FileIdentity identity;
+        // Overlay::Digest of the binary.
+        uint64_t overlay_digest{0};
+        // The memory slot. The binary is placed at its start.
+        Range mem_slot;
+        // Page-aligned file slots of the PT_LOAD segments.
+        std::vector<Range> load_slots;
+    };
+
+    // The end of the slot for the dynamic sections at the head.
+    uintptr_t code_offset{0};
+    // The output written with this layout.
+    FileIdentity output;
+    std::vector<Binary> binaries;
+
+    bool Read(const std::string& filename);
+    void Write(const std::string& filename) const;
+};
+
+// LayoutStateFilename returns the filename of LayoutState for `out_filename`.
+std::string LayoutStateFilename(const std::string& out_filename);
@@ -0,0 +1,72 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "library_pool.h"
+
+LibraryPool::LibraryPool(const std::string& metadata_cache_dir) {
+    if (!metadata_cache_dir.empty()) metadata_cache_.reset(new MetadataCache(metadata_cache_dir));
+}
+
+std::vector<std::string> LibraryPool::FindCandidates(Elf_Half machine_type, const std::string& needed,
+                                                     const std::vector<std::string>& search_paths, bool search_system_paths) {
+    std::lock_guard<std::mutex> lock(mu_);
+    std::unique_ptr<LibraryResolver>& resolver = resolvers_[machine_type];
+    if (!resolver) resolver.reset(new LibraryResolver(machine_type));
+    return resolver->FindCandidates(needed, search_paths, search_system_paths);
+}
+
+ELFBinary* LibraryPool::Get(const std::string& filename) {
+    return GetSlot(&slots_, filename, false);
+}
+
+ELFBinary* LibraryPool::GetSummary(const std::string& filename) {
+    return GetSlot(&summary_slots_, filename, true);
+}
+
+void LibraryPool::GetWatchedPaths(std::vector<std::string>* libraries, std::vector<std::string>* search_paths) {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (const auto& p : slots_) libraries->push_back(p.first);
+    for (const auto& p : summary_slots_) libraries->push_back(p.first);
+    for (const auto& p : resolvers_) {
+        for (const std::string& path : p.second->WatchedPaths()) search_paths->push_back(path);
+    }
+}
+
+void LibraryPool::Invalidate(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mu_);
+    slots_.erase(filename);
+    summary_slots_.erase(filename);
+}
+
+void LibraryPool::InvalidateSearch() {
+    std::lock_guard<std::mutex> lock(mu_);
+    resolvers_.clear();
+}
+
+ELFBinary* LibraryPool::GetSlot(std::map<std::string, std::unique_ptr<Slot>>* slots, const std::string& filename, bool summary) {
+    Slot* slot;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        std::unique_ptr<Slot>& s = (*slots)[filename];
+        if (!s) s.reset(new Slot());
+        slot = s.get();
+    }
+    // Different libraries are read in parallel.
+    std::call_once(slot->once, [this, slot, &filename, summary]() {
+        slot->binary = summary ? ReadELFSummary(filename) : ReadELF(filename, metadata_cache_.get());
+        LOG(INFO) << "LibraryPool read" << (summary ? " summary: " : ": ") << filename;
+    });
+    return slot->binary.get();
+}
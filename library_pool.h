@@ -0,0 +1,75 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "elf_binary.h"
+#include "library_resolver.h"
+#include "metadata_cache.h"
+
+// LibraryPool owns libraries read by Sold. A pool can be shared by Sold
+// instances running in parallel so that each library is opened and parsed
+// only once in a process. Libraries in a pool must not be modified by Sold.
+// All methods are thread-safe.
+class LibraryPool {
+public:
+    // `metadata_cache_dir` can be empty to disable MetadataCache.
+    explicit LibraryPool(const std::string& metadata_cache_dir = "");
+
+    MetadataCache* metadata_cache() const { return metadata_cache_.get(); }
+
+    // See LibraryResolver::FindCandidates.
+    std::vector<std::string> FindCandidates(Elf_Half machine_type, const std::string& needed,
+                                            const std::vector<std::string>& search_paths, bool search_system_paths);
+
+    // Get returns the library at `filename`, reading it at the first call.
+    // Returns nullptr when the file cannot be linked, e.g., 32bit ELF.
+    ELFBinary* Get(const std::string& filename);
+
+    // GetSummary is the same as Get but returns the result of
+    // ReadELFSummary, which is enough for libraries not to be linked.
+    ELFBinary* GetSummary(const std::string& filename);
+
+    // GetWatchedPaths returns the files of the libraries in the pool and
+    // the paths which LibraryResolver::WatchedPaths returns.
+    void GetWatchedPaths(std::vector<std::string>* libraries, std::vector<std::string>* search_paths);
+
+    // Invalidate drops the library at `filename`, and InvalidateSearch drops
+    // the memoized results of FindCandidates. They must not be called while
+    // a Sold uses the pool.
+    void Invalidate(const std::string& filename);
+    void InvalidateSearch();
+
+private:
+    struct Slot {
+        std::once_flag once;
+        std::unique_ptr<ELFBinary> binary;
+    };
+
+    ELFBinary* GetSlot(std::map<std::string, std::unique_ptr<Slot>>* slots, const std::string& filename, bool summary);
+
+    std::unique_ptr<MetadataCache> metadata_cache_;
+
+    std::mutex mu_;
+    std::map<Elf_Half, std::unique_ptr<LibraryResolver>> resolvers_;
+    std::map<std::string, std::unique_ptr<Slot>> slots_;
+    std::map<std::string, std::unique_ptr<Slot>> summary_slots_;
+};
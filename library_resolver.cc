@@ -0,0 +1,199 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "library_resolver.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "ldsoconf.h"
+
+namespace {
+
+// The layout of /etc/ld.so.cache is defined in sysdeps/generic/dl-cache.h in
+// glibc. The old format may be followed by the new one, and recent glibc
+// emits only the new format.
+constexpr char kOldCacheMagic[] = "ld.so-1.7.0";
+constexpr char kNewCacheMagic[] = "glibc-ld.so.cache";
+constexpr char kNewCacheVersion[] = "1.1";
+
+constexpr size_t kOldCacheHeaderSize = 16;
+constexpr size_t kOldCacheEntrySize = 12;
+constexpr size_t kNewCacheHeaderSize = 48;
+constexpr size_t kNewCacheEntrySize = 24;
+
+constexpr int32_t kFlagElfLibc6 = 0x0003;
+constexpr int32_t kFlagX8664Lib64 = 0x0300;
+constexpr int32_t kFlagAArch64Lib64 = 0x0a00;
+
+struct NewCacheEntry {
+    int32_t flags;
+    uint32_t key;
+    uint32_t value;
+    uint32_t osversion;
+    uint64_t hwcap;
+};
+
+template <class T>
+T ReadAt(const std::string& buf, size_t off) {
+    T v;
+    memcpy(&v, buf.data() + off, sizeof(v));
+    return v;
+}
+
+}  // namespace
+
+LibraryResolver::LibraryResolver(Elf_Half machine_type, const std::string& ldsocache_filename)
+    : machine_type_(machine_type), ldsocache_filename_(ldsocache_filename) {}
+
+const std::vector<std::string>& LibraryResolver::system_paths() {
+    if (!system_paths_loaded_) {
+        system_paths_ = ldsoconf::read_ldsoconf();
+        system_paths_.push_back("/lib");
+        system_paths_.push_back("/usr/lib");
+        system_paths_.push_back("/usr/lib64");
+        system_paths_loaded_ = true;
+    }
+    return system_paths_;
+}
+
+std::vector<std::string> LibraryResolver::FindCandidates(const std::string& needed, const std::vector<std::string>& search_paths,
+                                                         bool search_system_paths) {
+    std::vector<std::string> candidates;
+    for (const std::string& path : search_paths) {
+        if (ExistsIn(path, needed)) candidates.push_back(path + '/' + needed);
+    }
+    if (!search_system_paths) return candidates;
+
+    if (!ldsocache_loaded_) {
+        LoadLdSoCache(ldsocache_filename_);
+        ldsocache_loaded_ = true;
+    }
+    auto found = ldsocache_.find(needed);
+    if (found != ldsocache_.end()) {
+        // /etc/ld.so.cache can be stale.
+        if (IsRegularFile(found->second)) {
+            LOG(INFO) << "Found " << needed << " in ld.so.cache: " << found->second;
+            candidates.push_back(found->second);
+        } else {
+            LOG(INFO) << "Ignore stale ld.so.cache entry: " << needed << " => " << found->second;
+        }
+    }
+
+    for (const std::string& path : system_paths()) {
+        if (ExistsIn(path, needed)) candidates.push_back(path + '/' + needed);
+    }
+    return candidates;
+}
+
+std::vector<std::string> LibraryResolver::WatchedPaths() const {
+    std::vector<std::string> paths;
+    if (ldsocache_loaded_) paths.push_back(ldsocache_filename_);
+    for (const auto& p : dirs_) paths.push_back(p.first);
+    return paths;
+}
+
+bool LibraryResolver::IsRegularFile(const std::string& filename) {
+    if (regular_files_.count(filename)) return true;
+
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    regular_files_.insert(filename);
+    return true;
+}
+
+bool LibraryResolver::ExistsIn(const std::string& dir, const std::string& name) {
+    // We cannot use the directory listing when DT_NEEDED has a slash.
+    if (name.find('/') == std::string::npos && !ListDirectory(dir).count(name)) {
+        return false;
+    }
+    return IsRegularFile(dir + '/' + name);
+}
+
+const std::unordered_set<std::string>& LibraryResolver::ListDirectory(const std::string& dir) {
+    auto found = dirs_.find(dir);
+    if (found != dirs_.end()) return *found->second;
+
+    std::unique_ptr<std::unordered_set<std::string>> entries(new std::unordered_set<std::string>());
+    if (DIR* d = opendir(dir.c_str())) {
+        while (struct dirent* ent = readdir(d)) {
+            if (ent->d_type == DT_DIR) continue;
+            entries->insert(ent->d_name);
+        }
+        closedir(d);
+    }
+    LOG(INFO) << "Listed " << dir << ": " << entries->size() << " entries";
+    return *dirs_.emplace(dir, std::move(entries)).first->second;
+}
+
+void LibraryResolver::LoadLdSoCache(const std::string& filename) {
+    std::ifstream f(filename, std::ios::binary);
+    if (!f) return;
+    std::stringstream ss;
+    ss << f.rdbuf();
+    const std::string buf = ss.str();
+
+    int32_t expected_flags = kFlagElfLibc6;
+    if (machine_type_ == EM_X86_64) {
+        expected_flags |= kFlagX8664Lib64;
+    } else if (machine_type_ == EM_AARCH64) {
+        expected_flags |= kFlagAArch64Lib64;
+    } else {
+        return;
+    }
+
+    // Skip the old format if it exists. The new format follows it aligned to 8.
+    size_t new_head = 0;
+    if (buf.size() >= kOldCacheHeaderSize && buf.compare(0, strlen(kOldCacheMagic), kOldCacheMagic) == 0) {
+        uint32_t nlibs = ReadAt<uint32_t>(buf, strlen(kOldCacheMagic) + 1);
+        new_head = AlignNext(kOldCacheHeaderSize + nlibs * kOldCacheEntrySize, 7);
+    }
+
+    if (buf.size() < new_head + kNewCacheHeaderSize || buf.compare(new_head, strlen(kNewCacheMagic), kNewCacheMagic) != 0 ||
+        buf.compare(new_head + strlen(kNewCacheMagic), strlen(kNewCacheVersion), kNewCacheVersion) != 0) {
+        LOG(WARNING) << filename << " is not in a supported format";
+        return;
+    }
+
+    const uint32_t nlibs = ReadAt<uint32_t>(buf, new_head + strlen(kNewCacheMagic) + strlen(kNewCacheVersion));
+    if (buf.size() < new_head + kNewCacheHeaderSize + nlibs * kNewCacheEntrySize) {
+        LOG(WARNING) << filename << " is truncated";
+        return;
+    }
+
+    // Strings are NUL-terminated and their offsets are relative to the head of
+    // the new format.
+    auto str_at = [&buf, new_head](uint32_t off) -> const char* {
+        if (new_head + off >= buf.size() || !memchr(buf.data() + new_head + off, '\0', buf.size() - new_head - off)) return nullptr;
+        return buf.data() + new_head + off;
+    };
+
+    for (uint32_t i = 0; i < nlibs; i++) {
+        const NewCacheEntry e = ReadAt<NewCacheEntry>(buf, new_head + kNewCacheHeaderSize + i * kNewCacheEntrySize);
+        // Entries for glibc-hwcaps subdirectories have non-zero hwcap. We
+        // leave them to the directory search.
+        if (e.flags != expected_flags || e.hwcap != 0) continue;
+        const char* key = str_at(e.key);
+        const char* value = str_at(e.value);
+        if (!key || !value) continue;
+        // The first entry is the preferred one as ld.so does.
+        ldsocache_.emplace(key, value);
+    }
+    LOG(INFO) << "Loaded " << ldsocache_.size() << " entries from " << filename;
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "utils.h"
+
+// LibraryResolver finds shared objects on the filesystem in the same way as
+// ld.so does. Results are memoized so that the BFS in
+// Sold::ResolveLibraryPaths touches the filesystem at most once for each
+// directory and each existing candidate file. A resolver lives as long as its
+// LibraryPool, i.e., across all links of --batch and --server, so a missing
+// file is not memoized and is checked again by each lookup.
+class LibraryResolver {
+public:
+    // `ldsocache_filename` is replaced only in tests.
+    explicit LibraryResolver(Elf_Half machine_type, const std::string& ldsocache_filename = "/etc/ld.so.cache");
+
+    // FindCandidates returns existing files named `needed` in the search
+    // order. `search_paths` come first. When `search_system_paths` is true,
+    // /etc/ld.so.cache, the directories in /etc/ld.so.conf and the default
+    // directories follow them.
+    std::vector<std::string> FindCandidates(const std::string& needed, const std::vector<std::string>& search_paths,
+                                            bool search_system_paths);
+
+    bool IsRegularFile(const std::string& filename);
+
+    // Directories listed in /etc/ld.so.conf followed by the default ones.
+    const std::vector<std::string>& system_paths();
+
+    // WatchedPaths returns the directories and files read so far. The
+    // memoized results are stale once one of them is modified.
+    std::vector<std::string> WatchedPaths() const;
+
+private:
+    bool ExistsIn(const std::string& dir, const std::string& name);
+    const std::unordered_set<std::string>& ListDirectory(const std::string& dir);
+    void LoadLdSoCache(const std::string& filename);
+
+    const Elf_Half machine_type_;
+    const std::string ldsocache_filename_;
+
+    bool system_paths_loaded_{false};
+    std::vector<std::string> system_paths_;
+    bool ldsocache_loaded_{false};
+    // map from soname to the path recorded in ldsocache_filename_
+    std::unordered_map<std::string, std::string> ldsocache_;
+    // map from a directory to its entries. A missing directory is an empty set.
+    std::unordered_map<std::string, std::unique_ptr<std::unordered_set<std::string>>> dirs_;
+    // Paths known to be regular files. There is no negative cache because a
+    // library can appear after a lookup, e.g., a stale /etc/ld.so.cache entry
+    // which is installed later, whose directory is not watched by --server.
+    std::unordered_set<std::string> regular_files_;
+};
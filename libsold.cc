@@ -0,0 +1,143 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "libsold.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "sold.h"
+
+namespace {
+
+std::unique_ptr<ELFBinary> ReadInput(const SoldInput& input) {
+    if (input.data) return ReadELFFromMemory(input.name, static_cast<const char*>(input.data), input.size);
+    // ELFBinary takes the fd.
+    int fd = dup(input.fd);
+    CHECK(fd >= 0) << input.name << ": " << strerror(errno);
+    return ReadELFFromFd(input.name, fd);
+}
+
+void LinkInProcess(const SoldInput& input, const SoldOptions& options, FILE* fp) {
+    Sold::Resolver resolver;
+    if (options.resolver) {
+        resolver = [&options](const std::string& needed) -> std::unique_ptr<ELFBinary> {
+            SoldInput library;
+            if (!options.resolver(needed, &library)) return nullptr;
+            return ReadInput(library);
+        };
+    }
+    Sold sold(ReadInput(input), options.exclude_sos, options.exclude_finis, options.custom_library_paths, options.ld_library_paths, resolver,
+              options.emit_section_header);
+    sold.SetStableLayout(options.stable_layout);
+    sold.SetMemoryBudget(options.memory_budget);
+    sold.Link(fp);
+}
+
+bool ReadMemfd(int fd, std::vector<char>* out) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    out->resize(st.st_size);
+    for (size_t done = 0; done < out->size();) {
+        const ssize_t n = pread(fd, out->data() + done, out->size() - done, done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+// LinkInChild runs the link in a child process, which is killed instead of
+// the caller by LOG(FATAL), CHECK or err in sold. The output and stderr of
+// the child are passed back in memfds, which never block the child as
+// pipes would.
+SoldStatus LinkInChild(const SoldInput& input, const SoldOptions& options, std::vector<char>* output) {
+    const int out_fd = memfd_create("sold-output", MFD_CLOEXEC);
+    const int err_fd = memfd_create("sold-stderr", MFD_CLOEXEC);
+    if (out_fd < 0 || err_fd < 0) {
+        const SoldStatus status{false, std::string("memfd_create: ") + strerror(errno)};
+        if (out_fd >= 0) close(out_fd);
+        if (err_fd >= 0) close(err_fd);
+        return status;
+    }
+
+    // Buffers of the caller must not be flushed by the child again.
+    fflush(nullptr);
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(err_fd, STDERR_FILENO);
+        FILE* fp = fdopen(out_fd, "w");
+        CHECK(fp) << strerror(errno);
+        LinkInProcess(input, options, fp);
+        _exit(fclose(fp) == 0 ? 0 : 1);
+    }
+
+    SoldStatus status;
+    int wstatus = 0;
+    if (pid < 0) {
+        status = SoldStatus{false, std::string("fork: ") + strerror(errno)};
+    } else {
+        while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {
+        }
+        std::vector<char> messages;
+        if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+            status.ok = false;
+            if (ReadMemfd(err_fd, &messages)) status.error.assign(messages.begin(), messages.end());
+            if (status.error.empty()) {
+                status.error = WIFSIGNALED(wstatus) ? "sold was killed by signal " + std::to_string(WTERMSIG(wstatus))
+                                                    : "sold exited with status " + std::to_string(WEXITSTATUS(wstatus));
+            }
+        } else if (!ReadMemfd(out_fd, output)) {
+            status = SoldStatus{false, std::string("Cannot read the output: ") + strerror(errno)};
+        }
+    }
+    close(out_fd);
+    close(err_fd);
+    return status;
+}
+
+}  // namespace
+
+SoldStatus SoldLink(const SoldInput& input, const SoldOptions& options, std::vector<char>* output) {
+    if (!options.in_process) return LinkInChild(input, options, output);
+
+    char* buf = nullptr;
+    size_t size = 0;
+    FILE* fp = open_memstream(&buf, &size);
+    CHECK(fp) << strerror(errno);
+    LinkInProcess(input, options, fp);
+    CHECK(fclose(fp) == 0);
+    output->assign(buf, buf + size);
+    free(buf);
+    return SoldStatus();
+}
+
+SoldStatus SoldLink(const SoldInput& input, const SoldOptions& options, int fd) {
+    // Sold seeks the output, so it is built in memory first.
+    std::vector<char> output;
+    SoldStatus status = SoldLink(input, options, &output);
+    for (size_t done = 0; status.ok && done < output.size();) {
+        const ssize_t n = write(fd, output.data() + done, output.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return SoldStatus{false, std::string("Cannot write the output: ") + strerror(errno)};
+        done += n;
+    }
+    return status;
+}
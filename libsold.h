@@ -0,0 +1,82 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// libsold is the API to use sold as a library. Inputs can be memory buffers
+// or file descriptors and the output is stored in memory or written to a
+// file descriptor, so that no temporary files are needed. Errors in inputs
+// are fatal in sold, so each link runs in a child process by default and
+// its errors are returned as SoldStatus.
+
+// SoldInput is an ELF binary given to SoldLink.
+struct SoldInput {
+    // The name of the binary, e.g., "libfoo.so". This is used in logs and
+    // for $ORIGIN in DT_RUNPATH and DT_RPATH.
+    std::string name;
+    // The contents are `size` bytes at `data` when `data` is not null, and
+    // are read from `fd` otherwise. `data` must be aligned to 8 bytes and
+    // valid until SoldLink returns. SoldLink does not close `fd`.
+    const void* data{nullptr};
+    size_t size{0};
+    int fd{-1};
+};
+
+// SoldResolver fills `input` with the library for DT_NEEDED `needed` and
+// returns true. When it returns false, the library is searched in the
+// directories in SoldOptions in the same way as the sold command. Unless
+// SoldOptions::in_process is set, the resolver runs in the forked child, so
+// what it writes to the memory of the caller, e.g., a count of calls, is
+// lost when SoldLink returns.
+using SoldResolver = std::function<bool(const std::string& needed, SoldInput* input)>;
+
+struct SoldOptions {
+    // The same as --exclude-so, --exclude-from-fini and
+    // --custom-library-path of the sold command.
+    std::vector<std::string> exclude_sos;
+    std::vector<std::string> exclude_finis;
+    std::vector<std::string> custom_library_paths;
+    // Used instead of LD_LIBRARY_PATH, which is not read by SoldLink.
+    std::vector<std::string> ld_library_paths;
+    SoldResolver resolver;
+    bool emit_section_header{false};
+    // See --stable-layout and --memory-budget of the sold command.
+    bool stable_layout{false};
+    uint64_t memory_budget{0};
+    // Link in the calling process instead of a forked one. Errors in inputs
+    // then abort the caller as they do the sold command.
+    bool in_process{false};
+};
+
+// SoldStatus is the result of SoldLink. `error` has the messages which
+// sold printed to stderr when the link failed.
+struct SoldStatus {
+    bool ok{true};
+    std::string error;
+};
+
+// SoldLink links `input` and the libraries it depends on, and stores the
+// output in `output`. The child process which runs the link is forked from
+// the calling thread, so other threads must not hold locks which the link
+// needs, e.g., of glog.
+[[nodiscard]] SoldStatus SoldLink(const SoldInput& input, const SoldOptions& options, std::vector<char>* output);
+
+// SoldLink writes the output to `fd`, which can be a pipe or a socket.
+[[nodiscard]] SoldStatus SoldLink(const SoldInput& input, const SoldOptions& options, int fd);
@@ -0,0 +1,348 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "link_server.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+
+namespace {
+
+// The client sends its stdout and stderr with SCM_RIGHTS, followed by
+// NUL-terminated strings: the working directory, LD_LIBRARY_PATH and the
+// arguments. The server replies the exit code.
+constexpr int kNumClientFds = 2;
+
+bool WriteAll(int fd, const char* buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool ReadAll(int fd, std::string* out) {
+    char buf[4096];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) return true;
+        out->append(buf, n);
+    }
+}
+
+bool MakeAddress(const std::string& socket_path, sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr->sun_path)) return false;
+    strcpy(addr->sun_path, socket_path.c_str());
+    return true;
+}
+
+// BindPrivate binds `fd` to `socket_path` with mode 0600. The socket is
+// created in a private directory and renamed into place so that other users
+// never see it with a wider mode.
+bool BindPrivate(int fd, const std::string& socket_path) {
+    std::string dir = socket_path + ".XXXXXX";
+    if (!mkdtemp(&dir[0])) return false;
+    const std::string tmp_path = dir + "/socket";
+    sockaddr_un addr;
+    bool ok = MakeAddress(tmp_path, &addr);
+    if (!ok) errno = ENAMETOOLONG;
+    ok = ok && bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && chmod(tmp_path.c_str(), 0600) == 0 &&
+         rename(tmp_path.c_str(), socket_path.c_str()) == 0;
+    const int saved_errno = errno;
+    unlink(tmp_path.c_str());
+    rmdir(dir.c_str());
+    errno = saved_errno;
+    return ok;
+}
+
+// FromSameUser returns whether the peer of `conn` runs as the user of the
+// server. Requests run with the privileges of the server.
+bool FromSameUser(int conn) {
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid();
+}
+
+// Watcher drops libraries and memoized search results in a LibraryPool when
+// the files or directories they come from are modified.
+class Watcher {
+public:
+    Watcher() : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) { CHECK(fd_ >= 0) << "inotify_init1: " << strerror(errno); }
+    ~Watcher() { close(fd_); }
+
+    int fd() const { return fd_; }
+
+    // Watch starts watching paths which are newly read by `pool`.
+    void Watch(LibraryPool* pool) {
+        std::vector<std::string> libraries, search_paths;
+        pool->GetWatchedPaths(&libraries, &search_paths);
+        for (const std::string& path : libraries) {
+            Add(path, IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF, /*is_library=*/true);
+        }
+        for (const std::string& path : search_paths) {
+            Add(path, IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF,
+                /*is_library=*/false);
+        }
+    }
+
+    // Handle reads pending events and invalidates `pool`. A watch is removed
+    // once an event happens and added again by the next Watch.
+    void Handle(LibraryPool* pool) {
+        alignas(inotify_event) char buf[sizeof(inotify_event) + NAME_MAX + 1];
+        ssize_t n;
+        while ((n = read(fd_, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + n;) {
+                const inotify_event* ev = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                auto found = watches_.find(ev->wd);
+                if (found == watches_.end()) continue;
+                for (const auto& w : found->second) {
+                    LOG(INFO) << "Changed: " << w.first << (ev->len ? std::string("/") + ev->name : "");
+                    if (w.second) {
+                        pool->Invalidate(w.first);
+                    } else {
+                        pool->InvalidateSearch();
+                        if (ev->len) pool->Invalidate(w.first + "/" + ev->name);
+                    }
+                    watched_.erase(w.first);
+                }
+                watches_.erase(found);
+                inotify_rm_watch(fd_, ev->wd);
+            }
+        }
+    }
+
+private:
+    void Add(const std::string& path, uint32_t mask, bool is_library) {
+        if (!watched_.insert(path).second) return;
+        int wd = inotify_add_watch(fd_, path.c_str(), mask);
+        if (wd < 0) {
+            // Missing directories in search paths are common.
+            LOG(INFO) << "Cannot watch " << path << ": " << strerror(errno);
+            return;
+        }
+        // Hard links and symlinks share a watch.
+        watches_[wd].emplace_back(path, is_library);
+    }
+
+    const int fd_;
+    // map from a watch descriptor to (path, is_library)
+    std::map<int, std::vector<std::pair<std::string, bool>>> watches_;
+    std::set<std::string> watched_;
+};
+
+// HandleRequest runs a request on `conn` with the stdout and stderr of the
+// client.
+void HandleRequest(int conn, const LinkRequestHandler& handler) {
+    char first;
+    char control[CMSG_SPACE(sizeof(int) * kNumClientFds)];
+    iovec iov = {&first, 1};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(conn, &msg, MSG_CMSG_CLOEXEC) != 1) {
+        LOG(WARNING) << "Cannot receive a request: " << strerror(errno);
+        return;
+    }
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * kNumClientFds)) {
+        LOG(WARNING) << "A request without stdout and stderr";
+        return;
+    }
+    int client_fds[kNumClientFds];
+    memcpy(client_fds, CMSG_DATA(cmsg), sizeof(client_fds));
+
+    std::string payload(1, first);
+    std::vector<std::string> strs;
+    if (ReadAll(conn, &payload)) strs = SplitString(payload, std::string(1, '\0'));
+    // Relative paths in the next requests must not depend on this one.
+    const int saved_cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    // The payload ends with NUL.
+    if (strs.size() < 4 || !strs.back().empty()) {
+        LOG(WARNING) << "A broken request";
+    } else if (saved_cwd < 0 || chdir(strs[0].c_str()) != 0) {
+        LOG(WARNING) << "Cannot chdir to " << strs[0] << ": " << strerror(errno);
+    } else {
+        std::vector<std::string> ld_library_paths;
+        if (!strs[1].empty()) ld_library_paths = SplitString(strs[1], ":");
+        const std::vector<std::string> args(strs.begin() + 2, strs.end() - 1);
+        LOG(INFO) << "Request from " << strs[0] << ": " << args.size() << " arguments";
+
+        std::cout.flush();
+        fflush(stdout);
+        fflush(stderr);
+        const int saved_stdout = dup(STDOUT_FILENO);
+        const int saved_stderr = dup(STDERR_FILENO);
+        dup2(client_fds[0], STDOUT_FILENO);
+        dup2(client_fds[1], STDERR_FILENO);
+        const int32_t code = handler(args, ld_library_paths);
+        std::cout.flush();
+        fflush(stdout);
+        fflush(stderr);
+        dup2(saved_stdout, STDOUT_FILENO);
+        dup2(saved_stderr, STDERR_FILENO);
+        close(saved_stdout);
+        close(saved_stderr);
+
+        if (!WriteAll(conn, reinterpret_cast<const char*>(&code), sizeof(code))) {
+            LOG(WARNING) << "Cannot reply: " << strerror(errno);
+        }
+    }
+    if (saved_cwd >= 0) {
+        CHECK(fchdir(saved_cwd) == 0) << "fchdir: " << strerror(errno);
+        close(saved_cwd);
+    }
+    for (int fd : client_fds) close(fd);
+}
+
+// Serve handles requests until the process dies.
+void Serve(int listen_fd, LibraryPool* pool, const LinkRequestHandler& handler) {
+    Watcher watcher;
+    for (;;) {
+        pollfd fds[2] = {{listen_fd, POLLIN, 0}, {watcher.fd(), POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            CHECK_EQ(errno, EINTR) << "poll: " << strerror(errno);
+            continue;
+        }
+        // Handle changes first so that a request never sees stale libraries.
+        watcher.Handle(pool);
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0) continue;
+        if (!FromSameUser(conn)) {
+            // The client links locally.
+            LOG(WARNING) << "Rejected a request from another user";
+            close(conn);
+            continue;
+        }
+        HandleRequest(conn, handler);
+        close(conn);
+        watcher.Watch(pool);
+    }
+}
+
+}  // namespace
+
+int RunServer(const std::string& socket_path, LibraryPool* pool, const LinkRequestHandler& handler) {
+    sockaddr_un addr;
+    if (!MakeAddress(socket_path, &addr)) {
+        std::cerr << "Too long socket path: " << socket_path << std::endl;
+        return 1;
+    }
+    // A socket left by a previous server is replaced, but other files are not.
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st) == 0 && !S_ISSOCK(st.st_mode)) {
+        std::cerr << "Not a socket: " << socket_path << std::endl;
+        return 1;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || !BindPrivate(listen_fd, socket_path) || listen(listen_fd, SOMAXCONN) != 0) {
+        std::cerr << "Cannot listen on " << socket_path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    // Clients may go away during requests.
+    signal(SIGPIPE, SIG_IGN);
+    LOG(INFO) << "Listening on " << socket_path;
+
+    // Errors in inputs are fatal in sold, so requests are served by a worker
+    // process, which is restarted with an empty pool when it dies. The
+    // client of the failed request links locally and shows the error.
+    for (;;) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "fork: " << strerror(errno) << std::endl;
+            return 1;
+        }
+        if (pid == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            Serve(listen_fd, pool, handler);
+            _exit(1);
+        }
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        LOG(WARNING) << "The server worker exited with status " << status << ", restarting";
+    }
+}
+
+bool RunClient(const std::string& socket_path, const std::vector<std::string>& args, int* code) {
+    sockaddr_un addr;
+    if (!MakeAddress(socket_path, &addr)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+
+    char cwd[PATH_MAX];
+    CHECK(getcwd(cwd, sizeof(cwd))) << strerror(errno);
+    const char* ld_library_path = getenv("LD_LIBRARY_PATH");
+    std::string payload;
+    for (const std::string& s : {std::string(cwd), std::string(ld_library_path ? ld_library_path : "")}) payload += s + '\0';
+    for (const std::string& s : args) payload += s + '\0';
+
+    // Send stdout and stderr with the first byte.
+    const int client_fds[kNumClientFds] = {STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(client_fds))] = {};
+    iovec iov = {&payload[0], 1};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(client_fds));
+    memcpy(CMSG_DATA(cmsg), client_fds, sizeof(client_fds));
+
+    bool ok = sendmsg(fd, &msg, MSG_NOSIGNAL) == 1 && WriteAll(fd, payload.data() + 1, payload.size() - 1) && shutdown(fd, SHUT_WR) == 0;
+    // The server replies nothing when it dies during the request.
+    int32_t reply;
+    std::string buf;
+    ok = ok && ReadAll(fd, &buf) && buf.size() == sizeof(reply);
+    close(fd);
+    if (!ok) return false;
+    memcpy(&reply, buf.data(), sizeof(reply));
+    *code = reply;
+    return true;
+}
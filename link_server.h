@@ -0,0 +1,42 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "library_pool.h"
+
+// LinkRequestHandler runs a request with the command line arguments
+// (including argv[0]) and LD_LIBRARY_PATH of the client, and returns the
+// exit code.
+using LinkRequestHandler = std::function<int(const std::vector<std::string>& args, const std::vector<std::string>& ld_library_paths)>;
+
+// RunServer serves requests sent by RunClient to the Unix socket at
+// `socket_path` one by one. During a request, the working directory,
+// stdout and stderr of the client are used. Libraries in `pool` stay
+// resident across requests and are dropped by inotify when their files
+// or the searched directories change. Requests are served in a worker
+// process, which is restarted when a request kills it, e.g., by a CHECK
+// failure. The socket has mode 0600 and connections from other users are
+// closed without a reply. This returns only on errors.
+int RunServer(const std::string& socket_path, LibraryPool* pool, const LinkRequestHandler& handler);
+
+// RunClient sends `args` to the server at `socket_path` and stores the exit
+// code of the request in `code`. Returns false when no server answered.
+bool RunClient(const std::string& socket_path, const std::vector<std::string>& args, int* code);
@@ -0,0 +1,349 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "metadata_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+#include "hash.h"
+
+namespace {
+
+constexpr char kMagic[8] = "SOLDMDC";
+constexpr char kEntrySuffix[] = ".meta";
+// Bump this when the layout of the summary changes.
+constexpr uint32_t kFormatVersion = 4;
+
+constexpr uint32_t kHasEHFrameHeader = 1;
+constexpr uint32_t kHasSymbols = 2;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t flags;
+    uint64_t size;
+    uint64_t mtime_ns;
+    uint64_t ino;
+    uint64_t content_hash;
+    uint32_t path;
+    uint32_t num_fdes;
+    uint32_t num_cies;
+    uint32_t num_symbols;
+    uint32_t strs_size;
+    uint8_t efh_version;
+    uint8_t efh_eh_frame_ptr_enc;
+    uint8_t efh_fde_count_enc;
+    uint8_t efh_table_enc;
+    int32_t efh_eh_frame_ptr;
+    uint64_t efh_table_base;
+    uint64_t fdes_offset;
+    uint64_t cies_offset;
+    uint64_t symbols_offset;
+    uint64_t strs_offset;
+};
+
+const FileHeader* GetFileHeader(const char* head) {
+    return reinterpret_cast<const FileHeader*>(head);
+}
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+MetadataCache::Entry::Entry(char* head, size_t size) : head_(head), size_(size) {}
+
+MetadataCache::Entry::~Entry() {
+    munmap(head_, size_);
+}
+
+bool MetadataCache::Entry::has_eh_frame_header() const {
+    return GetFileHeader(head_)->flags & kHasEHFrameHeader;
+}
+
+void MetadataCache::Entry::GetEHFrameHeader(const char* elf_head, EHFrameHeader* efh) const {
+    const FileHeader* h = GetFileHeader(head_);
+    CHECK(h->flags & kHasEHFrameHeader);
+    efh->version = h->efh_version;
+    efh->eh_frame_ptr_enc = h->efh_eh_frame_ptr_enc;
+    efh->fde_count_enc = h->efh_fde_count_enc;
+    efh->table_enc = h->efh_table_enc;
+    efh->eh_frame_ptr = h->efh_eh_frame_ptr;
+    efh->table_base = h->efh_table_base;
+    efh->fde_count = h->num_fdes;
+
+    const FDE* fdes = reinterpret_cast<const FDE*>(head_ + h->fdes_offset);
+    efh->table.resize(h->num_fdes);
+    efh->fdes.resize(h->num_fdes);
+    for (uint32_t i = 0; i < h->num_fdes; i++) {
+        const FDE& f = fdes[i];
+        CHECK_LT(f.cie_index, h->num_cies);
+        efh->table[i] = f.entry;
+        efh->fdes[i] =
+            EHFrameHeader::FDE{f.fde_length, f.fde_extended_length, f.fde_CIE_delta, f.fde_initial_loc, f.fde_pc_range, f.cie_index};
+    }
+
+    const CIE* cies = reinterpret_cast<const CIE*>(head_ + h->cies_offset);
+    efh->cies.resize(h->num_cies);
+    for (uint32_t i = 0; i < h->num_cies; i++) {
+        const CIE& c = cies[i];
+        efh->cies[i] = EHFrameHeader::CIE{c.length, c.CIE_id, c.version, elf_head + c.aug_str, c.FDE_encoding, c.LSDA_encoding};
+    }
+}
+
+bool MetadataCache::Entry::has_symbols() const {
+    return GetFileHeader(head_)->flags & kHasSymbols;
+}
+
+const MetadataCache::Symbol* MetadataCache::Entry::symbols() const {
+    return reinterpret_cast<const Symbol*>(head_ + GetFileHeader(head_)->symbols_offset);
+}
+
+size_t MetadataCache::Entry::num_symbols() const {
+    return GetFileHeader(head_)->num_symbols;
+}
+
+const char* MetadataCache::Entry::Str(uint32_t off) const {
+    const FileHeader* h = GetFileHeader(head_);
+    CHECK_LT(off, h->strs_size);
+    return head_ + h->strs_offset + off;
+}
+
+MetadataCache::MetadataCache(const std::string& dir, uint64_t max_size) : dir_(dir), max_size_(max_size) {
+    if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        LOG(WARNING) << "Cannot create " << dir_ << ": " << strerror(errno);
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    Evict();
+}
+
+std::string MetadataCache::CacheFilename(const std::string& path) const {
+    return dir_ + "/" + HexString(HashBytes(path.data(), path.size())).substr(2) + kEntrySuffix;
+}
+
+bool MetadataCache::GetKey(const std::string& filename, int fd, uint64_t content_hash, Key* key) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+
+    char buf[PATH_MAX];
+    key->path = realpath(filename.c_str(), buf) ? buf : filename;
+    key->size = st.st_size;
+    key->mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+    key->ino = st.st_ino;
+    key->content_hash = content_hash;
+    return true;
+}
+
+std::unique_ptr<MetadataCache::Entry> MetadataCache::Lookup(const std::string& filename, int fd, uint64_t content_hash) {
+    Key key;
+    if (!GetKey(filename, fd, content_hash, &key)) return nullptr;
+
+    const std::string cache_filename = CacheFilename(key.path);
+    int cfd = open(cache_filename.c_str(), O_RDONLY);
+    if (cfd < 0) {
+        LOG(INFO) << "MetadataCache miss: " << key.path;
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(cfd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+        close(cfd);
+        return nullptr;
+    }
+    const size_t size = st.st_size;
+    char* p = static_cast<char*>(mmap(NULL, size, PROT_READ, MAP_PRIVATE, cfd, 0));
+    close(cfd);
+    if (p == MAP_FAILED) return nullptr;
+    std::unique_ptr<Entry> entry(new Entry(p, size));
+
+    const FileHeader* h = GetFileHeader(p);
+    if (memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->format_version != kFormatVersion ||
+        h->fdes_offset + h->num_fdes * sizeof(FDE) > size || h->cies_offset + h->num_cies * sizeof(CIE) > size ||
+        h->symbols_offset + h->num_symbols * sizeof(Symbol) > size ||
+        h->strs_offset + h->strs_size > size || h->strs_size == 0 || p[h->strs_offset + h->strs_size - 1] != '\0' ||
+        h->path >= h->strs_size) {
+        LOG(WARNING) << "Broken metadata cache: " << cache_filename;
+        return nullptr;
+    }
+    if (h->size != key.size || h->mtime_ns != key.mtime_ns || h->ino != key.ino || h->content_hash != key.content_hash ||
+        key.path != entry->Str(h->path)) {
+        LOG(INFO) << "MetadataCache stale: " << key.path;
+        return nullptr;
+    }
+
+    // Mark the summary as recently used.
+    utimensat(AT_FDCWD, cache_filename.c_str(), nullptr, 0);
+    LOG(INFO) << "MetadataCache hit: " << key.path;
+    return entry;
+}
+
+void MetadataCache::Store(const std::string& filename, int fd, uint64_t content_hash, const char* head, const EHFrameHeader* efh,
+                          const std::vector<SymbolSource>* syms) {
+    Key key;
+    if (!GetKey(filename, fd, content_hash, &key)) return;
+
+    std::string strs(1, '\0');
+    std::map<std::string, uint32_t> str_pos;
+    auto add_str = [&strs, &str_pos](const std::string& s) -> uint32_t {
+        if (s.empty()) return 0;
+        auto found = str_pos.find(s);
+        if (found != str_pos.end()) return found->second;
+        uint32_t pos = strs.size();
+        strs += s;
+        strs += '\0';
+        str_pos.emplace(s, pos);
+        return pos;
+    };
+
+    FileHeader h = {};
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.format_version = kFormatVersion;
+    h.size = key.size;
+    h.mtime_ns = key.mtime_ns;
+    h.ino = key.ino;
+    h.content_hash = key.content_hash;
+    h.path = add_str(key.path);
+
+    std::vector<FDE> fdes;
+    std::vector<CIE> cies;
+    if (efh) {
+        h.flags |= kHasEHFrameHeader;
+        h.efh_version = efh->version;
+        h.efh_eh_frame_ptr_enc = efh->eh_frame_ptr_enc;
+        h.efh_fde_count_enc = efh->fde_count_enc;
+        h.efh_table_enc = efh->table_enc;
+        h.efh_eh_frame_ptr = efh->eh_frame_ptr;
+        h.efh_table_base = efh->table_base;
+        for (size_t i = 0; i < efh->table.size(); i++) {
+            FDE f = {};
+            f.entry = efh->table[i];
+            f.fde_extended_length = efh->fdes[i].extended_length;
+            f.fde_length = efh->fdes[i].length;
+            f.fde_CIE_delta = efh->fdes[i].CIE_delta;
+            f.fde_initial_loc = efh->fdes[i].initial_loc;
+            f.fde_pc_range = efh->fdes[i].pc_range;
+            f.cie_index = efh->fdes[i].cie_index;
+            fdes.push_back(f);
+        }
+        for (const EHFrameHeader::CIE& cie : efh->cies) {
+            CIE c = {};
+            c.length = cie.length;
+            c.CIE_id = cie.CIE_id;
+            c.version = cie.version;
+            c.FDE_encoding = cie.FDE_encoding;
+            c.LSDA_encoding = cie.LSDA_encoding;
+            c.aug_str = cie.aug_str - head;
+            cies.push_back(c);
+        }
+    }
+    h.num_fdes = fdes.size();
+    h.num_cies = cies.size();
+
+    std::vector<Symbol> symbols;
+    if (syms) {
+        h.flags |= kHasSymbols;
+        for (const SymbolSource& s : *syms) {
+            Symbol sym = {};
+            sym.index = s.index;
+            sym.version_kind = s.version_kind;
+            sym.file = add_str(s.file);
+            sym.version = add_str(s.version);
+            sym.versym = s.versym;
+            symbols.push_back(sym);
+        }
+    }
+    h.num_symbols = symbols.size();
+    h.strs_size = strs.size();
+
+    h.fdes_offset = AlignNext(sizeof(FileHeader), 7);
+    h.cies_offset = AlignNext(h.fdes_offset + fdes.size() * sizeof(FDE), 7);
+    h.symbols_offset = AlignNext(h.cies_offset + cies.size() * sizeof(CIE), 7);
+    h.strs_offset = h.symbols_offset + symbols.size() * sizeof(Symbol);
+
+    // Write to a temporary file and rename it so that concurrent sold
+    // processes never see a partial summary.
+    const std::string cache_filename = CacheFilename(key.path);
+    const std::string tmp_filename = cache_filename + TempSuffix();
+    FILE* fp = fopen(tmp_filename.c_str(), "wb");
+    if (!fp) {
+        LOG(WARNING) << "Cannot write " << tmp_filename << ": " << strerror(errno);
+        return;
+    }
+    Write(fp, h);
+    EmitPad(fp, h.fdes_offset);
+    if (!fdes.empty()) WriteBuf(fp, fdes.data(), fdes.size() * sizeof(FDE));
+    EmitPad(fp, h.cies_offset);
+    if (!cies.empty()) WriteBuf(fp, cies.data(), cies.size() * sizeof(CIE));
+    EmitPad(fp, h.symbols_offset);
+    if (!symbols.empty()) WriteBuf(fp, symbols.data(), symbols.size() * sizeof(Symbol));
+    WriteBuf(fp, strs.data(), strs.size());
+    fclose(fp);
+
+    if (rename(tmp_filename.c_str(), cache_filename.c_str()) != 0) {
+        LOG(WARNING) << "Cannot rename " << tmp_filename << ": " << strerror(errno);
+        unlink(tmp_filename.c_str());
+        return;
+    }
+    LOG(INFO) << "MetadataCache stored: " << key.path << " => " << cache_filename;
+
+    // Scanning the directory for each summary would be slow for a cold
+    // cache, so evict only after a fraction of the limit is written.
+    std::lock_guard<std::mutex> lock(mu_);
+    stored_size_ += h.strs_offset + h.strs_size;
+    if (stored_size_ > max_size_ / 16) Evict();
+}
+
+void MetadataCache::Evict() {
+    stored_size_ = 0;
+    // (mtime, size, filename)
+    std::vector<std::tuple<struct timespec, uint64_t, std::string>> entries;
+    uint64_t total = 0;
+    if (DIR* d = opendir(dir_.c_str())) {
+        while (struct dirent* ent = readdir(d)) {
+            const std::string name = ent->d_name;
+            if (!EndsWith(name, kEntrySuffix)) continue;
+            const std::string filename = dir_ + "/" + name;
+            struct stat st;
+            if (stat(filename.c_str(), &st) != 0) continue;
+            entries.emplace_back(st.st_mtim, st.st_size, filename);
+            total += st.st_size;
+        }
+        closedir(d);
+    }
+    if (total <= max_size_) return;
+
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        const struct timespec& ta = std::get<0>(a);
+        const struct timespec& tb = std::get<0>(b);
+        return std::tie(ta.tv_sec, ta.tv_nsec) < std::tie(tb.tv_sec, tb.tv_nsec);
+    });
+    for (size_t i = 0; i < entries.size() && total > max_size_; i++) {
+        const std::string& filename = std::get<2>(entries[i]);
+        if (unlink(filename.c_str()) != 0) continue;
+        LOG(INFO) << "MetadataCache evicted: " << filename;
+        total -= std::get<1>(entries[i]);
+    }
+}
@@ -0,0 +1,136 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+// MetadataCache keeps summaries of parsed input libraries in a directory so
+// that following sold runs do not parse the same libraries again. A summary
+// is a flat binary file which is mmapped as it is.
+//
+// A summary is keyed by the path, the size, the mtime and the inode of the
+// input and a content hash of the parts the summary depends on, which is
+// computed by ELFBinary.
+//
+// A summary holds
+// - the table in .eh_frame_hdr with the decoded FDEs and CIEs
+// - the symbols in .dynsym with their version references
+//
+// Program headers and dynamic entries are not copied because ELFBinary
+// reads them from the mapped input directly without any decoding.
+//
+// The least recently used summaries are evicted when the total size of
+// summaries exceeds max_size. The mtime of a summary is its last use.
+class MetadataCache {
+public:
+    struct Symbol {
+        uint32_t index;
+        uint32_t version_kind;
+        uint32_t file;
+        uint32_t version;
+        Elf_Versym versym;
+        uint8_t padding[6];
+    };
+
+    struct FDE {
+        EHFrameHeader::FDETableEntry entry;
+        uint64_t fde_extended_length;
+        uint64_t fde_pc_range;
+        uint32_t fde_length;
+        int32_t fde_CIE_delta;
+        int32_t fde_initial_loc;
+        uint32_t cie_index;
+    };
+
+    struct CIE {
+        uint32_t length;
+        int32_t CIE_id;
+        uint8_t version;
+        uint8_t FDE_encoding;
+        uint8_t LSDA_encoding;
+        uint8_t padding[5];
+        // Offset of the augmentation string from the head of the input.
+        uint64_t aug_str;
+    };
+
+    // Entry is a summary of an input mapped in memory.
+    class Entry {
+    public:
+        Entry(char* head, size_t size);
+        ~Entry();
+
+        bool has_eh_frame_header() const;
+        void GetEHFrameHeader(const char* elf_head, EHFrameHeader* efh) const;
+
+        bool has_symbols() const;
+        const Symbol* symbols() const;
+        size_t num_symbols() const;
+        const char* Str(uint32_t off) const;
+
+    private:
+        char* head_;
+        size_t size_;
+    };
+
+    // The raw data to be stored. They are taken from ELFBinary.
+    struct SymbolSource {
+        uint32_t index;
+        uint32_t version_kind;
+        std::string file;
+        std::string version;
+        Elf_Versym versym;
+    };
+
+    static constexpr uint64_t kDefaultMaxSize = 256ULL << 20;
+
+    explicit MetadataCache(const std::string& dir, uint64_t max_size = kDefaultMaxSize);
+
+    // Returns the summary of the input or nullptr when the cache does not
+    // have a valid one.
+    std::unique_ptr<Entry> Lookup(const std::string& filename, int fd, uint64_t content_hash);
+
+    // `head` is the mapped input. `efh` is nullptr when the input has no
+    // PT_GNU_EH_FRAME. `syms` is nullptr when .dynsym has not been read,
+    // e.g., for excluded libraries.
+    void Store(const std::string& filename, int fd, uint64_t content_hash, const char* head, const EHFrameHeader* efh,
+               const std::vector<SymbolSource>* syms);
+
+private:
+    struct Key {
+        std::string path;
+        uint64_t size;
+        uint64_t mtime_ns;
+        uint64_t ino;
+        uint64_t content_hash;
+    };
+
+    bool GetKey(const std::string& filename, int fd, uint64_t content_hash, Key* key);
+    std::string CacheFilename(const std::string& path) const;
+    // Evict removes the least recently used summaries. It must be called
+    // while mu_ is locked.
+    void Evict();
+
+    const std::string dir_;
+    const uint64_t max_size_;
+    std::mutex mu_;
+    // Bytes stored since the last Evict.
+    uint64_t stored_size_{0};
+};
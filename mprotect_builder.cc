@@ -17,7 +17,7 @@ void MprotectBuilder::EmitX86_64(FILE* fp, uintptr_t mprotect_code_offset) {
                            (static_cast<int64_t>(mprotect_code_offset) + static_cast<int64_t>(mprotect_code_head - mprotect_code) + 17);
         LOG(INFO) << "MprotectBuilder::Emit" << SOLD_LOG_BITS(offset_v) << SOLD_LOG_KEY(offset_v);
         *offset_p = offset_v;
-        uint32_t* size_p = (uint32_t*)(mprotect_code_head + memprotect_body_size_offset_x86_64);
+        uint64_t* size_p = (uint64_t*)(mprotect_code_head + memprotect_body_size_offset_x86_64);
         *size_p = ((offsets[i] + sizes[i]) & (~(0x1000 - 1))) - (offsets[i] & (~(0x1000 - 1)));
         mprotect_code_head += sizeof(memprotect_body_code_x86_64);
     }
@@ -22,33 +22,34 @@
 
 class MprotectBuilder {
 public:
+    // SetMachineType selects the code for `machine_type`. Size and Emit do
+    // not look at the machine type afterwards.
     void SetMachineType(const Elf64_Half machine_type) {
-        CHECK(machine_type == EM_X86_64 || machine_type == EM_AARCH64);
-        machine_type_ = machine_type;
+        if (machine_type == EM_X86_64) {
+            body_size_ = sizeof(memprotect_body_code_x86_64);
+            end_size_ = sizeof(memprotect_end_code_x86_64);
+            emit_ = &MprotectBuilder::EmitX86_64;
+        } else if (machine_type == EM_AARCH64) {
+            body_size_ = body_code_length_aarch64;
+            end_size_ = ret_code_length_aarch64;
+            emit_ = &MprotectBuilder::EmitAarch64;
+        } else {
+            CHECK(false) << SOLD_LOG_KEY(machine_type) << " is not supported.";
+        }
     }
     void Add(uintptr_t offset, uintptr_t size) {
         offsets.emplace_back(offset);
         sizes.emplace_back(size);
     }
+    // CodeSize is the size of the code for `num` ranges.
+    uintptr_t CodeSize(size_t num) const { return body_size_ * num + end_size_; }
     uintptr_t Size() const {
         CHECK(offsets.size() == sizes.size());
-        if (machine_type_ == EM_X86_64) {
-            return sizeof(memprotect_body_code_x86_64) * offsets.size() + sizeof(memprotect_end_code_x86_64);
-        } else if (machine_type_ == EM_AARCH64) {
-            return body_code_length_aarch64 * offsets.size() + ret_code_length_aarch64;
-        } else {
-            CHECK(false) << SOLD_LOG_KEY(machine_type_) << " is not supported.";
-        }
+        return CodeSize(offsets.size());
     }
     void Emit(FILE* fp, uintptr_t mprotect_code_offset) {
-        CHECK(machine_type_ == EM_X86_64 || machine_type_ == EM_AARCH64) << "SetMachineType before Emit";
-        if (machine_type_ == EM_X86_64) {
-            EmitX86_64(fp, mprotect_code_offset);
-        } else if (machine_type_ == EM_AARCH64) {
-            EmitAarch64(fp, mprotect_code_offset);
-        } else {
-            CHECK(false) << SOLD_LOG_KEY(machine_type_) << " is not supported.";
-        }
+        CHECK(emit_) << "SetMachineType before Emit";
+        (this->*emit_)(fp, mprotect_code_offset);
     }
 
     // call SYS_mprotect syscall
@@ -56,7 +57,7 @@ public:
     // mov $0xdeadbeefdeadbeef, %rdi
     // lea (%rip), %rsi
     // add %rsi, %rdi
-    // mov $0xaabbcc, %rsi (size)
+    // movabs $0xaabbccddaabbccdd, %rsi (size)
     // mov $0x1, %rdx (0x1 = PROT_READ)
     // mov $10, %eax (10 = SYS_mprotect)
     // syscall
@@ -64,14 +65,14 @@ public:
     // jz ok
     // ud2
     // ok:
-    static constexpr uint8_t memprotect_body_code_x86_64[] = {0x48, 0xbf, 0xef, 0xbe, 0xad, 0xde, 0xef, 0xbe, 0xad, 0xde, 0x48, 0x8d,
-                                                              0x35, 0x00, 0x00, 0x00, 0x00, 0x48, 0x01, 0xf7, 0x48, 0xc7, 0xc6, 0xcc,
-                                                              0xbb, 0xaa, 0x00, 0x48, 0xc7, 0xc2, 0x01, 0x00, 0x00, 0x00, 0xb8, 0x0a,
+    static constexpr uint8_t memprotect_body_code_x86_64[] = {0x48, 0xbf, 0xef, 0xbe, 0xad, 0xde, 0xef, 0xbe, 0xad, 0xde, 0x48, 0x8d, 0x35,
+                                                              0x00, 0x00, 0x00, 0x00, 0x48, 0x01, 0xf7, 0x48, 0xbe, 0xdd, 0xcc, 0xbb, 0xaa,
+                                                              0xdd, 0xcc, 0xbb, 0xaa, 0x48, 0xc7, 0xc2, 0x01, 0x00, 0x00, 0x00, 0xb8, 0x0a,
                                                               0x00, 0x00, 0x00, 0x0f, 0x05, 0x85, 0xc0, 0x74, 0x02, 0x0f, 0x0b};
     // offset to 0xabbccdd
     static constexpr int memprotect_body_addr_offset_x86_64 = 2;
-    // offset to 0xaabbcc
-    static constexpr int memprotect_body_size_offset_x86_64 = 23;
+    // offset to 0xaabbccddaabbccdd
+    static constexpr int memprotect_body_size_offset_x86_64 = 22;
 
     // ret
     static constexpr uint8_t memprotect_end_code_x86_64[] = {0xc3};
@@ -85,7 +86,9 @@ public:
 private:
     void EmitX86_64(FILE* fp, uintptr_t mprotect_code_offset);
     void EmitAarch64(FILE* fp, uintptr_t mprotect_code_offset);
-    Elf64_Half machine_type_;
+    uintptr_t body_size_{0};
+    uintptr_t end_size_{0};
+    void (MprotectBuilder::*emit_)(FILE* fp, uintptr_t mprotect_code_offset){nullptr};
     std::vector<int64_t> offsets;
-    std::vector<uint32_t> sizes;
+    std::vector<uint64_t> sizes;
 };
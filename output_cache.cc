@@ -0,0 +1,257 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "output_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#include "hash.h"
+
+namespace {
+
+constexpr char kEntrySuffix[] = ".out";
+
+// CopyFile clones `src` to `dst` when the filesystem supports reflinks and
+// copies it otherwise.
+bool CopyFile(const std::string& src, const std::string& dst) {
+    int in = open(src.c_str(), O_RDONLY);
+    if (in < 0) return false;
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    bool ok = ioctl(out, FICLONE, in) == 0;
+    if (!ok) {
+        ok = true;
+        std::vector<char> buf(1 << 20);
+        ssize_t n;
+        while ((n = read(in, buf.data(), buf.size())) > 0) {
+            if (write(out, buf.data(), n) != n) {
+                ok = false;
+                break;
+            }
+        }
+        if (n < 0) ok = false;
+    }
+    close(in);
+    if (close(out) != 0) ok = false;
+    return ok;
+}
+
+// The digest of the running sold. Outputs of other versions of sold must
+// not be used.
+std::string GetLinkerDigest() {
+    int fd = open("/proc/self/exe", O_RDONLY);
+    if (fd < 0) return "";
+    struct stat st;
+    uint64_t h = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            h = HashBytes(p, st.st_size);
+            munmap(p, st.st_size);
+        }
+    }
+    close(fd);
+    return HexString(h).substr(2);
+}
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+OutputCache::OutputCache(const std::string& dir, uint64_t max_size) : dir_(dir), max_size_(max_size) {
+    if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        LOG(FATAL) << "Cannot create " << dir_ << ": " << strerror(errno);
+    }
+    const std::string lock_filename = dir_ + "/lock";
+    lock_fd_ = open(lock_filename.c_str(), O_RDWR | O_CREAT, 0644);
+    CHECK(lock_fd_ >= 0) << "Cannot open " << lock_filename << ": " << strerror(errno);
+    linker_digest_ = GetLinkerDigest();
+}
+
+OutputCache::~OutputCache() {
+    close(lock_fd_);
+}
+
+std::string OutputCache::EntryFilename(const std::string& key) const {
+    return dir_ + "/" + linker_digest_ + "-" + key + kEntrySuffix;
+}
+
+bool OutputCache::Fetch(const std::string& key, const std::string& out_filename) {
+    const std::string entry = EntryFilename(key);
+    // Copy to a temporary file first so that the previous output is kept
+    // when the copy fails and programs running it never see a partial one.
+    const std::string tmp = out_filename + TempSuffix();
+    bool hit = CopyFile(entry, tmp);
+    if (hit) {
+        CHECK(chmod(tmp.c_str(), 0755) == 0) << tmp << ": " << strerror(errno);
+        CHECK(rename(tmp.c_str(), out_filename.c_str()) == 0) << out_filename << ": " << strerror(errno);
+        // Mark the entry as recently used.
+        utimensat(AT_FDCWD, entry.c_str(), nullptr, 0);
+        LOG(INFO) << "OutputCache hit: " << entry;
+    } else {
+        unlink(tmp.c_str());
+        LOG(INFO) << "OutputCache miss: " << entry;
+    }
+
+    Lock();
+    UpdateStats(hit ? 1 : 0, hit ? 0 : 1, 0);
+    Unlock();
+    return hit;
+}
+
+void OutputCache::Insert(const std::string& key, const std::string& out_filename) {
+    const std::string entry = EntryFilename(key);
+    // Copy to a temporary file first so that concurrent Fetch never sees a
+    // partial output.
+    const std::string tmp = entry + TempSuffix();
+    if (!CopyFile(out_filename, tmp) || rename(tmp.c_str(), entry.c_str()) != 0) {
+        LOG(WARNING) << "Cannot insert " << out_filename << " to " << dir_ << ": " << strerror(errno);
+        unlink(tmp.c_str());
+        return;
+    }
+    LOG(INFO) << "OutputCache inserted: " << entry;
+
+    Lock();
+    Evict();
+    Unlock();
+}
+
+void OutputCache::Evict() {
+    // (mtime, size, filename)
+    std::vector<std::tuple<struct timespec, uint64_t, std::string>> entries;
+    uint64_t total = 0;
+    if (DIR* d = opendir(dir_.c_str())) {
+        while (struct dirent* ent = readdir(d)) {
+            const std::string name = ent->d_name;
+            if (!EndsWith(name, kEntrySuffix)) continue;
+            const std::string filename = dir_ + "/" + name;
+            struct stat st;
+            if (stat(filename.c_str(), &st) != 0) continue;
+            entries.emplace_back(st.st_mtim, st.st_size, filename);
+            total += st.st_size;
+        }
+        closedir(d);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        const struct timespec& ta = std::get<0>(a);
+        const struct timespec& tb = std::get<0>(b);
+        return std::tie(ta.tv_sec, ta.tv_nsec) < std::tie(tb.tv_sec, tb.tv_nsec);
+    });
+
+    uint64_t evictions = 0;
+    // Keep the most recently used one even when it exceeds the limit alone.
+    for (size_t i = 0; i + 1 < entries.size() && total > max_size_; i++) {
+        const std::string& filename = std::get<2>(entries[i]);
+        if (unlink(filename.c_str()) != 0) continue;
+        LOG(INFO) << "OutputCache evicted: " << filename;
+        total -= std::get<1>(entries[i]);
+        evictions++;
+    }
+    UpdateStats(0, 0, evictions);
+}
+
+OutputCache::Stats OutputCache::ReadStats() {
+    Stats stats;
+    std::ifstream ifs(dir_ + "/stats");
+    std::string name;
+    uint64_t value;
+    while (ifs >> name >> value) {
+        if (name == "hits") {
+            stats.hits = value;
+        } else if (name == "misses") {
+            stats.misses = value;
+        } else if (name == "evictions") {
+            stats.evictions = value;
+        }
+    }
+    return stats;
+}
+
+void OutputCache::UpdateStats(uint64_t hits, uint64_t misses, uint64_t evictions) {
+    Stats stats = ReadStats();
+    stats.hits += hits;
+    stats.misses += misses;
+    stats.evictions += evictions;
+
+    const std::string filename = dir_ + "/stats";
+    const std::string tmp = filename + TempSuffix();
+    {
+        std::ofstream ofs(tmp);
+        ofs << "hits " << stats.hits << "\n";
+        ofs << "misses " << stats.misses << "\n";
+        ofs << "evictions " << stats.evictions << "\n";
+    }
+    if (rename(tmp.c_str(), filename.c_str()) != 0) {
+        LOG(WARNING) << "Cannot update " << filename << ": " << strerror(errno);
+        unlink(tmp.c_str());
+    }
+}
+
+std::string OutputCache::ShowStats() {
+    Lock();
+    Stats stats = ReadStats();
+    Unlock();
+
+    uint64_t entries = 0;
+    uint64_t total = 0;
+    if (DIR* d = opendir(dir_.c_str())) {
+        while (struct dirent* ent = readdir(d)) {
+            const std::string name = ent->d_name;
+            if (!EndsWith(name, kEntrySuffix)) continue;
+            struct stat st;
+            if (stat((dir_ + "/" + name).c_str(), &st) != 0) continue;
+            entries++;
+            total += st.st_size;
+        }
+        closedir(d);
+    }
+
+    std::stringstream ss;
+    ss << "hits: " << stats.hits << "\n";
+    ss << "misses: " << stats.misses << "\n";
+    ss << "evictions: " << stats.evictions << "\n";
+    ss << "entries: " << entries << "\n";
+    ss << "size: " << total << " / " << max_size_ << "\n";
+    return ss.str();
+}
+
+void OutputCache::Lock() {
+    CHECK(flock(lock_fd_, LOCK_EX) == 0) << strerror(errno);
+}
+
+void OutputCache::Unlock() {
+    CHECK(flock(lock_fd_, LOCK_UN) == 0) << strerror(errno);
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+
+#include "utils.h"
+
+// OutputCache keeps outputs of sold in a directory keyed by
+// Sold::ClosureDigest so that sold can skip linking when neither the inputs
+// nor the options changed. Outputs are also keyed by the sold executable
+// itself.
+//
+// The directory has
+// - <linker digest>-<closure digest>.out: cached outputs
+// - stats: the numbers of hits, misses and evictions
+// - lock: a lock file to update stats and to evict entries
+//
+// The least recently used outputs are evicted when the total size of
+// outputs exceeds max_size. The mtime of an output is its last use.
+class OutputCache {
+public:
+    OutputCache(const std::string& dir, uint64_t max_size);
+    ~OutputCache();
+
+    // Fetch copies the output for `key` to `out_filename`, which is replaced
+    // by a rename. Returns false when the cache does not have it.
+    bool Fetch(const std::string& key, const std::string& out_filename);
+
+    // Insert adds `out_filename` as the output for `key`.
+    void Insert(const std::string& key, const std::string& out_filename);
+
+    std::string ShowStats();
+
+private:
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0};
+    };
+
+    std::string EntryFilename(const std::string& key) const;
+    // UpdateStats and Evict must be called while lock_fd_ is locked.
+    void UpdateStats(uint64_t hits, uint64_t misses, uint64_t evictions);
+    Stats ReadStats();
+    void Evict();
+    void Lock();
+    void Unlock();
+
+    const std::string dir_;
+    const uint64_t max_size_;
+    std::string linker_digest_;
+    int lock_fd_{-1};
+};
@@ -0,0 +1,602 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "output_verifier.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#include "hash.h"
+
+namespace {
+
+// Reports beyond this number for one check are counted but not recorded.
+constexpr int kMaxFindingsPerCheck = 16;
+
+template <class T>
+T Load(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+bool IsPowerOfTwo(uintptr_t v) {
+    return (v & (v - 1)) == 0;
+}
+
+std::string EscapeJSON(const std::string& s) {
+    std::string r;
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            r += '\\';
+            r += c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            r += buf;
+        } else {
+            r += c;
+        }
+    }
+    return r;
+}
+
+}  // namespace
+
+OutputVerifier::OutputVerifier(const std::string& filename) : filename_(filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        Report("file", 0, std::string("cannot open: ") + strerror(errno));
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        Report("file", 0, "cannot stat or empty");
+        close(fd);
+        return;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        Report("file", 0, std::string("cannot mmap: ") + strerror(errno));
+        return;
+    }
+    head_ = reinterpret_cast<const char*>(p);
+    size_ = st.st_size;
+}
+
+OutputVerifier::~OutputVerifier() {
+    if (head_) munmap(const_cast<char*>(head_), size_);
+}
+
+const std::vector<OutputVerifier::Finding>& OutputVerifier::Verify() {
+    if (!head_) return findings_;
+
+    const Elf_Ehdr* ehdr = reinterpret_cast<const Elf_Ehdr*>(head_);
+    if (size_ < sizeof(Elf_Ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != ELFCLASS64) {
+        Report("ehdr", 0, "not a 64bit ELF");
+        return findings_;
+    }
+
+    CheckPhdrs();
+    CheckDynamic();
+    CheckEHFrameHeader();
+    CheckTLS();
+
+    if (num_suppressed_) Report("verifier", 0, std::to_string(num_suppressed_) + " more findings are suppressed");
+    return findings_;
+}
+
+void OutputVerifier::WriteJSON(std::ostream& os) const {
+    for (const Finding& f : findings_) {
+        os << "{\"file\":\"" << EscapeJSON(filename_) << "\",\"check\":\"" << f.check << "\",\"address\":\"" << HexString(f.address)
+           << "\",\"message\":\"" << EscapeJSON(f.message) << "\"}" << std::endl;
+    }
+}
+
+void OutputVerifier::Report(const char* check, uintptr_t address, const std::string& message) {
+    if (num_findings_[check]++ >= kMaxFindingsPerCheck) {
+        num_suppressed_++;
+        return;
+    }
+    findings_.push_back(Finding{check, address, message});
+}
+
+const char* OutputVerifier::Mapped(uintptr_t addr, uintptr_t size) const {
+    for (const Elf_Phdr* load : loads_) {
+        if (addr < load->p_vaddr) continue;
+        const uintptr_t off = addr - load->p_vaddr;
+        if (off > load->p_filesz || size > load->p_filesz - off) continue;
+        if (load->p_offset > size_ || load->p_filesz > size_ - load->p_offset) continue;
+        return head_ + load->p_offset + off;
+    }
+    return nullptr;
+}
+
+bool OutputVerifier::InLoad(uintptr_t addr, uintptr_t size, bool writable) const {
+    for (const Elf_Phdr* load : loads_) {
+        if (addr < load->p_vaddr) continue;
+        const uintptr_t off = addr - load->p_vaddr;
+        if (off > load->p_memsz || size > load->p_memsz - off) continue;
+        if (writable && !(load->p_flags & PF_W)) continue;
+        return true;
+    }
+    return false;
+}
+
+const char* OutputVerifier::String(uintptr_t offset) const {
+    if (!strtab_data_ || offset >= strsz_) return nullptr;
+    return strtab_data_ + offset;
+}
+
+void OutputVerifier::CheckPhdrs() {
+    const Elf_Ehdr* ehdr = reinterpret_cast<const Elf_Ehdr*>(head_);
+    if (ehdr->e_phentsize != sizeof(Elf_Phdr) || ehdr->e_phoff > size_ || ehdr->e_phnum * sizeof(Elf_Phdr) > size_ - ehdr->e_phoff) {
+        Report("phdr", ehdr->e_phoff, "program headers are out of the file");
+        return;
+    }
+
+    const Elf_Phdr* phdrs = reinterpret_cast<const Elf_Phdr*>(head_ + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        const Elf_Phdr* phdr = &phdrs[i];
+        switch (phdr->p_type) {
+            case PT_LOAD:
+                loads_.push_back(phdr);
+                break;
+            case PT_DYNAMIC:
+                dynamic_ = phdr;
+                break;
+            case PT_GNU_EH_FRAME:
+                eh_frame_ = phdr;
+                break;
+            case PT_TLS:
+                tls_ = phdr;
+                break;
+        }
+        if (phdr->p_type == PT_NULL || phdr->p_type == PT_GNU_STACK) continue;
+
+        if (phdr->p_offset > size_ || phdr->p_filesz > size_ - phdr->p_offset) {
+            Report("phdr", phdr->p_vaddr, "segment " + std::to_string(i) + " is out of the file");
+        }
+        if (phdr->p_filesz > phdr->p_memsz) {
+            Report("phdr", phdr->p_vaddr, "segment " + std::to_string(i) + " has p_filesz larger than p_memsz");
+        }
+        if (!IsPowerOfTwo(phdr->p_align)) {
+            Report("phdr", phdr->p_vaddr, "segment " + std::to_string(i) + " has p_align which is not a power of two");
+        }
+    }
+
+    if (loads_.empty()) {
+        Report("phdr", 0, "no PT_LOAD");
+        return;
+    }
+
+    for (size_t i = 0; i < loads_.size(); i++) {
+        const Elf_Phdr* load = loads_[i];
+        if (load->p_align > 1 && (load->p_vaddr - load->p_offset) % load->p_align != 0) {
+            Report("phdr", load->p_vaddr, "p_vaddr and p_offset of PT_LOAD are not congruent modulo p_align");
+        }
+        if (i == 0) continue;
+
+        // The loader maps segments page by page in the order of PT_LOAD, so a
+        // page shared by two segments must have the same contents for both.
+        const Elf_Phdr* prev = loads_[i - 1];
+        const uintptr_t prev_end = prev->p_vaddr + prev->p_memsz;
+        if (load->p_vaddr < prev->p_vaddr) {
+            Report("phdr", load->p_vaddr, "PT_LOAD segments are not sorted by address");
+        } else if (load->p_vaddr < prev_end) {
+            Report("phdr", load->p_vaddr, "PT_LOAD overlaps the previous one ending at " + HexString(prev_end));
+        } else if ((load->p_vaddr & ~(LINUX_PAGE_SIZE - 1)) < AlignNext(prev_end) &&
+                   (load->p_vaddr - load->p_offset != prev->p_vaddr - prev->p_offset || prev->p_filesz != prev->p_memsz)) {
+            Report("phdr", load->p_vaddr, "PT_LOAD shares a page with the previous one with different contents");
+        }
+    }
+}
+
+void OutputVerifier::CheckDynamic() {
+    if (!dynamic_) {
+        Report("dynamic", 0, "no PT_DYNAMIC");
+        return;
+    }
+    const char* p = Mapped(dynamic_->p_vaddr, dynamic_->p_filesz);
+    if (!p) {
+        Report("dynamic", dynamic_->p_vaddr, "PT_DYNAMIC is not mapped");
+        return;
+    }
+    if (p != head_ + dynamic_->p_offset) {
+        Report("dynamic", dynamic_->p_vaddr, "p_offset of PT_DYNAMIC does not match PT_LOAD");
+    }
+
+    std::vector<Elf_Dyn> dyns;
+    bool terminated = false;
+    for (uintptr_t off = 0; off + sizeof(Elf_Dyn) <= dynamic_->p_filesz; off += sizeof(Elf_Dyn)) {
+        Elf_Dyn dyn = Load<Elf_Dyn>(p + off);
+        if (dyn.d_tag == DT_NULL) {
+            terminated = true;
+            break;
+        }
+        dyns.push_back(dyn);
+    }
+    if (!terminated) Report("dynamic", dynamic_->p_vaddr, "no DT_NULL");
+
+    uintptr_t hash = 0, rela = 0, relasz = 0, jmprel = 0, pltrelsz = 0, pltrel = DT_RELA;
+    for (const Elf_Dyn& dyn : dyns) {
+        const uintptr_t v = dyn.d_un.d_val;
+        switch (dyn.d_tag) {
+            case DT_STRTAB:
+                strtab_ = v;
+                break;
+            case DT_STRSZ:
+                strsz_ = v;
+                break;
+            case DT_SYMTAB:
+                symtab_ = v;
+                break;
+            case DT_GNU_HASH:
+                gnu_hash_ = v;
+                break;
+            case DT_HASH:
+                hash = v;
+                break;
+            case DT_VERSYM:
+                versym_ = v;
+                break;
+            case DT_VERNEED:
+                verneed_ = v;
+                break;
+            case DT_VERNEEDNUM:
+                verneednum_ = v;
+                break;
+            case DT_VERDEF:
+                verdef_ = v;
+                break;
+            case DT_VERDEFNUM:
+                verdefnum_ = v;
+                break;
+            case DT_RELA:
+                rela = v;
+                break;
+            case DT_RELASZ:
+                relasz = v;
+                break;
+            case DT_JMPREL:
+                jmprel = v;
+                break;
+            case DT_PLTRELSZ:
+                pltrelsz = v;
+                break;
+            case DT_PLTREL:
+                pltrel = v;
+                break;
+            case DT_REL:
+                Report("dynamic", dynamic_->p_vaddr, "DT_REL is not supported on this architecture");
+                break;
+            case DT_SYMENT:
+                if (v != sizeof(Elf_Sym)) Report("dynamic", v, "wrong DT_SYMENT");
+                break;
+            case DT_RELAENT:
+                if (v != sizeof(Elf_Rel)) Report("dynamic", v, "wrong DT_RELAENT");
+                break;
+        }
+    }
+
+    strtab_data_ = Mapped(strtab_, strsz_);
+    if (!strtab_ || !strtab_data_) {
+        Report("dynamic", strtab_, "DT_STRTAB is not mapped");
+        strsz_ = 0;
+    } else if (strsz_ && strtab_data_[strsz_ - 1] != '\0') {
+        Report("dynamic", strtab_, "DT_STRTAB does not end with NUL");
+    }
+
+    auto check_array = [this](const std::vector<Elf_Dyn>& dyns, int64_t addr_tag, int64_t size_tag, const char* name) {
+        uintptr_t addr = 0, size = 0;
+        for (const Elf_Dyn& dyn : dyns) {
+            if (dyn.d_tag == addr_tag) addr = dyn.d_un.d_ptr;
+            if (dyn.d_tag == size_tag) size = dyn.d_un.d_val;
+        }
+        if (!addr) return;
+        if (size % sizeof(Elf_Addr) != 0) Report("dynamic", addr, std::string(name) + " has a wrong size");
+        if (!Mapped(addr, size)) Report("dynamic", addr, std::string(name) + " is not mapped");
+    };
+    check_array(dyns, DT_INIT_ARRAY, DT_INIT_ARRAYSZ, "DT_INIT_ARRAY");
+    check_array(dyns, DT_FINI_ARRAY, DT_FINI_ARRAYSZ, "DT_FINI_ARRAY");
+    check_array(dyns, DT_PREINIT_ARRAY, DT_PREINIT_ARRAYSZ, "DT_PREINIT_ARRAY");
+
+    for (const Elf_Dyn& dyn : dyns) {
+        const uintptr_t v = dyn.d_un.d_val;
+        switch (dyn.d_tag) {
+            case DT_NEEDED:
+            case DT_SONAME:
+            case DT_RPATH:
+            case DT_RUNPATH:
+                if (!String(v)) Report("dynamic", v, "string of tag " + HexString(dyn.d_tag) + " is out of DT_STRTAB");
+                break;
+            case DT_INIT:
+            case DT_FINI:
+            case DT_PLTGOT:
+                if (!InLoad(v, 1)) Report("dynamic", v, "address of tag " + HexString(dyn.d_tag) + " is not mapped");
+                break;
+        }
+    }
+
+    if (gnu_hash_) {
+        CheckGnuHash();
+    } else if (hash) {
+        if (const char* h = Mapped(hash, sizeof(uint32_t) * 2)) {
+            num_syms_ = Load<uint32_t>(h + sizeof(uint32_t));
+        } else {
+            Report("dynamic", hash, "DT_HASH is not mapped");
+        }
+    } else {
+        Report("dynamic", dynamic_->p_vaddr, "neither DT_GNU_HASH nor DT_HASH");
+    }
+
+    CheckSymbols();
+    CheckVersions();
+    CheckRelocations(rela, relasz, "DT_RELA");
+    if (jmprel && pltrel != DT_RELA) Report("dynamic", jmprel, "DT_PLTREL is not DT_RELA");
+    CheckRelocations(jmprel, pltrelsz, "DT_JMPREL");
+}
+
+void OutputVerifier::CheckGnuHash() {
+    const char* p = Mapped(gnu_hash_, sizeof(uint32_t) * 4);
+    if (!p) {
+        Report("gnu_hash", gnu_hash_, "DT_GNU_HASH is not mapped");
+        return;
+    }
+    const uint32_t nbuckets = Load<uint32_t>(p);
+    const uint32_t symndx = Load<uint32_t>(p + 4);
+    const uint32_t maskwords = Load<uint32_t>(p + 8);
+    const uint32_t shift2 = Load<uint32_t>(p + 12);
+    if (nbuckets == 0 || maskwords == 0 || !IsPowerOfTwo(maskwords)) {
+        Report("gnu_hash", gnu_hash_, "wrong nbuckets or maskwords");
+        return;
+    }
+    const uintptr_t buckets_addr = gnu_hash_ + sizeof(uint32_t) * 4 + sizeof(Elf_Addr) * maskwords;
+    const uintptr_t chains_addr = buckets_addr + sizeof(uint32_t) * nbuckets;
+    const char* tables = Mapped(gnu_hash_, chains_addr - gnu_hash_);
+    if (!tables) {
+        Report("gnu_hash", gnu_hash_, "bloom filter or buckets are not mapped");
+        return;
+    }
+    const char* bloom = tables + (buckets_addr - gnu_hash_) - sizeof(Elf_Addr) * maskwords;
+    const char* buckets = tables + (buckets_addr - gnu_hash_);
+
+    // The number of symbols is the end of the last chain.
+    uint32_t last = 0;
+    for (uint32_t b = 0; b < nbuckets; b++) last = std::max(last, Load<uint32_t>(buckets + b * 4));
+    uint32_t num_syms = symndx;
+    if (last) {
+        if (last < symndx) {
+            Report("gnu_hash", buckets_addr, "a bucket points to a symbol before symndx");
+            return;
+        }
+        for (uint32_t i = last;; i++) {
+            const char* c = Mapped(chains_addr + (i - symndx) * 4, 4);
+            if (!c) {
+                Report("gnu_hash", chains_addr, "the last chain is not terminated");
+                return;
+            }
+            if (Load<uint32_t>(c) & 1) {
+                num_syms = i + 1;
+                break;
+            }
+        }
+    }
+    num_syms_ = num_syms;
+
+    const char* syms = Mapped(symtab_, num_syms * sizeof(Elf_Sym));
+    const char* chains = Mapped(chains_addr, (num_syms - symndx) * 4);
+    if (!syms || !chains) return;
+
+    // Symbols must be grouped by bucket in the order of buckets.
+    uint32_t expected = symndx;
+    for (uint32_t b = 0; b < nbuckets; b++) {
+        const uint32_t start = Load<uint32_t>(buckets + b * 4);
+        if (start == 0) continue;
+        if (start != expected) {
+            Report("gnu_hash", buckets_addr + b * 4, "bucket " + std::to_string(b) + " starts at " + std::to_string(start) + " but " +
+                                                         std::to_string(expected) + " is expected");
+        }
+        uint32_t i = start;
+        for (; i < num_syms; i++) {
+            const Elf_Sym sym = Load<Elf_Sym>(syms + i * sizeof(Elf_Sym));
+            const uint32_t chain = Load<uint32_t>(chains + (i - symndx) * 4);
+            const char* name = String(sym.st_name);
+            if (name) {
+                const uint32_t h = CalcGnuHash(name);
+                if (h % nbuckets != b) Report("gnu_hash", i, std::string(name) + " is in a wrong bucket");
+                if ((h | 1) != (chain | 1)) Report("gnu_hash", i, std::string(name) + " has a wrong hash value in its chain");
+                const Elf_Addr word = Load<Elf_Addr>(bloom + (h / 64 % maskwords) * sizeof(Elf_Addr));
+                const Elf_Addr bits = (Elf_Addr(1) << (h % 64)) | (Elf_Addr(1) << ((h >> shift2) % 64));
+                if ((word & bits) != bits) Report("gnu_hash", i, std::string(name) + " is rejected by the bloom filter");
+            }
+            if (chain & 1) break;
+        }
+        expected = i + 1;
+    }
+}
+
+void OutputVerifier::CheckSymbols() {
+    if (!symtab_) {
+        Report("symbol", 0, "no DT_SYMTAB");
+        return;
+    }
+    const char* syms = Mapped(symtab_, num_syms_ * sizeof(Elf_Sym));
+    if (!syms) {
+        Report("symbol", symtab_, "DT_SYMTAB is not mapped");
+        return;
+    }
+    for (uintptr_t i = 1; i < num_syms_; i++) {
+        const Elf_Sym sym = Load<Elf_Sym>(syms + i * sizeof(Elf_Sym));
+        const char* name = String(sym.st_name);
+        if (!name) {
+            Report("symbol", i, "the name of symbol " + std::to_string(i) + " is out of DT_STRTAB");
+            continue;
+        }
+        if (sym.st_shndx == SHN_UNDEF || sym.st_shndx == SHN_ABS) continue;
+        if (ELF_ST_TYPE(sym.st_info) == STT_TLS) {
+            if (!tls_ || sym.st_value + sym.st_size > tls_->p_memsz) Report("symbol", sym.st_value, std::string(name) + " is out of PT_TLS");
+        } else if (sym.st_value && !InLoad(sym.st_value, std::max<uintptr_t>(sym.st_size, 1))) {
+            Report("symbol", sym.st_value, std::string(name) + " is not mapped");
+        }
+    }
+}
+
+void OutputVerifier::CheckVersions() {
+    std::set<Elf_Versym> indices = {VER_NDX_LOCAL, VER_NDX_GLOBAL};
+
+    uintptr_t addr = verneed_;
+    for (uintptr_t n = 0; verneed_ && n < verneednum_; n++) {
+        const char* p = Mapped(addr, sizeof(Elf_Verneed));
+        if (!p) {
+            Report("version", addr, "DT_VERNEED is not mapped");
+            break;
+        }
+        const Elf_Verneed vn = Load<Elf_Verneed>(p);
+        if (vn.vn_version != VER_NEED_CURRENT) Report("version", addr, "wrong vn_version");
+        if (!String(vn.vn_file)) Report("version", addr, "vn_file is out of DT_STRTAB");
+        uintptr_t aux = addr + vn.vn_aux;
+        for (int i = 0; i < vn.vn_cnt; i++) {
+            const char* q = Mapped(aux, sizeof(Elf_Vernaux));
+            if (!q) {
+                Report("version", aux, "Elf_Vernaux is not mapped");
+                break;
+            }
+            const Elf_Vernaux vna = Load<Elf_Vernaux>(q);
+            if (!String(vna.vna_name)) Report("version", aux, "vna_name is out of DT_STRTAB");
+            indices.insert(vna.vna_other & VERSYM_VERSION);
+            aux += vna.vna_next;
+        }
+        if (!vn.vn_next && n + 1 < verneednum_) {
+            Report("version", addr, "DT_VERNEED has less entries than DT_VERNEEDNUM");
+            break;
+        }
+        addr += vn.vn_next;
+    }
+
+    addr = verdef_;
+    for (uintptr_t n = 0; verdef_ && n < verdefnum_; n++) {
+        const char* p = Mapped(addr, sizeof(Elf_Verdef));
+        if (!p) {
+            Report("version", addr, "DT_VERDEF is not mapped");
+            break;
+        }
+        const Elf_Verdef vd = Load<Elf_Verdef>(p);
+        if (vd.vd_version != VER_DEF_CURRENT) Report("version", addr, "wrong vd_version");
+        indices.insert(vd.vd_ndx & VERSYM_VERSION);
+        if (vd.vd_cnt) {
+            const char* q = Mapped(addr + vd.vd_aux, sizeof(Elf_Verdaux));
+            if (!q || !String(Load<Elf_Verdaux>(q).vda_name)) Report("version", addr, "vda_name is out of DT_STRTAB");
+        }
+        if (!vd.vd_next && n + 1 < verdefnum_) {
+            Report("version", addr, "DT_VERDEF has less entries than DT_VERDEFNUM");
+            break;
+        }
+        addr += vd.vd_next;
+    }
+
+    if (!versym_) return;
+    const char* versyms = Mapped(versym_, num_syms_ * sizeof(Elf_Versym));
+    if (!versyms) {
+        Report("version", versym_, "DT_VERSYM is not mapped");
+        return;
+    }
+    for (uintptr_t i = 0; i < num_syms_; i++) {
+        const Elf_Versym v = Load<Elf_Versym>(versyms + i * sizeof(Elf_Versym)) & VERSYM_VERSION;
+        if (!indices.count(v)) Report("version", i, "symbol " + std::to_string(i) + " has an unknown version index " + std::to_string(v));
+    }
+}
+
+void OutputVerifier::CheckRelocations(uintptr_t addr, uintptr_t size, const char* name) {
+    if (!addr || !size) return;
+    if (size % sizeof(Elf_Rel) != 0) Report("relocation", addr, std::string(name) + " has a wrong size");
+    const char* rels = Mapped(addr, size);
+    if (!rels) {
+        Report("relocation", addr, std::string(name) + " is not mapped");
+        return;
+    }
+    for (uintptr_t off = 0; off + sizeof(Elf_Rel) <= size; off += sizeof(Elf_Rel)) {
+        const Elf_Rel rel = Load<Elf_Rel>(rels + off);
+        if (ELF_R_TYPE(rel.r_info) == 0) continue;
+        if (ELF_R_SYM(rel.r_info) >= num_syms_) {
+            Report("relocation", rel.r_offset, ShowRelocationType(ELF_R_TYPE(rel.r_info)) + " refers to a symbol out of DT_SYMTAB");
+        }
+        if (!InLoad(rel.r_offset, sizeof(Elf_Addr), true)) {
+            Report("relocation", rel.r_offset, ShowRelocationType(ELF_R_TYPE(rel.r_info)) + " writes out of writable PT_LOAD");
+        }
+    }
+}
+
+void OutputVerifier::CheckEHFrameHeader() {
+    if (!eh_frame_) return;
+    const uintptr_t addr = eh_frame_->p_vaddr;
+    const char* p = Mapped(addr, eh_frame_->p_filesz);
+    if (!p || eh_frame_->p_filesz < 4) {
+        Report("eh_frame_hdr", addr, "PT_GNU_EH_FRAME is not mapped");
+        return;
+    }
+    if (p[0] != 1) Report("eh_frame_hdr", addr, "wrong version");
+    const uint8_t eh_frame_ptr_enc = p[1];
+    const uint8_t fde_count_enc = p[2];
+    const uint8_t table_enc = p[3];
+    if (fde_count_enc == DW_EH_PE_omit || table_enc == DW_EH_PE_omit) return;
+    if (eh_frame_ptr_enc != (DW_EH_PE_pcrel | DW_EH_PE_sdata4) || fde_count_enc != DW_EH_PE_udata4 ||
+        table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata4)) {
+        Report("eh_frame_hdr", addr, "unsupported encodings");
+        return;
+    }
+    if (eh_frame_->p_filesz < 12) {
+        Report("eh_frame_hdr", addr, "too small");
+        return;
+    }
+
+    const uintptr_t eh_frame_ptr = addr + 4 + Load<int32_t>(p + 4);
+    if (!InLoad(eh_frame_ptr, 1)) Report("eh_frame_hdr", eh_frame_ptr, ".eh_frame is not mapped");
+
+    const uint32_t fde_count = Load<uint32_t>(p + 8);
+    if (12 + uintptr_t(fde_count) * 8 > eh_frame_->p_filesz) {
+        Report("eh_frame_hdr", addr, "the table is larger than PT_GNU_EH_FRAME");
+        return;
+    }
+    for (uint32_t i = 0; i < fde_count; i++) {
+        const int32_t initial_loc = Load<int32_t>(p + 12 + i * 8);
+        const int32_t fde = Load<int32_t>(p + 12 + i * 8 + 4);
+        if (i && initial_loc < Load<int32_t>(p + 12 + (i - 1) * 8)) {
+            Report("eh_frame_hdr", addr + initial_loc, "the table is not sorted at entry " + std::to_string(i));
+        }
+        // An FDE starts with its length and the offset to its CIE.
+        if (!Mapped(addr + fde, 8)) Report("eh_frame_hdr", addr + fde, "FDE of entry " + std::to_string(i) + " is not mapped");
+    }
+}
+
+void OutputVerifier::CheckTLS() {
+    if (!tls_) return;
+    if (tls_->p_filesz > tls_->p_memsz) Report("tls", tls_->p_vaddr, "the initialization image is larger than PT_TLS");
+    if (!tls_->p_filesz) return;
+    const char* image = Mapped(tls_->p_vaddr, tls_->p_filesz);
+    if (!image) {
+        Report("tls", tls_->p_vaddr, "the initialization image is not mapped");
+    } else if (image != head_ + tls_->p_offset) {
+        Report("tls", tls_->p_vaddr, "p_offset of PT_TLS does not match PT_LOAD");
+    }
+}
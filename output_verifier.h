@@ -0,0 +1,102 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+// OutputVerifier checks structural invariants of an ELF emitted by sold
+// without linking it again. It maps the output read-only, parses it once
+// and checks
+// - program headers: bounds, alignment and overlaps of PT_LOAD segments,
+// - .dynamic: tables pointed from it are mapped and strings are in DT_STRTAB,
+// - symbols: names, version indices and the GNU hash table,
+// - relocations: symbol indices and targets in writable segments,
+// - PT_GNU_EH_FRAME: the FDE table is sorted and points to mapped memory,
+// - PT_TLS: the initialization image is mapped.
+// Problems are returned as findings instead of aborting so that all of
+// them are reported at once.
+class OutputVerifier {
+public:
+    struct Finding {
+        // The name of the check, e.g. "phdr" or "gnu_hash".
+        std::string check;
+        // The virtual address (or the file offset for file-level checks) of
+        // the problem.
+        uintptr_t address{0};
+        std::string message;
+    };
+
+    explicit OutputVerifier(const std::string& filename);
+    ~OutputVerifier();
+
+    // Verify runs all checks. An empty result means the output passed.
+    const std::vector<Finding>& Verify();
+
+    // WriteJSON writes each finding as a JSON object on its own line.
+    void WriteJSON(std::ostream& os) const;
+
+private:
+    void CheckPhdrs();
+    void CheckDynamic();
+    void CheckGnuHash();
+    void CheckSymbols();
+    void CheckVersions();
+    void CheckRelocations(uintptr_t addr, uintptr_t size, const char* name);
+    void CheckEHFrameHeader();
+    void CheckTLS();
+
+    void Report(const char* check, uintptr_t address, const std::string& message);
+
+    // Mapped returns the file contents of [addr, addr + size) when the range
+    // is backed by the file in a PT_LOAD segment, or nullptr.
+    const char* Mapped(uintptr_t addr, uintptr_t size) const;
+    // InLoad tells whether [addr, addr + size) is in the memory of a PT_LOAD
+    // segment, which must be writable when `writable` is set.
+    bool InLoad(uintptr_t addr, uintptr_t size, bool writable = false) const;
+    const char* String(uintptr_t offset) const;
+
+    const std::string filename_;
+    const char* head_{nullptr};
+    size_t size_{0};
+    std::vector<Finding> findings_;
+
+    std::map<std::string, int> num_findings_;
+    int num_suppressed_{0};
+
+    std::vector<const Elf_Phdr*> loads_;
+    const Elf_Phdr* dynamic_{nullptr};
+    const Elf_Phdr* eh_frame_{nullptr};
+    const Elf_Phdr* tls_{nullptr};
+
+    // Values of .dynamic. Zero when missing.
+    uintptr_t strtab_{0};
+    uintptr_t strsz_{0};
+    const char* strtab_data_{nullptr};
+    uintptr_t symtab_{0};
+    uintptr_t gnu_hash_{0};
+    uintptr_t versym_{0};
+    uintptr_t verneed_{0};
+    uintptr_t verneednum_{0};
+    uintptr_t verdef_{0};
+    uintptr_t verdefnum_{0};
+    uintptr_t num_syms_{0};
+};
@@ -0,0 +1,90 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#include "hash.h"
+#include "utils.h"
+
+// Overlay records modifications to an input binary as (file offset ->
+// patched bytes). Inputs are mapped read-only and may be shared by Sold
+// instances, so Sold never writes into them. Patches are applied when the
+// contents of the input are emitted.
+class Overlay {
+public:
+    // Get returns the value at `offset` with patches applied.
+    template <class T>
+    T Get(const char* head, uintptr_t offset) const {
+        T v;
+        memcpy(&v, head + offset, sizeof(v));
+        auto found = patches_.find(offset);
+        if (found != patches_.end()) {
+            CHECK_EQ(found->second.size(), sizeof(v));
+            memcpy(&v, found->second.data(), sizeof(v));
+        }
+        return v;
+    }
+
+    template <class T>
+    void Set(uintptr_t offset, const T& v) {
+        const char* p = reinterpret_cast<const char*>(&v);
+        auto next = patches_.lower_bound(offset);
+        if (next != patches_.end() && next->first == offset) {
+            CHECK_EQ(next->second.size(), sizeof(v)) << "Patches must not overlap" << SOLD_LOG_BITS(offset);
+            next->second.assign(p, p + sizeof(v));
+            return;
+        }
+        CHECK(next == patches_.end() || offset + sizeof(v) <= next->first) << "Patches must not overlap" << SOLD_LOG_BITS(offset);
+        CHECK(next == patches_.begin() || std::prev(next)->first + std::prev(next)->second.size() <= offset)
+            << "Patches must not overlap" << SOLD_LOG_BITS(offset);
+        patches_.emplace_hint(next, offset, std::vector<char>(p, p + sizeof(v)));
+    }
+
+    bool empty() const { return patches_.empty(); }
+
+    // Digest identifies the set of patches.
+    uint64_t Digest() const {
+        uint64_t h = 0;
+        for (const auto& p : patches_) {
+            h = HashBytes(&p.first, sizeof(p.first), h);
+            h = HashBytes(p.second.data(), p.second.size(), h);
+        }
+        return h;
+    }
+
+    // Emit writes [offset, offset + size) of the input with patches applied.
+    void Emit(FILE* fp, const char* head, uintptr_t offset, size_t size) const {
+        const uintptr_t end = offset + size;
+        uintptr_t pos = offset;
+        auto first = patches_.lower_bound(offset);
+        CHECK(first == patches_.begin() || std::prev(first)->first + std::prev(first)->second.size() <= offset)
+            << "A patch crosses the start of the range" << SOLD_LOG_BITS(offset);
+        for (auto iter = first; iter != patches_.end() && iter->first < end; ++iter) {
+            CHECK_LE(iter->first + iter->second.size(), end) << "A patch crosses the end of the range" << SOLD_LOG_BITS(iter->first);
+            WriteBuf(fp, head + pos, iter->first - pos);
+            WriteBuf(fp, iter->second.data(), iter->second.size());
+            pos = iter->first + iter->second.size();
+        }
+        WriteBuf(fp, head + pos, end - pos);
+    }
+
+private:
+    std::map<uintptr_t, std::vector<char>> patches_;
+};
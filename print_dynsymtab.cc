@@ -40,6 +40,6 @@ int main(int argc, const char* argv[]) {
     Sold sold(argv[1], {}, {}, {}, false);
 
     auto b = ReadELF(argv[1]);
-    b->ReadDynSymtab(sold.filename_to_soname());
-    std::cout << b->ShowDynSymtab();
+    b->ReadDynSymtab();
+    std::cout << b->ShowDynSymtab(sold.filename_to_soname());
 }
@@ -0,0 +1,158 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "relative_relocs.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+bool IsInRanges(uintptr_t addr, const Range* ranges) {
+    for (size_t i = 0; i < kNumRelativeRanges; i++) {
+        if (addr - ranges[i].start < ranges[i].end - ranges[i].start) return true;
+    }
+    return false;
+}
+
+#if defined(__x86_64__)
+
+bool HasAVX2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+// Four Elf64_Rela are three 256bit vectors:
+//   v0 = {offset0, info0, addend0, offset1}
+//   v1 = {info1, addend1, offset2, info2}
+//   v2 = {addend2, offset3, info3, addend3}
+
+__attribute__((target("avx2"))) size_t RelativeRunLengthAVX2(const Elf_Rel* rels, size_t num, uint64_t relative_info,
+                                                             const Range* ranges) {
+    static_assert(sizeof(Elf_Rel) == 24, "Unexpected layout of Elf_Rel");
+    // Unsigned comparisons are signed ones with flipped sign bits.
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i info = _mm256_set1_epi64x(relative_info);
+    __m256i starts[kNumRelativeRanges];
+    __m256i sizes[kNumRelativeRanges];
+    for (size_t i = 0; i < kNumRelativeRanges; i++) {
+        starts[i] = _mm256_set1_epi64x(ranges[i].start);
+        sizes[i] = _mm256_xor_si256(_mm256_set1_epi64x(ranges[i].end - ranges[i].start), sign);
+    }
+
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        const __m256i* p = reinterpret_cast<const __m256i*>(&rels[i]);
+        const __m256i v0 = _mm256_loadu_si256(p);
+        const __m256i v1 = _mm256_loadu_si256(p + 1);
+        const __m256i v2 = _mm256_loadu_si256(p + 2);
+        // {offset0, offset3, offset2, offset1} and {info1, info0, info3, info2}.
+        const __m256i offsets = _mm256_blend_epi32(_mm256_blend_epi32(v0, v1, 0x30), v2, 0x0c);
+        const __m256i infos = _mm256_blend_epi32(_mm256_blend_epi32(v1, v0, 0x0c), v2, 0x30);
+        __m256i bad = _mm256_xor_si256(_mm256_cmpeq_epi64(infos, info), _mm256_set1_epi64x(-1));
+        for (size_t j = 0; j < kNumRelativeRanges; j++) {
+            const __m256i d = _mm256_xor_si256(_mm256_sub_epi64(offsets, starts[j]), sign);
+            bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(sizes[j], d));
+        }
+        if (!_mm256_testz_si256(bad, bad)) break;
+    }
+    return i + RelativeRunLengthScalar(rels + i, num - i, relative_info, ranges);
+}
+
+__attribute__((target("avx2"))) void RebaseRelativesAVX2(Elf_Rel* rels, size_t num, uintptr_t offset) {
+    const __m256i d0 = _mm256_set_epi64x(offset, offset, 0, offset);
+    const __m256i d1 = _mm256_set_epi64x(0, offset, offset, 0);
+    const __m256i d2 = _mm256_set_epi64x(offset, 0, offset, offset);
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        __m256i* p = reinterpret_cast<__m256i*>(&rels[i]);
+        _mm256_storeu_si256(p, _mm256_add_epi64(_mm256_loadu_si256(p), d0));
+        _mm256_storeu_si256(p + 1, _mm256_add_epi64(_mm256_loadu_si256(p + 1), d1));
+        _mm256_storeu_si256(p + 2, _mm256_add_epi64(_mm256_loadu_si256(p + 2), d2));
+    }
+    RebaseRelativesScalar(rels + i, num - i, offset);
+}
+
+#elif defined(__aarch64__)
+
+// vld3q_u64 loads two Elf64_Rela split into offsets, infos and addends.
+
+size_t RelativeRunLengthNEON(const Elf_Rel* rels, size_t num, uint64_t relative_info, const Range* ranges) {
+    static_assert(sizeof(Elf_Rel) == 24, "Unexpected layout of Elf_Rel");
+    const uint64x2_t info = vdupq_n_u64(relative_info);
+    size_t i = 0;
+    for (; i + 2 <= num; i += 2) {
+        const uint64x2x3_t v = vld3q_u64(reinterpret_cast<const uint64_t*>(&rels[i]));
+        uint64x2_t ok = vceqq_u64(v.val[1], info);
+        for (size_t j = 0; j < kNumRelativeRanges; j++) {
+            const uint64x2_t d = vsubq_u64(v.val[0], vdupq_n_u64(ranges[j].start));
+            ok = vbicq_u64(ok, vcltq_u64(d, vdupq_n_u64(ranges[j].end - ranges[j].start)));
+        }
+        if (vminvq_u32(vreinterpretq_u32_u64(ok)) != UINT32_MAX) break;
+    }
+    return i + RelativeRunLengthScalar(rels + i, num - i, relative_info, ranges);
+}
+
+void RebaseRelativesNEON(Elf_Rel* rels, size_t num, uintptr_t offset) {
+    const uint64x2_t d = vdupq_n_u64(offset);
+    size_t i = 0;
+    for (; i + 2 <= num; i += 2) {
+        uint64_t* p = reinterpret_cast<uint64_t*>(&rels[i]);
+        uint64x2x3_t v = vld3q_u64(p);
+        v.val[0] = vaddq_u64(v.val[0], d);
+        v.val[2] = vaddq_u64(v.val[2], d);
+        vst3q_u64(p, v);
+    }
+    RebaseRelativesScalar(rels + i, num - i, offset);
+}
+
+#endif
+
+}  // namespace
+
+size_t RelativeRunLengthScalar(const Elf_Rel* rels, size_t num, uint64_t relative_info, const Range* ranges) {
+    size_t i = 0;
+    while (i < num && rels[i].r_info == relative_info && !IsInRanges(rels[i].r_offset, ranges)) i++;
+    return i;
+}
+
+void RebaseRelativesScalar(Elf_Rel* rels, size_t num, uintptr_t offset) {
+    for (size_t i = 0; i < num; i++) {
+        rels[i].r_offset += offset;
+        rels[i].r_addend += offset;
+    }
+}
+
+size_t RelativeRunLength(const Elf_Rel* rels, size_t num, uint64_t relative_info, const Range* ranges) {
+#if defined(__x86_64__)
+    if (HasAVX2()) return RelativeRunLengthAVX2(rels, num, relative_info, ranges);
+#elif defined(__aarch64__)
+    return RelativeRunLengthNEON(rels, num, relative_info, ranges);
+#endif
+    return RelativeRunLengthScalar(rels, num, relative_info, ranges);
+}
+
+void RebaseRelatives(Elf_Rel* rels, size_t num, uintptr_t offset) {
+#if defined(__x86_64__)
+    if (HasAVX2()) return RebaseRelativesAVX2(rels, num, offset);
+#elif defined(__aarch64__)
+    return RebaseRelativesNEON(rels, num, offset);
+#endif
+    RebaseRelativesScalar(rels, num, offset);
+}
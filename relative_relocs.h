@@ -0,0 +1,39 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "utils.h"
+
+// Kernels for runs of RELATIVE relocations, which are the majority of
+// relocations in large libraries. A RELATIVE relocation outside the TLS
+// initialization image and .init_array/.fini_array only moves by the offset
+// of its binary, so sold copies runs of them in bulk.
+
+constexpr size_t kNumRelativeRanges = 3;
+
+// RelativeRunLength returns the length of the longest prefix of `rels`
+// whose r_info is `relative_info` and whose r_offset is outside all of
+// `ranges`. Empty ranges never match.
+size_t RelativeRunLength(const Elf_Rel* rels, size_t num, uint64_t relative_info, const Range* ranges);
+
+// RebaseRelatives adds `offset` to r_offset and r_addend of `rels`.
+void RebaseRelatives(Elf_Rel* rels, size_t num, uintptr_t offset);
+
+// Portable versions of the above. They are used when the CPU has no
+// suitable vector unit and for comparisons in benchmarks.
+size_t RelativeRunLengthScalar(const Elf_Rel* rels, size_t num, uint64_t relative_info, const Range* ranges);
+void RebaseRelativesScalar(Elf_Rel* rels, size_t num, uintptr_t offset);
@@ -0,0 +1,96 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "reloc_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "relative_relocs.h"
+
+RelocationTable::~RelocationTable() {
+    if (spill_) fclose(spill_);
+}
+
+void RelocationTable::push_back(const Elf_Rel& rel) {
+    if (max_resident_ && resident_.size() >= max_resident_) Spill();
+    resident_.push_back(rel);
+}
+
+void RelocationTable::AppendRebased(const Elf_Rel* rels, size_t num, uintptr_t offset) {
+    while (num > 0) {
+        if (max_resident_ && resident_.size() >= max_resident_) Spill();
+        const size_t n = max_resident_ ? std::min(num, max_resident_ - resident_.size()) : num;
+        const size_t start = resident_.size();
+        resident_.insert(resident_.end(), rels, rels + n);
+        RebaseRelatives(&resident_[start], n, offset);
+        rels += n;
+        num -= n;
+    }
+}
+
+void RelocationTable::Spill() {
+    if (!spill_) {
+        spill_ = tmpfile();
+        CHECK(spill_) << "Cannot create a temporary file: " << strerror(errno);
+    }
+    WriteBuf(spill_, resident_.data(), resident_.size() * sizeof(Elf_Rel));
+    num_spilled_ += resident_.size();
+    LOG(INFO) << "Spilled " << resident_.size() << " relocations, " << num_spilled_ << " in total";
+    // Keep the capacity to reuse it for the next entries.
+    resident_.clear();
+}
+
+void RelocationTable::RemapSymbols(const std::vector<uintptr_t>& old_to_new) {
+    auto remap = [&old_to_new](Elf_Rel* rels, size_t num) {
+        for (size_t i = 0; i < num; i++) {
+            const uintptr_t index = ELF_R_SYM(rels[i].r_info);
+            CHECK_LT(index, old_to_new.size());
+            rels[i].r_info = ELF_R_INFO(old_to_new[index], ELF_R_TYPE(rels[i].r_info));
+        }
+    };
+
+    if (spill_) {
+        // Rewrite the spilled entries in place.
+        std::vector<Elf_Rel> buf(1 << 15);
+        for (size_t done = 0; done < num_spilled_;) {
+            const size_t n = std::min(buf.size(), num_spilled_ - done);
+            CHECK(fseek(spill_, done * sizeof(Elf_Rel), SEEK_SET) == 0);
+            CHECK(fread(buf.data(), sizeof(Elf_Rel), n, spill_) == n) << "Cannot read spilled relocations: " << strerror(errno);
+            remap(buf.data(), n);
+            CHECK(fseek(spill_, done * sizeof(Elf_Rel), SEEK_SET) == 0);
+            WriteBuf(spill_, buf.data(), n * sizeof(Elf_Rel));
+            done += n;
+        }
+        CHECK(fseek(spill_, 0, SEEK_END) == 0);
+    }
+    remap(resident_.data(), resident_.size());
+}
+
+void RelocationTable::Emit(FILE* fp) {
+    if (spill_) {
+        CHECK(fflush(spill_) == 0);
+        rewind(spill_);
+        std::vector<char> buf(1 << 20);
+        size_t remaining = num_spilled_ * sizeof(Elf_Rel);
+        while (remaining > 0) {
+            const size_t n = fread(buf.data(), 1, std::min(buf.size(), remaining), spill_);
+            CHECK(n > 0) << "Cannot read spilled relocations: " << strerror(errno);
+            WriteBuf(fp, buf.data(), n);
+            remaining -= n;
+        }
+    }
+    WriteBuf(fp, resident_.data(), resident_.size() * sizeof(Elf_Rel));
+}
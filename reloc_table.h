@@ -0,0 +1,59 @@
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "utils.h"
+
+// RelocationTable holds relocation entries of the output in the order they
+// are added. When more than `max_resident` entries are added, they are
+// spilled to a temporary file so that the memory usage is bounded.
+class RelocationTable {
+public:
+    RelocationTable() {}
+    ~RelocationTable();
+
+    // 0 means no limit.
+    void SetMaxResident(size_t max_resident) { max_resident_ = max_resident; }
+
+    // reserve allocates room for `n` entries so that push_back does not
+    // allocate. At most max_resident entries are reserved.
+    void reserve(size_t n) { resident_.reserve(max_resident_ ? std::min(n, max_resident_) : n); }
+
+    void push_back(const Elf_Rel& rel);
+
+    // AppendRebased adds RELATIVE relocations with r_offset and r_addend
+    // moved by `offset`.
+    void AppendRebased(const Elf_Rel* rels, size_t num, uintptr_t offset);
+
+    size_t size() const { return num_spilled_ + resident_.size(); }
+
+    // RemapSymbols replaces symbol index i in all entries with old_to_new[i].
+    void RemapSymbols(const std::vector<uintptr_t>& old_to_new);
+
+    void Emit(FILE* fp);
+
+private:
+    void Spill();
+
+    std::vector<Elf_Rel> resident_;
+    size_t max_resident_{0};
+    FILE* spill_{nullptr};
+    size_t num_spilled_{0};
+};
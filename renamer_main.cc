@@ -15,6 +15,7 @@
 
 #include <getopt.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -79,14 +80,13 @@ void Rename(std::unique_ptr<ELFBinary> bin, std::string outfile, std::map<std::s
     }
 
     // Collect all names from symbols and rename them
-    std::set<int> sym_indecies = bin->CollectSymbolsFromDynamic();
+    const std::vector<bool> sym_marks = bin->CollectSymbolsFromDynamic();
 
     // Check we collect all symbols
-    CHECK_EQ(*sym_indecies.begin(), 0);
-    CHECK_EQ(*sym_indecies.rbegin() + 1, sym_indecies.size());
+    CHECK(std::all_of(sym_marks.begin(), sym_marks.end(), [](bool m) { return m; }));
 
     std::vector<std::string> sym_names;
-    for (int i : sym_indecies) {
+    for (size_t i = 0; i < sym_marks.size(); ++i) {
         Elf_Sym* s = bin->symtab_mut() + i;
         std::string n = bin->Str(s->st_name);
         strtab_builder.Add(n);
@@ -125,7 +125,7 @@ void Rename(std::unique_ptr<ELFBinary> bin, std::string outfile, std::map<std::s
     }
 
     // Rewrite strings in version information
-    for (int index : sym_indecies) {
+    for (size_t index = 0; index < sym_marks.size(); ++index) {
         if (bin->verneed() && bin->versym() && !is_special_ver_ndx(bin->versym()[index])) {
             Elf_Verneed* vn = bin->verneed_mut();
             for (int i = 0; i < bin->verneednum(); ++i) {
@@ -237,11 +237,14 @@ void Rename(std::unique_ptr<ELFBinary> bin, std::string outfile, std::map<std::s
     Elf_Addr bloom_filter = -1;
     Write(fp, bloom_filter);
     // If there is no symbols in gnu_hash, bucket must be 0.
-    uint32_t bucket = (sym_indecies.size() > gnu_hash.symndx) ? gnu_hash.symndx : 0;
+    uint32_t bucket = (sym_marks.size() > gnu_hash.symndx) ? gnu_hash.symndx : 0;
     Write(fp, bucket);
 
+    std::vector<std::string_view> hashed_names(sym_names.begin() + std::min<size_t>(gnu_hash.symndx, sym_names.size()), sym_names.end());
+    std::vector<uint32_t> hashes(hashed_names.size());
+    CalcGnuHashes(hashed_names.data(), hashed_names.size(), hashes.data());
     for (size_t i = gnu_hash.symndx; i < sym_names.size(); ++i) {
-        uint32_t h = CalcGnuHash(sym_names[i]) & ~1;
+        uint32_t h = hashes[i - gnu_hash.symndx] & ~1;
         if (i == sym_names.size() - 1) {
             h |= 1;
         }
@@ -311,6 +314,6 @@ int main(int argc, char* argv[]) {
         mapping = ReadMappingFile(rename_mapping_file);
     }
 
-    auto main_binary = ReadELF(input);
+    auto main_binary = ReadELF(input, nullptr, /*writable=*/true);
     Rename(std::move(main_binary), output, mapping, PhdrInsertStrategyFromString(phdr_insert_strategy));
 }
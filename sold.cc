@@ -15,21 +15,38 @@
 
 #include "sold.h"
 
+#include <unistd.h>
+
 #include <algorithm>
 #include <list>
 #include <queue>
 #include <set>
 
 Sold::Sold(const std::string& elf_filename, const std::vector<std::string>& exclude_sos, const std::vector<std::string>& exclude_finis,
-           const std::vector<std::string> custome_library_path, bool emit_section_header)
-    : exclude_sos_(exclude_sos),
+           const std::vector<std::string> custome_library_path, bool emit_section_header, LibraryPool* pool)
+    : Sold(ReadELF(elf_filename, pool ? pool->metadata_cache() : nullptr), exclude_sos, exclude_finis, custome_library_path,
+           GetLdLibraryPathsFromEnv(), Resolver(), emit_section_header, pool) {}
+
+Sold::Sold(std::unique_ptr<ELFBinary> main_binary, const std::vector<std::string>& exclude_sos, const std::vector<std::string>& exclude_finis,
+           const std::vector<std::string> custome_library_path, const std::vector<std::string>& ld_library_paths, const Resolver& resolver,
+           bool emit_section_header, LibraryPool* pool)
+    : main_binary_(std::move(main_binary)),
+      pool_(pool),
+      ld_library_paths_(ld_library_paths),
+      exclude_sos_(exclude_sos),
       exclude_finis_(exclude_finis),
       custome_library_path_(custome_library_path),
+      resolver_(resolver),
       emit_section_header_(emit_section_header) {
-    main_binary_ = ReadELF(elf_filename);
+    if (!pool_) {
+        own_pool_.reset(new LibraryPool());
+        pool_ = own_pool_.get();
+    }
+    CHECK(main_binary_) << "sold supports only 64bit ELF.";
     is_executable_ = main_binary_->FindPhdr(PT_INTERP);
     machine_type = main_binary_->ehdr()->e_machine;
     memprotect_builder_.SetMachineType(machine_type);
+    strtab_.SetMergeTails(true);
 
     // Register (filename, soname) of main_binary_
     if (main_binary_->name() != "" && main_binary_->soname() != "") {
@@ -41,21 +58,89 @@ Sold::Sold(const std::string& elf_filename, const std::vector<std::string>& excl
         LOG(WARNING) << "Empty filename or soname: " << SOLD_LOG_KEY(main_binary_->name()) << SOLD_LOG_KEY(main_binary_->soname());
     }
 
-    InitLdLibraryPaths();
     ResolveLibraryPaths(main_binary_.get());
 
     version_.SetSonameToFilename(soname_to_filename_);
 }
 
+std::string Sold::ClosureDigest() const {
+    // Two 64bit hashes with different seeds to make collisions unlikely.
+    uint64_t h[2] = {0, 0x9e3779b97f4a7c15ULL};
+    auto add = [&h](const void* p, size_t size) {
+        for (uint64_t& v : h) v = HashBytes(p, size, v);
+    };
+    // Strings include the trailing NUL as a separator.
+    auto add_str = [&add](const std::string& s) { add(s.c_str(), s.size() + 1); };
+    auto add_strs = [&add_str](const char* name, const std::vector<std::string>& strs) {
+        add_str(name);
+        for (const std::string& s : strs) add_str(s);
+    };
+    auto add_binary = [&add, &add_str, &add_strs](const ELFBinary* bin) {
+        add_str(bin->filename());
+        if (bin->has_contents()) {
+            for (const Range& r : bin->mapped_ranges()) add(bin->head() + r.start, r.size());
+        } else {
+            // Only names of excluded libraries affect the output.
+            add_str(bin->soname());
+            add_strs("needed", bin->neededs());
+            add_str(bin->runpath());
+            add_str(bin->rpath());
+        }
+    };
+
+    add_binary(main_binary_.get());
+    for (const auto& p : libraries_) {
+        add_str(p.first);
+        add_binary(p.second);
+    }
+    add_strs("exclude-so", exclude_sos_);
+    add_strs("exclude-from-fini", exclude_finis_);
+    add_strs("custom-library-path", custome_library_path_);
+    add_str(emit_section_header_ ? "section-headers" : "");
+    add_str(stable_layout_ ? "stable-layout" : "");
+    return HexString(h[0]).substr(2) + HexString(h[1]).substr(2);
+}
+
 void Sold::Link(const std::string& out_filename) {
+    if (incremental_) {
+        prev_layout_.reset(new LayoutState());
+        if (!prev_layout_->Read(LayoutStateFilename(out_filename))) {
+            LOG(INFO) << "No layout to reuse for " << out_filename;
+            prev_layout_.reset();
+        }
+    }
+
+    Build();
+
+    if (incremental_) DecideUnchangedBinaries(out_filename);
+    Emit(out_filename);
+    CHECK(chmod(out_filename.c_str(), 0755) == 0);
+    if (incremental_) WriteLayoutState(out_filename);
+}
+
+void Sold::Link(FILE* fp) {
+    CHECK(!incremental_) << "Incremental links require an output filename.";
+    Build();
+    Emit(fp);
+}
+
+void Sold::Build() {
+    // A budget too small for one relocation still spills, as 0 means no limit.
+    if (memory_budget_) rels_.SetMaxResident(std::max<size_t>(memory_budget_ / 4 / sizeof(Elf_Rel), 1));
+    CHECK(!incremental_ || !stable_layout_) << "Incremental links cannot use the stable layout.";
+
+    PlanInputs();
     DecideMemOffset();
 
     CollectTLS();
     CollectArrays();
     CollectSymbols();
     CopyPublicSymbols();
+    // Only the global symbol index in syms_ is used after this.
+    bin_to_syms_.clear();
     Relocate();
 
+    if (stable_layout_) rels_.RemapSymbols(syms_.Sort());
     syms_.Build(strtab_, version_);
     syms_.MergePublicSymbols(strtab_, version_);
 
@@ -64,10 +149,12 @@ void Sold::Link(const std::string& out_filename) {
         BuildInterp();
     }
     BuildArrays();
+    PlanTables();
     BuildDynamic();
     BuildMprotect();
 
     strtab_.Freeze();
+    TranslateStrtabOffsets();
     BuildLoads();
     BuildEHFrameHeader();
 
@@ -88,14 +175,23 @@ void Sold::Link(const std::string& out_filename) {
 
     // We must call BuildEhdr at the last because of e_shoff
     BuildEhdr();
-
-    Emit(out_filename);
-    CHECK(chmod(out_filename.c_str(), 0755) == 0);
 }
 
 void Sold::Emit(const std::string& out_filename) {
-    FILE* fp = fopen(out_filename.c_str(), "wb");
-    CHECK(fp);
+    // Overwrite the output in place to keep the unchanged segments.
+    const bool in_place = !unchanged_binaries_.empty();
+    FILE* fp = fopen(out_filename.c_str(), in_place ? "r+b" : "wb");
+    CHECK(fp) << out_filename << ": " << strerror(errno);
+    Emit(fp);
+    if (in_place) {
+        CHECK(fflush(fp) == 0);
+        CHECK(ftruncate(fileno(fp), ftell(fp)) == 0) << out_filename << ": " << strerror(errno);
+    }
+    fclose(fp);
+}
+
+void Sold::Emit(FILE* fp) {
+    CHECK(plan_.frozen);
     Write(fp, ehdr_);
     EmitPhdrs(fp);
     EmitArrays(fp);
@@ -115,8 +211,54 @@ void Sold::Emit(const std::string& out_filename) {
     EmitMemprotect(fp);
 
     if (emit_section_header_) EmitShdr(fp);
+}
 
-    fclose(fp);
+bool Sold::LoadsFitIn(const LayoutState& layout) {
+    for (size_t i = 0; i < link_binaries_.size(); i++) {
+        const std::vector<Elf_Phdr*>& loads = link_binaries_[i]->loads();
+        const std::vector<Range>& slots = layout.binaries[i].load_slots;
+        if (loads.size() != slots.size()) return false;
+        for (size_t j = 0; j < loads.size(); j++) {
+            const Range& slot = slots[j];
+            if (slot.end < slot.start || (loads[j]->p_vaddr & 0xfff) + loads[j]->p_filesz > slot.end - slot.start) return false;
+        }
+    }
+    return true;
+}
+
+// DecideUnchangedBinaries finds binaries whose segments can be kept in the
+// output. The output must not be modified since the last incremental link.
+void Sold::DecideUnchangedBinaries(const std::string& out_filename) {
+    FileIdentity output;
+    if (!prev_layout_ || !GetFileIdentity(out_filename, &output) || output != prev_layout_->output) return;
+
+    for (size_t i = 0; i < link_binaries_.size(); i++) {
+        ELFBinary* bin = link_binaries_[i];
+        const LayoutState::Binary& prev = prev_layout_->binaries[i];
+        FileIdentity identity;
+        if (GetFileIdentity(bin->filename(), &identity) && identity == prev.identity && overlays_[bin].Digest() == prev.overlay_digest) {
+            LOG(INFO) << "Reuse the segments of " << bin->name();
+            unchanged_binaries_.insert(bin);
+        }
+    }
+}
+
+void Sold::WriteLayoutState(const std::string& out_filename) {
+    LayoutState layout;
+    layout.code_offset = CodeOffset();
+    CHECK(GetFileIdentity(out_filename, &layout.output));
+    for (ELFBinary* bin : link_binaries_) {
+        LayoutState::Binary b;
+        b.filename = bin->filename();
+        CHECK(GetFileIdentity(b.filename, &b.identity));
+        b.overlay_digest = overlays_[bin].Digest();
+        b.mem_slot = mem_slots_[bin];
+        for (const Load& load : loads_) {
+            if (load.bin == bin) b.load_slots.push_back(load.slot);
+        }
+        layout.binaries.push_back(b);
+    }
+    layout.Write(LayoutStateFilename(out_filename));
 }
 
 // You must call this function after building all stuffs
@@ -130,20 +272,106 @@ void Sold::BuildEhdr() {
     ehdr_.e_phnum = CountPhdrs();
 }
 
+// PlanInputs counts the sizes which depend only on link_binaries_ in one
+// pass.
+void Sold::PlanInputs() {
+    CHECK(!plan_.frozen);
+    size_t num_loads = 0;
+    size_t num_fdes = 0;
+    size_t num_relros = 0;
+    for (ELFBinary* bin : link_binaries_) {
+        num_loads += bin->loads().size();
+        // Inputs without PT_GNU_EH_FRAME are included, as the table is built
+        // from their .eh_frame.
+        num_fdes += bin->eh_frame_header(validate_eh_frame_)->fde_count;
+        for (Elf_Phdr* phdr : bin->phdrs()) {
+            if (phdr->p_type == PT_TLS) {
+                plan_.tls_filesz += phdr->p_filesz;
+                plan_.tls_memsz += phdr->p_memsz;
+            } else if (phdr->p_type == PT_GNU_RELRO) {
+                num_relros++;
+            }
+        }
+    }
+
+    // DYNAMIC and its LOAD.
+    plan_.num_phdrs = 2;
+    // INTERP and PHDR.
+    if (is_executable_) plan_.num_phdrs += 2;
+    // TLS and its LOAD.
+    if (plan_.tls_memsz) plan_.num_phdrs += 2;
+    // PT_GNU_EH_FRAME and its PT_LOAD
+    plan_.num_phdrs += 2;
+    // GNU_STACK
+    plan_.num_phdrs++;
+    // PT_LOAD of the mprotect code
+    plan_.num_phdrs++;
+    // Normal PT_LOAD
+    plan_.num_phdrs += num_loads;
+
+    plan_.ehframe_size = EHFrameBuilder::SizeFor(num_fdes);
+
+    plan_.mprotect_size = memprotect_builder_.CodeSize(num_relros);
+
+    plan_.init_array.start = plan_.init_array.end = AlignNext(sizeof(Elf_Ehdr) + sizeof(Elf_Phdr) * plan_.num_phdrs, 7);
+}
+
+// PlanTables places the tables from .gnu.hash up to .dynstr. The sizes of
+// them must be fixed. The arrays before them are placed by CollectArrays.
+void Sold::PlanTables() {
+    CHECK(!plan_.frozen);
+    plan_.gnu_hash = After(plan_.fini_array, syms_.GnuHashSize());
+    plan_.symtab = After(plan_.gnu_hash, syms_.size() * sizeof(Elf_Sym));
+    plan_.versym = After(plan_.symtab, version_.SizeVersym());
+    plan_.verneed = After(plan_.versym, version_.SizeVerneed());
+    plan_.rel = After(plan_.verneed, rels_.size() * sizeof(Elf_Rel));
+    // The size of .dynstr is fixed in BuildLoads.
+    plan_.strtab = After(plan_.rel, 0);
+}
+
 void Sold::BuildLoads() {
+    CHECK(!plan_.frozen);
+    plan_.strtab.end = plan_.strtab.start + strtab_.size();
+    plan_.dynamic = After(plan_.strtab, sizeof(Elf_Dyn) * dynamic_.size());
+    plan_.shstrtab = After(plan_.dynamic, shdr_.ShstrtabSize());
+
+    const uintptr_t code_offset = AlignNext(plan_.shstrtab.end);
+    uintptr_t reserved_code_offset = 0;
+    if (incremental_) {
+        if (prev_layout_ && (code_offset > prev_layout_->code_offset || !LoadsFitIn(*prev_layout_))) {
+            LOG(INFO) << "The segments do not fit in the previous layout";
+            prev_layout_.reset();
+        }
+        reserved_code_offset = prev_layout_ ? prev_layout_->code_offset : AddSlack(0, code_offset);
+    }
+    if (stable_layout_) reserved_code_offset = StableFileSlotSize(code_offset);
+    plan_.code_offset = std::max(code_offset, reserved_code_offset);
+
     uintptr_t file_offset = CodeOffset();
     CHECK(file_offset < offsets_[main_binary_.get()]);
-    for (ELFBinary* bin : link_binaries_) {
+    CHECK(!EHFrameBeforeInputs() || file_offset <= ehframe_offset_) << "No room for .eh_frame_hdr before the inputs";
+    // Note layout_order_ is link_binaries_ in incremental links.
+    for (size_t i = 0; i < layout_order_.size(); i++) {
+        ELFBinary* bin = layout_order_[i];
         uintptr_t offset = offsets_[bin];
-        for (Elf_Phdr* phdr : bin->loads()) {
+        for (size_t j = 0; j < bin->loads().size(); j++) {
+            Elf_Phdr* phdr = bin->loads()[j];
             Load load;
             load.bin = bin;
             load.orig = phdr;
             load.emit = *phdr;
 
+            if (incremental_) {
+                const uintptr_t end = file_offset + (phdr->p_vaddr & 0xfff) + phdr->p_filesz;
+                load.slot = prev_layout_ ? prev_layout_->binaries[i].load_slots[j] : Range{file_offset, AddSlack(file_offset, end)};
+                CHECK_EQ(load.slot.start, file_offset);
+            }
+            if (stable_layout_) {
+                load.slot = Range{file_offset, file_offset + StableFileSlotSize((phdr->p_vaddr & 0xfff) + phdr->p_filesz)};
+            }
             file_offset += phdr->p_vaddr & 0xfff;
             load.emit.p_offset = file_offset;
-            file_offset = AlignNext(file_offset + phdr->p_filesz);
+            file_offset = (incremental_ || stable_layout_) ? load.slot.end : AlignNext(file_offset + phdr->p_filesz);
             load.emit.p_vaddr += offset;
             load.emit.p_paddr += offset;
             // TODO(hamaji): Add PF_W only for GOT.
@@ -155,11 +383,11 @@ void Sold::BuildLoads() {
             loads_.push_back(load);
         }
     }
-    tls_file_offset_ = file_offset;
-    file_offset = AlignNext(file_offset + TLSFileSize());
-    ehframe_file_offset_ = file_offset;
-    file_offset = AlignNext(file_offset + EHFrameSize());
-    mprotect_file_offset_ = file_offset;
+    plan_.tls = Range{file_offset, file_offset + TLSFileSize()};
+    plan_.ehframe = Range{AlignNext(plan_.tls.end), AlignNext(plan_.tls.end) + EHFrameSize()};
+    plan_.mprotect = Range{AlignNext(plan_.ehframe.end), AlignNext(plan_.ehframe.end) + MprotectSize()};
+    plan_.shdr_offset = plan_.mprotect.end;
+    plan_.frozen = true;
 
     for (const Load& load : loads_) {
         LOG(INFO) << "PT_LOAD mapping: name=" << load.bin->name() << " vaddr=" << load.emit.p_vaddr << " memsz=" << load.emit.p_memsz
@@ -176,23 +404,17 @@ void Sold::BuildArrays() {
     // mprotect_offset_.
     CHECK_GE(init_array_.size(), 1);
     Elf_Rel mprotect_rel;
-    if (machine_type == EM_X86_64) {
-        mprotect_rel.r_info = ELF_R_INFO(0, R_X86_64_RELATIVE);
-    } else if (machine_type == EM_AARCH64) {
-        mprotect_rel.r_info = ELF_R_INFO(0, R_AARCH64_RELATIVE);
-    } else {
-        CHECK(false);
-    }
+    WithArch(machine_type, [&mprotect_rel](auto arch) { mprotect_rel.r_info = ELF_R_INFO(0, decltype(arch)::kRelative); });
     mprotect_rel.r_offset = InitArrayOffset();
     mprotect_rel.r_addend = array[0];
-    rels_.emplace_back(mprotect_rel);
+    rels_.push_back(mprotect_rel);
 }
 
 void Sold::BuildDynamic() {
     std::set<ELFBinary*> linked(link_binaries_.begin(), link_binaries_.end());
     std::set<std::string> neededs;
     for (const auto& p : libraries_) {
-        ELFBinary* bin = p.second.get();
+        ELFBinary* bin = p.second;
         if (!linked.count(bin)) {
             neededs.insert(bin->name());
         }
@@ -279,13 +501,31 @@ void Sold::EmitPhdrs(FILE* fp) {
         phdrs.push_back(phdr);
     }
 
+    // PT_LOADs must be sorted by their addresses.
+    auto push_ehframe = [this, &phdrs]() {
+        Elf_Phdr phdr;
+        phdr.p_offset = EHFrameOffset();
+        phdr.p_vaddr = ehframe_offset_;
+        phdr.p_paddr = ehframe_offset_;
+        phdr.p_filesz = ehframe_builder_.Size();
+        phdr.p_memsz = ehframe_builder_.Size();
+        phdr.p_align = 0x1000;
+        phdr.p_type = PT_GNU_EH_FRAME;
+        phdr.p_flags = PF_R;
+        phdrs.push_back(phdr);
+        phdr.p_type = PT_LOAD;
+        phdr.p_flags = PF_R | PF_W;
+        phdrs.push_back(phdr);
+    };
+    if (EHFrameBeforeInputs()) push_ehframe();
+
     for (const Load& load : loads_) {
         phdrs.push_back(load.emit);
     }
 
     if (tls_.memsz) {
         Elf_Phdr phdr;
-        phdr.p_offset = tls_file_offset_;
+        phdr.p_offset = TLSOffset();
         phdr.p_vaddr = tls_offset_;
         phdr.p_paddr = tls_offset_;
         phdr.p_filesz = tls_.filesz;
@@ -298,24 +538,10 @@ void Sold::EmitPhdrs(FILE* fp) {
         phdr.p_flags = PF_R | PF_W;
         phdrs.push_back(phdr);
     }
+    if (!EHFrameBeforeInputs()) push_ehframe();
     {
         Elf_Phdr phdr;
-        phdr.p_offset = ehframe_file_offset_;
-        phdr.p_vaddr = ehframe_offset_;
-        phdr.p_paddr = ehframe_offset_;
-        phdr.p_filesz = ehframe_builder_.Size();
-        phdr.p_memsz = ehframe_builder_.Size();
-        phdr.p_align = 0x1000;
-        phdr.p_type = PT_GNU_EH_FRAME;
-        phdr.p_flags = PF_R;
-        phdrs.push_back(phdr);
-        phdr.p_type = PT_LOAD;
-        phdr.p_flags = PF_R | PF_W;
-        phdrs.push_back(phdr);
-    }
-    {
-        Elf_Phdr phdr;
-        phdr.p_offset = mprotect_file_offset_;
+        phdr.p_offset = MemprotectOffset();
         phdr.p_vaddr = mprotect_offset_;
         phdr.p_paddr = mprotect_offset_;
         phdr.p_filesz = MprotectSize();
@@ -365,7 +591,7 @@ void Sold::EmitGnuHash(FILE* fp) {
     Write(fp, bucket);
 
     for (size_t i = gnu_hash.symndx; i < exposed_syms.size(); ++i) {
-        uint32_t h = CalcGnuHash(exposed_syms[i].name) & ~1;
+        uint32_t h = exposed_syms[i].gnu_hash;
         if (i == exposed_syms.size() - 1) {
             h |= 1;
         }
@@ -373,38 +599,115 @@ void Sold::EmitGnuHash(FILE* fp) {
     }
 }
 
-uintptr_t Sold::TLSMemSize() const {
-    static uintptr_t s = 0;
-    if (s != 0) return s;
-    for (ELFBinary* bin : link_binaries_) {
-        for (Elf_Phdr* phdr : bin->phdrs()) {
-            if (phdr->p_type == PT_TLS) {
-                s += phdr->p_memsz;
-            }
-        }
-    }
-    return s;
-}
-
 // Decide locations for each linked shared objects
 // TODO(akawashiro) Is the initial value of offset optimal?
 void Sold::DecideMemOffset() {
+    // The previous layout is reused only when the same binaries are linked
+    // and all of them fit in their slots.
+    if (prev_layout_) {
+        bool fit = prev_layout_->binaries.size() == link_binaries_.size();
+        for (size_t i = 0; fit && i < link_binaries_.size(); i++) {
+            const LayoutState::Binary& prev = prev_layout_->binaries[i];
+            fit = prev.filename == link_binaries_[i]->filename() && link_binaries_[i]->GetRange().size() <= prev.mem_slot.size();
+        }
+        if (!fit) {
+            LOG(INFO) << "The binaries do not fit in the previous layout";
+            prev_layout_.reset();
+        }
+    }
+
     uintptr_t offset = 0x10000000;
-    for (ELFBinary* bin : link_binaries_) {
+    layout_order_ = link_binaries_;
+    if (stable_layout_) offset = DecideStableMemOffset();
+    for (size_t i = 0; i < link_binaries_.size() && !stable_layout_; i++) {
+        ELFBinary* bin = link_binaries_[i];
         const Range range = bin->GetRange() + offset;
         CHECK(range.start == offset) << "sold cannot handle other than shared objects.";
         offsets_.emplace(bin, range.start);
         LOG(INFO) << "Assigned: " << bin->soname() << " " << HexString(range.start, 8) << "-" << HexString(range.end, 8);
         offset = range.end;
+        if (incremental_) {
+            const Range slot = prev_layout_ ? prev_layout_->binaries[i].mem_slot : Range{range.start, AddSlack(range.start, range.end)};
+            CHECK_EQ(slot.start, range.start);
+            mem_slots_[bin] = slot;
+            offset = slot.end;
+        }
     }
     tls_offset_ = offset;
     offset = AlignNext(offset + TLSMemSize());
+    // Entries of .eh_frame_hdr are 32 bit offsets from it. It is placed
+    // after the inputs, or before them when FDEs are more than 2GiB away
+    // from there, e.g., because of a huge .bss.
+    auto fits = [this](uintptr_t ehframe_offset) {
+        return std::all_of(link_binaries_.begin(), link_binaries_.end(), [this, ehframe_offset](ELFBinary* bin) {
+            const EHFrameHeader& efh = *bin->eh_frame_header();
+            return EHFrameBuilder::Fits(efh, efh.table_base, offsets_[bin], ehframe_offset);
+        });
+    };
     ehframe_offset_ = offset;
-    offset = AlignNext(offset + EHFrameSize());
+    if (fits(ehframe_offset_)) {
+        offset = AlignNext(offset + EHFrameSize());
+    } else {
+        uintptr_t lowest = offset;
+        for (const auto& p : offsets_) lowest = std::min(lowest, p.second);
+        ehframe_offset_ = (lowest - EHFrameSize()) & ~(LINUX_PAGE_SIZE - 1);
+        LOG(INFO) << "Place .eh_frame_hdr before the inputs at " << HexString(ehframe_offset_);
+        CHECK(fits(ehframe_offset_)) << "FDEs of the inputs span more than 2GiB, which .eh_frame_hdr cannot refer to with 32 bit offsets";
+    }
     mprotect_offset_ = offset;
     offset = AlignNext(offset + MprotectSize());
 }
 
+// DecideStableMemOffset places each binary in a slot of StableMemSlotSize
+// aligned to its size. The first candidate of the slot is derived from the
+// hash of the soname and the next free one is used on collision. Binaries
+// are placed in the order of their sonames so that the result does not
+// depend on the order of DT_NEEDED. Returns the end of the slots.
+uintptr_t Sold::DecideStableMemOffset() {
+    const uintptr_t region_start = 0x10000000;
+    // Keep the output within 2GiB, as .eh_frame_hdr has 32bit offsets.
+    const uintptr_t region_end = 0x50000000;
+
+    std::vector<std::pair<std::string, ELFBinary*>> keys;
+    for (ELFBinary* bin : link_binaries_) {
+        keys.emplace_back(bin->soname().empty() ? bin->name() : bin->soname(), bin);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<Range> used;
+    uintptr_t overflow = region_end;
+    for (const auto& p : keys) {
+        ELFBinary* bin = p.second;
+        const uintptr_t size = bin->GetRange().size();
+        const uintptr_t slot_size = StableMemSlotSize(size);
+        const uintptr_t num_slots = (region_end - region_start) / slot_size;
+        const uint64_t h = HashBytes(p.first.data(), p.first.size());
+
+        uintptr_t start = 0;
+        for (uintptr_t i = 0; i < num_slots && !start; i++) {
+            const uintptr_t candidate = region_start + (h + i) % num_slots * slot_size;
+            const Range slot{candidate, candidate + slot_size};
+            if (std::none_of(used.begin(), used.end(), [&slot](const Range& r) { return r.start < slot.end && slot.start < r.end; })) {
+                start = candidate;
+                used.push_back(slot);
+            }
+        }
+        if (!start) {
+            LOG(WARNING) << "No stable slot for " << bin->name() << ", which is placed after other binaries";
+            start = overflow;
+            overflow = AlignNext(start + slot_size);
+        }
+
+        const Range range = bin->GetRange() + start;
+        CHECK(range.start == start) << "sold cannot handle other than shared objects.";
+        offsets_.emplace(bin, range.start);
+        LOG(INFO) << "Assigned: " << bin->soname() << " " << HexString(range.start, 8) << "-" << HexString(range.end, 8);
+    }
+
+    std::sort(layout_order_.begin(), layout_order_.end(), [this](ELFBinary* a, ELFBinary* b) { return offsets_[a] < offsets_[b]; });
+    return overflow;
+}
+
 void Sold::CollectTLS() {
     uintptr_t bss_offset = 0;
     for (ELFBinary* bin : link_binaries_) {
@@ -443,6 +746,8 @@ void Sold::CollectArrays() {
             init_array_.emplace_back(ptr + offset);
         }
     }
+    plan_.init_array.end = plan_.init_array.start + sizeof(uintptr_t) * init_array_.size();
+    plan_.fini_array = After(plan_.init_array, 0);
     for (ELFBinary* bin : link_binaries_) {
         uintptr_t offset = offsets_[bin];
         if (std::any_of(exclude_finis_.cbegin(), exclude_finis_.cend(), [bin](const auto s) { return HasPrefix(bin->soname(), s); }))
@@ -452,6 +757,7 @@ void Sold::CollectArrays() {
             fini_array_.emplace_back(ptr + offset);
         }
     }
+    plan_.fini_array.end = plan_.fini_array.start + sizeof(uintptr_t) * fini_array_.size();
     LOG(INFO) << "Array numbers: init_array=" << init_array_.size() << " fini_array=" << fini_array_.size();
 }
 
@@ -463,13 +769,14 @@ uintptr_t Sold::RemapTLS(const char* msg, ELFBinary* bin, uintptr_t off) {
     CHECK(found != tls_.bin_to_index.end());
     const TLS::Data& entry = tls_.data[found->second];
     if (off < tls->p_filesz) {
-        LOG(INFO) << "TLS data " << msg << " in " << bin->name() << " remapped " << HexString(off) << " => "
-                  << HexString(off + entry.file_offset);
+        VLOG(1) << "TLS data " << msg << " in " << bin->name() << " remapped " << HexString(off) << " => "
+                << HexString(off + entry.file_offset);
         off += entry.file_offset;
     } else {
-        LOG(INFO) << "TLS bss " << msg << " in " << bin->name() << " remapped " << HexString(off) << " => "
-                  << HexString(off + entry.bss_offset);
-        off += entry.bss_offset;
+        // bss_offset is where [p_filesz, p_memsz) of bin starts.
+        VLOG(1) << "TLS bss " << msg << " in " << bin->name() << " remapped " << HexString(off) << " => "
+                << HexString(off - tls->p_filesz + entry.bss_offset);
+        off += entry.bss_offset - tls->p_filesz;
     }
     return off;
 }
@@ -478,23 +785,28 @@ uintptr_t Sold::RemapTLS(const char* msg, ELFBinary* bin, uintptr_t off) {
 // When the same symbol is already in symtab, LoadDynSymtab selects a more
 // concretely defined one.
 void Sold::LoadDynSymtab(ELFBinary* bin, std::vector<Syminfo>& symtab) {
-    bin->ReadDynSymtab(filename_to_soname_);
+    bin->ReadDynSymtab();
 
     uintptr_t offset = offsets_[bin];
+    std::vector<Syminfo>& relocated = bin_to_syms_[bin];
 
-    for (const auto& p : bin->GetSymbolMap()) {
+    for (Syminfo p : bin->GetSymbolMap(filename_to_soname_)) {
         const std::string& name = p.name;
-        Elf_Sym* sym = p.sym;
+        // Relocate a copy because bin may be shared with other Sold instances.
+        relocated_syms_.push_back(*p.sym);
+        Elf_Sym* sym = p.sym = &relocated_syms_.back();
         if (IsTLS(*sym) && sym->st_shndx != SHN_UNDEF) {
             sym->st_value = RemapTLS("symbol", bin, sym->st_value);
         } else if (sym->st_value) {
             sym->st_value += offset;
         }
         LOG(INFO) << "Symbol " << name << "@" << bin->name() << " " << sym->st_value;
+        relocated.push_back(p);
 
         Syminfo* found = NULL;
         for (int i = 0; i < symtab.size(); i++) {
-            if (symtab[i].name == p.name && symtab[i].soname == p.soname && symtab[i].version == p.version) {
+            if (symtab[i].gnu_hash == p.gnu_hash && symtab[i].name == p.name && symtab[i].soname == p.soname &&
+                symtab[i].version == p.version) {
                 found = &symtab[i];
                 break;
             }
@@ -522,7 +834,7 @@ void Sold::LoadDynSymtab(ELFBinary* bin, std::vector<Syminfo>& symtab) {
 // Push all TLS symbols into public_syms_.
 // TODO(akawashiro) Does public_syms_ overlap with exposed_syms_?
 void Sold::CopyPublicSymbols() {
-    for (const auto& p : main_binary_->GetSymbolMap()) {
+    for (const auto& p : bin_to_syms_[main_binary_.get()]) {
         const Elf_Sym* sym = p.sym;
 
         // TODO(akawashiro) Do we need this IsDefined check?
@@ -535,7 +847,7 @@ void Sold::CopyPublicSymbols() {
     }
     for (ELFBinary* bin : link_binaries_) {
         if (bin == main_binary_.get()) continue;
-        for (const auto& p : bin->GetSymbolMap()) {
+        for (const auto& p : bin_to_syms_[bin]) {
             const Elf_Sym* sym = p.sym;
             if (IsTLS(*sym)) {
                 LOG(INFO) << "Copy TLS symbol " << p.name;
@@ -545,18 +857,11 @@ void Sold::CopyPublicSymbols() {
     }
 }
 
-// Make new relocation table.
-// RelocateSymbol_x86_64 rewrites r_offset of each relocation entries
-// because we decided locations of shared objects in DecideMemOffset.
-void Sold::RelocateSymbol_x86_64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset) {
-    const Elf_Sym* sym = &bin->symtab()[ELF_R_SYM(rel->r_info)];
-    std::string soname, version_name;
-    std::tie(soname, version_name) = bin->GetVersion(ELF_R_SYM(rel->r_info), filename_to_soname_);
-
-    int type = ELF_R_TYPE(rel->r_info);
-    const uintptr_t addend = rel->r_addend;
-    std::vector<Elf_Rel> newrels;
-
+// MapRelocation fills `newrels` with the relocations of the output for
+// `rel` and returns the number of them. A relocation in .init_array or
+// .fini_array is also emitted for the copy of the array at the head.
+size_t Sold::MapRelocation(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset, Elf_Rel* newrels) {
+    size_t n = 0;
     if (bin->IsVaddrInTLSData(rel->r_offset)) {
         Elf_Rel newrel = *rel;
         const Elf_Phdr* tls = bin->tls();
@@ -564,11 +869,11 @@ void Sold::RelocateSymbol_x86_64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t o
         uintptr_t off = newrel.r_offset - tls->p_vaddr;
         off = RemapTLS("reloc", bin, off);
         newrel.r_offset = off + tls_offset_;
-        newrels.emplace_back(newrel);
+        newrels[n++] = newrel;
     } else {
         Elf_Rel newrel = *rel;
         newrel.r_offset += offset;
-        newrels.emplace_back(newrel);
+        newrels[n++] = newrel;
     }
 
     if (bin->IsAddrInInitarray(rel->r_offset)) {
@@ -577,42 +882,108 @@ void Sold::RelocateSymbol_x86_64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t o
 
         newrel.r_offset -= bin->init_array_addr();
         newrel.r_offset += bin_to_init_array_offset_[bin];
-        LOG(INFO) << SOLD_LOG_BITS(bin->init_array_addr()) << SOLD_LOG_BITS(bin_to_init_array_offset_[bin])
-                  << SOLD_LOG_BITS(newrel.r_offset) << SOLD_LOG_BITS(newrel.r_addend) << SOLD_LOG_BITS(offset);
-        newrels.emplace_back(newrel);
+        VLOG(1) << SOLD_LOG_BITS(bin->init_array_addr()) << SOLD_LOG_BITS(bin_to_init_array_offset_[bin])
+                << SOLD_LOG_BITS(newrel.r_offset) << SOLD_LOG_BITS(newrel.r_addend) << SOLD_LOG_BITS(offset);
+        newrels[n++] = newrel;
     } else if (bin->IsAddrInFiniarray(rel->r_offset)) {
         Elf_Rel newrel = *rel;
         CHECK(bin_to_fini_array_offset_.find(bin) != bin_to_fini_array_offset_.end()) << SOLD_LOG_KEY(bin->filename());
 
         newrel.r_offset -= bin->fini_array_addr();
         newrel.r_offset += bin_to_fini_array_offset_[bin];
-        LOG(INFO) << SOLD_LOG_BITS(bin->fini_array_addr()) << SOLD_LOG_BITS(bin_to_fini_array_offset_[bin])
-                  << SOLD_LOG_BITS(newrel.r_offset) << SOLD_LOG_BITS(newrel.r_addend) << SOLD_LOG_BITS(offset);
-        newrels.emplace_back(newrel);
+        VLOG(1) << SOLD_LOG_BITS(bin->fini_array_addr()) << SOLD_LOG_BITS(bin_to_fini_array_offset_[bin])
+                << SOLD_LOG_BITS(newrel.r_offset) << SOLD_LOG_BITS(newrel.r_addend) << SOLD_LOG_BITS(offset);
+        newrels[n++] = newrel;
+    }
+    return n;
+}
+
+bool Sold::ResolveSymbol(ELFBinary* bin, uint32_t index, uintptr_t* val_or_index) {
+    SymbolHandle& handle = sym_handles_[index];
+    if (!handle.resolved) {
+        std::string soname, version_name;
+        std::tie(soname, version_name) = bin->GetVersion(index, filename_to_soname_);
+        handle.defined = syms_.Resolve(bin->Str(bin->symtab()[index].st_name), bin->SymbolGnuHash(index), soname, version_name,
+                                       handle.val_or_index);
+        handle.resolved = true;
+    }
+    *val_or_index = handle.val_or_index;
+    return handle.defined;
+}
+
+uintptr_t Sold::ResolveCopySymbol(ELFBinary* bin, uint32_t index) {
+    SymbolHandle& handle = sym_handles_[index];
+    if (!handle.copy_resolved) {
+        std::string soname, version_name;
+        std::tie(soname, version_name) = bin->GetVersion(index, filename_to_soname_);
+        handle.copy_index = syms_.ResolveCopy(bin->Str(bin->symtab()[index].st_name), bin->SymbolGnuHash(index), soname, version_name);
+        handle.copy_resolved = true;
+    }
+    return handle.copy_index;
+}
+
+void Sold::RelocateSymbols(ELFBinary* bin, const Elf_Rel* rels, size_t num) {
+    if (!rels) CHECK_EQ(0, num);
+    WithArch(bin->ehdr()->e_machine, [&](auto arch) { this->RelocateSymbols<decltype(arch)>(bin, rels, num); });
+}
+
+template <class Arch>
+void Sold::RelocateSymbols(ELFBinary* bin, const Elf_Rel* rels, size_t num) {
+    const uintptr_t offset = offsets_[bin];
+    // RELATIVE relocations in these ranges are remapped by MapRelocation.
+    const Elf_Phdr* tls = bin->tls();
+    const Range ranges[kNumRelativeRanges] = {
+        tls ? Range{tls->p_vaddr, tls->p_vaddr + tls->p_filesz} : Range{0, 0},
+        Range{bin->init_array_addr(), bin->init_array_addr() + bin->init_arraysz()},
+        Range{bin->fini_array_addr(), bin->fini_array_addr() + bin->fini_arraysz()},
+    };
+    for (size_t i = 0; i < num;) {
+        const size_t n = RelativeRunLength(&rels[i], num - i, ELF_R_INFO(0, Arch::kRelative), ranges);
+        if (n) {
+            rels_.AppendRebased(&rels[i], n, offset);
+            i += n;
+        } else {
+            RelocateSymbol<Arch>(bin, &rels[i], offset);
+            i++;
+        }
     }
+}
+
+// Make new relocation table.
+// RelocateSymbol rewrites r_offset of each relocation entries
+// because we decided locations of shared objects in DecideMemOffset.
+template <class Arch>
+void Sold::RelocateSymbol(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset) {
+    const uint32_t sym_index = ELF_R_SYM(rel->r_info);
+    const Elf_Sym* sym = &bin->symtab()[sym_index];
+    const uint32_t type = ELF_R_TYPE(rel->r_info);
 
-    LOG(INFO) << "Relocate " << bin->Str(sym->st_name) << " at " << rel->r_offset;
+    Elf_Rel newrels[2];
+    const size_t num_newrels = MapRelocation(bin, rel, offset, newrels);
 
-    for (auto newrel : newrels) {
+    VLOG(1) << "Relocate " << bin->Str(sym->st_name) << " at " << rel->r_offset;
+
+    for (size_t i = 0; i < num_newrels; i++) {
+        Elf_Rel newrel = newrels[i];
         // Even if we found a defined symbol in src_syms_, we cannot
         // erase the relocation entry. The address needs to be fixed at
         // runtime by ASLR function so we set RELATIVE to these resolved symbols.
         switch (type) {
-            case R_X86_64_RELATIVE: {
+            case Arch::kRelative:
+            case Arch::kIRelative: {
                 if (IsDefined(*sym)) {
-                    LOG(WARNING)
-                        << "The symbol associated with R_X86_64_RELATIVE is defined. Because this relocation type doesn't need any "
-                           "symbol, something wrong may have happened.";
+                    LOG(WARNING) << "The symbol associated with " << ShowRelocationType(type)
+                                 << " is defined. Because this relocation type doesn't need any symbol, something wrong may have happened.";
                 }
                 newrel.r_addend += offset;
                 break;
             }
 
-            case R_X86_64_GLOB_DAT:
-            case R_X86_64_JUMP_SLOT: {
+            case Arch::kGlobDat:
+            case Arch::kJumpSlot: {
                 uintptr_t val_or_index;
-                if (syms_.Resolve(bin->Str(sym->st_name), soname, version_name, val_or_index)) {
-                    newrel.r_info = ELF_R_INFO(0, R_X86_64_RELATIVE);
+                if (ResolveSymbol(bin, sym_index, &val_or_index)) {
+                    newrel.r_info = ELF_R_INFO(0, Arch::kRelative);
                     newrel.r_addend = val_or_index;
                 } else {
                     newrel.r_info = ELF_R_INFO(val_or_index, type);
@@ -620,10 +991,10 @@ void Sold::RelocateSymbol_x86_64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t o
                 break;
             }
 
-            case R_X86_64_64: {
+            case Arch::kAbsolute: {
                 uintptr_t val_or_index;
-                if (syms_.Resolve(bin->Str(sym->st_name), soname, version_name, val_or_index)) {
-                    newrel.r_info = ELF_R_INFO(0, R_X86_64_RELATIVE);
+                if (ResolveSymbol(bin, sym_index, &val_or_index)) {
+                    newrel.r_info = ELF_R_INFO(0, Arch::kRelative);
                     newrel.r_addend += val_or_index;
                 } else {
                     newrel.r_info = ELF_R_INFO(val_or_index, type);
@@ -632,21 +1003,23 @@ void Sold::RelocateSymbol_x86_64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t o
             }
 
             // TODO(akawashiro) Handle TLS variables in executables.
-            case R_X86_64_DTPMOD64: {
-                // TODO(akawashiro) Refactor out for Arch64
-                const std::string name = bin->Str(sym->st_name);
-                uintptr_t index = syms_.ResolveCopy(name, soname, version_name);
+            case Arch::kTLSModule: {
+                CHECK(Arch::kTraditionalTLS) << ShowRelocationType(type) << " is not supported.";
+                uintptr_t index = ResolveCopySymbol(bin, sym_index);
                 newrel.r_info = ELF_R_INFO(index, type);
 
                 if (bin->tls() == NULL) {
-                    LOG(INFO) << SOLD_LOG_64BITS(bin->tls()) << " is null. This relocation is TLS generic dynamic model.";
+                    VLOG(1) << SOLD_LOG_64BITS(bin->tls()) << " is null. This relocation is TLS generic dynamic model.";
                     break;
                 }
 
-                uint64_t* mod_on_got =
-                    reinterpret_cast<uint64_t*>(bin->head_mut() + bin->OffsetFromAddr(rel->r_offset));
-                uint64_t* offset_on_got = mod_on_got + 1;
-                const bool is_bss = bin->IsOffsetInTLSBSS(*offset_on_got);
+                // ti_offset is patched via overlays_ because bin is read-only.
+                Overlay& overlay = overlays_[bin];
+                const uintptr_t mod_file_offset = bin->OffsetFromAddr(rel->r_offset);
+                const uintptr_t offset_file_offset = mod_file_offset + sizeof(uint64_t);
+                const uint64_t mod_on_got = overlay.Get<uint64_t>(bin->head(), mod_file_offset);
+                uint64_t offset_on_got = overlay.Get<uint64_t>(bin->head(), offset_file_offset);
+                const bool is_bss = bin->IsOffsetInTLSBSS(offset_on_got);
 
                 // We assume dl_tls_index exists in GOT. This struct is used as
                 // the argument of __tls_get_addr.
@@ -658,199 +1031,94 @@ void Sold::RelocateSymbol_x86_64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t o
                 // } tls_index;
                 //
                 // In TLS generic dynamic model, both ti_module and ti_offset are
-                // rewritten by R_X86_64_DTPMOD64 and R_X86_64_DTPOFF64,
-                // respectively.
+                // rewritten by DTPMOD and DTPOFF relocations (R_X86_64_DTPMOD64
+                // and R_X86_64_DTPOFF64 on x86-64), respectively.
                 //
                 // In TLS local dynamic model, the only ti_module is rewrite by
-                // R_X86_64_DTPMOD64 and ti_offset is fixed in the link process. We
+                // the DTPMOD relocation and ti_offset is fixed in the link process. We
                 // must rewrite the fixed ti_offset because we remap the TLS
                 // template.
 
-                std::vector<int> rewrite_rel_types;  // Type of relocations which rewrite ti_module.
-                for (size_t i = 0; i < bin->num_rels(); ++i) {
-                    if (rel->r_offset + sizeof(uint64_t) <= bin->rel()[i].r_offset &&
-                        bin->rel()[i].r_offset < rel->r_offset + sizeof(uint64_t) + sizeof(uint64_t)) {
-                        rewrite_rel_types.emplace_back(ELF_R_TYPE(bin->rel()[i].r_info));
-                    }
-                }
+                // The number and the type of relocations which rewrite ti_offset.
+                const auto rewrite_rels =
+                    bin->FindRels(rel->r_offset + sizeof(uint64_t), rel->r_offset + sizeof(uint64_t) + sizeof(uint64_t));
+                const size_t num_rewrite_rels = rewrite_rels.second - rewrite_rels.first;
+                const uint32_t rewrite_rel_type = num_rewrite_rels ? ELF_R_TYPE((*rewrite_rels.first)->r_info) : Arch::kNone;
 
-                CHECK(rewrite_rel_types.size() == 0 || (rewrite_rel_types.size() == 1 && rewrite_rel_types[0] == R_X86_64_DTPOFF64))
-                    << SOLD_LOG_KEY(rewrite_rel_types.size()) << SOLD_LOG_KEY(ShowRelocationType(rewrite_rel_types[0]));
+                CHECK(num_rewrite_rels == 0 || (num_rewrite_rels == 1 && rewrite_rel_type == Arch::kTLSDTPOffset))
+                    << SOLD_LOG_KEY(num_rewrite_rels) << SOLD_LOG_KEY(ShowRelocationType(rewrite_rel_type));
 
-                if (rewrite_rel_types.size() == 1) {
-                    LOG(INFO) << "R_X86_64_DTPOFF64 exists next to R_X86_64_DTPMOD64. This relocation is TLS generic dynamic model.";
+                if (num_rewrite_rels == 1) {
+                    VLOG(1) << "A DTPOFF relocation exists next to the DTPMOD relocation. This relocation is TLS generic dynamic model.";
                     break;
                 }
 
-                LOG(INFO) << "R_X86_64_DTPMOD64 relocation in TLS local dynamic model. " << SOLD_LOG_KEY(*rel) << SOLD_LOG_KEY(newrel)
-                          << SOLD_LOG_64BITS(bin->OffsetFromAddr(rel->r_offset)) << SOLD_LOG_64BITS(*mod_on_got)
-                          << SOLD_LOG_64BITS(*offset_on_got) << SOLD_LOG_64BITS(bin->tls()->p_filesz) << SOLD_LOG_KEY(is_bss)
-                          << SOLD_LOG_64BITS(tls_.data[tls_.bin_to_index[bin]].file_offset)
-                          << SOLD_LOG_64BITS(tls_.data[tls_.bin_to_index[bin]].bss_offset);
+                VLOG(1) << "DTPMOD relocation in TLS local dynamic model. " << SOLD_LOG_KEY(*rel) << SOLD_LOG_KEY(newrel)
+                        << SOLD_LOG_64BITS(bin->OffsetFromAddr(rel->r_offset)) << SOLD_LOG_64BITS(mod_on_got)
+                        << SOLD_LOG_64BITS(offset_on_got) << SOLD_LOG_64BITS(bin->tls()->p_filesz) << SOLD_LOG_KEY(is_bss)
+                        << SOLD_LOG_64BITS(tls_.data[tls_.bin_to_index[bin]].file_offset)
+                        << SOLD_LOG_64BITS(tls_.data[tls_.bin_to_index[bin]].bss_offset);
 
                 // We cannot determine whether the associated symbol is a dummy or
                 // not just using its index. In addition to the traditional dummy
                 // symbol at index 0, I found some compilers emit a dummy symbol at
                 // index 1 of SECTION type.
-                CHECK_EQ(name, "") << "The symbol associated with R_X86_64_DTPMOD64 in TLS local dynamic model should be the dummy."
-                                   << SOLD_LOG_KEY(bin->filename());
+                CHECK(bin->Str(sym->st_name)[0] == '\0')
+                    << "The symbol associated with the DTPMOD relocation in TLS local dynamic model should be the dummy."
+                    << SOLD_LOG_KEY(bin->filename());
 
                 if (is_bss) {
                     // TLS variables without initial values are remapped from
                     // [bin->tls()->p_filesz, bin->tls()->p_memsz) to
                     // [tls_.data[tls_.bin_to_index[bin]].bss_offset,
                     //  tls_.data[tls_.bin_to_index[bin]].bss_offset + bin->tls()->p_memsz - bin->tls()->p_filesz)
-                    *offset_on_got += tls_.data[tls_.bin_to_index[bin]].bss_offset - bin->tls()->p_filesz;
+                    offset_on_got += tls_.data[tls_.bin_to_index[bin]].bss_offset - bin->tls()->p_filesz;
                 } else {
                     // TLS variables with initial values are remapped from
                     // [0, bin->tls()->p_filesz) to
                     // [tls_.data[tls_.bin_to_index[bin]].file_offset,
                     //  tls_.data[tls_.bin_to_index[bin]].file_offset + bin->tls()->p_filesz)
-                    *offset_on_got += tls_.data[tls_.bin_to_index[bin]].file_offset;
+                    offset_on_got += tls_.data[tls_.bin_to_index[bin]].file_offset;
                 }
+                overlay.Set(offset_file_offset, offset_on_got);
                 break;
             }
 
-            case R_X86_64_DTPOFF64:
-            case R_X86_64_TPOFF64: {
-                const std::string name = bin->Str(sym->st_name);
-                uintptr_t index = syms_.ResolveCopy(name, soname, version_name);
+            case Arch::kTLSDTPOffset:
+            case Arch::kTLSTPOffset: {
+                CHECK(Arch::kTraditionalTLS) << ShowRelocationType(type) << " is not supported.";
+                uintptr_t index = ResolveCopySymbol(bin, sym_index);
                 newrel.r_info = ELF_R_INFO(index, type);
-                LOG(INFO) << ShowRelocationType(type) << " relocation: " << SOLD_LOG_KEY(*rel) << SOLD_LOG_KEY(newrel)
-                          << SOLD_LOG_64BITS(bin->OffsetFromAddr(rel->r_offset));
+                VLOG(1) << ShowRelocationType(type) << " relocation: " << SOLD_LOG_KEY(*rel) << SOLD_LOG_KEY(newrel)
+                        << SOLD_LOG_64BITS(bin->OffsetFromAddr(rel->r_offset));
                 break;
             }
 
-            case R_X86_64_COPY: {
-                const std::string name = bin->Str(sym->st_name);
-                uintptr_t index = syms_.ResolveCopy(name, soname, version_name);
+            case Arch::kTLSDesc: {
+                const char* name = bin->Str(sym->st_name);
+                uintptr_t index = ResolveCopySymbol(bin, sym_index);
                 newrel.r_info = ELF_R_INFO(index, type);
-                break;
-            }
-
-            default:
-                LOG(FATAL) << "Unknown relocation type: " << ShowRelocationType(type);
-                CHECK(false);
-        }
-
-        rels_.push_back(newrel);
-    }
-}
-
-// Make new relocation table.
-// RelocateSymbol_aarch64 rewrites r_offset of each relocation entries
-// because we decided locations of shared objects in DecideMemOffset.
-void Sold::RelocateSymbol_aarch64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset) {
-    const Elf_Sym* sym = &bin->symtab()[ELF_R_SYM(rel->r_info)];
-    std::string soname, version_name;
-    std::tie(soname, version_name) = bin->GetVersion(ELF_R_SYM(rel->r_info), filename_to_soname_);
-
-    int type = ELF_R_TYPE(rel->r_info);
-    const uintptr_t addend = rel->r_addend;
-    std::vector<Elf_Rel> newrels;
-
-    if (bin->IsVaddrInTLSData(rel->r_offset)) {
-        Elf_Rel newrel = *rel;
-        const Elf_Phdr* tls = bin->tls();
-        CHECK(tls);
-        uintptr_t off = newrel.r_offset - tls->p_vaddr;
-        off = RemapTLS("reloc", bin, off);
-        newrel.r_offset = off + tls_offset_;
-        newrels.emplace_back(newrel);
-    } else {
-        Elf_Rel newrel = *rel;
-        newrel.r_offset += offset;
-        newrels.emplace_back(newrel);
-    }
-
-    if (bin->IsAddrInInitarray(rel->r_offset)) {
-        Elf_Rel newrel = *rel;
-        CHECK(bin_to_init_array_offset_.find(bin) != bin_to_init_array_offset_.end()) << SOLD_LOG_KEY(bin->filename());
-
-        newrel.r_offset -= bin->init_array_addr();
-        newrel.r_offset += bin_to_init_array_offset_[bin];
-        LOG(INFO) << SOLD_LOG_BITS(bin->init_array_addr()) << SOLD_LOG_BITS(bin_to_init_array_offset_[bin])
-                  << SOLD_LOG_BITS(newrel.r_offset) << SOLD_LOG_BITS(newrel.r_addend) << SOLD_LOG_BITS(offset);
-        newrels.emplace_back(newrel);
-    } else if (bin->IsAddrInFiniarray(rel->r_offset)) {
-        Elf_Rel newrel = *rel;
-        CHECK(bin_to_fini_array_offset_.find(bin) != bin_to_fini_array_offset_.end()) << SOLD_LOG_KEY(bin->filename());
-
-        newrel.r_offset -= bin->fini_array_addr();
-        newrel.r_offset += bin_to_fini_array_offset_[bin];
-        LOG(INFO) << SOLD_LOG_BITS(bin->fini_array_addr()) << SOLD_LOG_BITS(bin_to_fini_array_offset_[bin])
-                  << SOLD_LOG_BITS(newrel.r_offset) << SOLD_LOG_BITS(newrel.r_addend) << SOLD_LOG_BITS(offset);
-        newrels.emplace_back(newrel);
-    }
-
-    LOG(INFO) << "Relocate " << bin->Str(sym->st_name) << " at " << rel->r_offset;
-
-    for (auto newrel : newrels) {
-        // Even if we found a defined symbol in src_syms_, we cannot
-        // erase the relocation entry. The address needs to be fixed at
-        // runtime by ASLR function so we set RELATIVE to these resolved symbols.
-        switch (type) {
-            case R_AARCH64_RELATIVE: {
-                if (IsDefined(*sym)) {
-                    LOG(WARNING)
-                        << "The symbol associated with R_AARCH64_RELATIVE is defined. Because this relocation type doesn't need any "
-                           "symbol, something wrong may have happened.";
-                }
-                newrel.r_addend += offset;
-                break;
-            }
-
-            case R_AARCH64_GLOB_DAT:
-            case R_AARCH64_JUMP_SLOT: {
-                uintptr_t val_or_index;
-                if (syms_.Resolve(bin->Str(sym->st_name), soname, version_name, val_or_index)) {
-                    newrel.r_info = ELF_R_INFO(0, R_AARCH64_RELATIVE);
-                    newrel.r_addend = val_or_index;
-                } else {
-                    newrel.r_info = ELF_R_INFO(val_or_index, type);
+                if (name[0] != '\0') {
+                    VLOG(1) << SOLD_LOG_KEY(name) << " TLSDESC in generic dynamic";
+                    break;
                 }
-                break;
-            }
 
-            case R_AARCH64_ABS64: {
-                uintptr_t val_or_index;
-                if (syms_.Resolve(bin->Str(sym->st_name), soname, version_name, val_or_index)) {
-                    newrel.r_info = ELF_R_INFO(0, R_AARCH64_RELATIVE);
-                    newrel.r_addend += val_or_index;
+                // In local dynamic, r_addend is the offset in the TLS template.
+                VLOG(1) << "TLSDESC in local dynamic";
+                const bool is_bss = bin->IsOffsetInTLSBSS(newrel.r_addend);
+                if (is_bss) {
+                    VLOG(1) << "TLSDESC" << SOLD_LOG_BITS(newrel.r_addend)
+                            << SOLD_LOG_BITS(tls_.data[tls_.bin_to_index[bin]].bss_offset - bin->tls()->p_filesz);
+                    newrel.r_addend += tls_.data[tls_.bin_to_index[bin]].bss_offset - bin->tls()->p_filesz;
                 } else {
-                    newrel.r_info = ELF_R_INFO(val_or_index, type);
+                    VLOG(1) << "TLSDESC" << SOLD_LOG_BITS(newrel.r_addend) << SOLD_LOG_BITS(tls_.data[tls_.bin_to_index[bin]].file_offset);
+                    newrel.r_addend += tls_.data[tls_.bin_to_index[bin]].file_offset;
                 }
                 break;
             }
 
-            case R_AARCH64_TLSDESC: {
-                const std::string name = bin->Str(sym->st_name);
-                if (name == "") {
-                    LOG(INFO) << SOLD_LOG_KEY(name) << "R_AARCH64_TLSDESC in local dynamic";
-                    uintptr_t index = syms_.ResolveCopy(name, soname, version_name);
-                    newrel.r_info = ELF_R_INFO(index, type);
-                    const bool is_bss = bin->IsOffsetInTLSBSS(newrel.r_addend);
-                    if (is_bss) {
-                        LOG(INFO) << "R_AARCH64_TLSDESC" << SOLD_LOG_BITS(newrel.r_addend)
-                                  << SOLD_LOG_BITS(tls_.data[tls_.bin_to_index[bin]].bss_offset - bin->tls()->p_filesz);
-                        newrel.r_addend += tls_.data[tls_.bin_to_index[bin]].bss_offset - bin->tls()->p_filesz;
-                    } else {
-                        LOG(INFO) << "R_AARCH64_TLSDESC" << SOLD_LOG_BITS(newrel.r_addend)
-                                  << SOLD_LOG_BITS(tls_.data[tls_.bin_to_index[bin]].file_offset);
-                        newrel.r_addend += tls_.data[tls_.bin_to_index[bin]].file_offset;
-                    }
-                    break;
-                } else {
-                    LOG(INFO) << SOLD_LOG_KEY(name) << "R_AARCH64_TLSDESC in generic dynamic";
-                    uintptr_t index = syms_.ResolveCopy(name, soname, version_name);
-                    newrel.r_info = ELF_R_INFO(index, type);
-                    break;
-                }
-            }
-
-            case R_AARCH64_COPY: {
-                const std::string name = bin->Str(sym->st_name);
-                uintptr_t index = syms_.ResolveCopy(name, soname, version_name);
+            case Arch::kCopy: {
+                uintptr_t index = ResolveCopySymbol(bin, sym_index);
                 newrel.r_info = ELF_R_INFO(index, type);
                 break;
             }
@@ -906,15 +1174,8 @@ std::vector<std::string> Sold::GetLibraryPaths(const ELFBinary* binary) {
         }
     }
 
-    if (custome_library_path_.empty()) {
-        std::vector<std::string> ldsoconfs = ldsoconf::read_ldsoconf();
-        library_paths.insert(library_paths.end(), ldsoconfs.begin(), ldsoconfs.end());
-
-        library_paths.push_back("/lib");
-        library_paths.push_back("/usr/lib");
-        library_paths.push_back("/usr/lib64");
-    }
-
+    // /etc/ld.so.cache and the directories in /etc/ld.so.conf are searched
+    // by LibraryResolver when custome_library_path_ is empty.
     library_paths.insert(library_paths.end(), custome_library_path_.begin(), custome_library_path_.end());
 
     return library_paths;
@@ -979,11 +1240,16 @@ void Sold::ResolveLibraryPaths(ELFBinary* root_binary) {
                 continue;
             }
 
-            std::unique_ptr<ELFBinary> library;
-            for (const std::string& path : library_paths) {
-                const std::string& filename = path + '/' + needed;
-                if (Exists(filename)) {
-                    library = ReadELF(filename);
+            ELFBinary* library = nullptr;
+            if (resolver_) {
+                if (std::unique_ptr<ELFBinary> resolved = resolver_(needed)) {
+                    library = resolved.get();
+                    resolved_libraries_.push_back(std::move(resolved));
+                }
+            }
+            if (!library) {
+                for (const std::string& filename : pool_->FindCandidates(machine_type, needed, library_paths, custome_library_path_.empty())) {
+                    library = pool_->GetSummary(filename);
                     if (library) break;
                 }
             }
@@ -1003,14 +1269,15 @@ void Sold::ResolveLibraryPaths(ELFBinary* root_binary) {
             }
 
             if (ShouldLink(library->soname())) {
-                link_binaries_buf.emplace_back(needed, library.get());
+                // Excluded libraries are kept as summaries without contents.
+                if (!library->has_contents()) library = pool_->Get(library->filename());
+                link_binaries_buf.emplace_back(needed, library);
             }
 
             LOG(INFO) << "Loaded: " << needed << " => " << library->filename();
 
-            auto inserted = libraries_.emplace(needed, std::move(library));
-            CHECK(inserted.second);
-            bfs_queue.push(inserted.first->second.get());
+            CHECK(libraries_.emplace(needed, library).second);
+            bfs_queue.push(library);
         }
     }
 
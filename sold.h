@@ -14,18 +14,27 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <libgen.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
+#include "arch_traits.h"
 #include "ehframe_builder.h"
 #include "elf_binary.h"
 #include "hash.h"
-#include "ldsoconf.h"
+#include "layout_state.h"
+#include "library_pool.h"
 #include "mprotect_builder.h"
+#include "overlay.h"
+#include "reloc_table.h"
+#include "relative_relocs.h"
 #include "shdr_builder.h"
 #include "strtab_builder.h"
 #include "symtab_builder.h"
@@ -34,151 +43,173 @@
 
 class Sold {
 public:
+    // Resolver returns the library for DT_NEEDED `needed`, or nullptr to
+    // search the filesystem for it.
+    using Resolver = std::function<std::unique_ptr<ELFBinary>(const std::string& needed)>;
+
     Sold(const std::string& elf_filename, const std::vector<std::string>& exclude_sos, const std::vector<std::string>& exclude_finis,
-         const std::vector<std::string> custome_library_path, bool emit_section_header);
+         const std::vector<std::string> custome_library_path, bool emit_section_header, LibraryPool* pool = nullptr);
+
+    // This takes the main binary, LD_LIBRARY_PATH and a resolver for
+    // libraries explicitly instead of reading the filesystem and the
+    // environment. See libsold.h.
+    Sold(std::unique_ptr<ELFBinary> main_binary, const std::vector<std::string>& exclude_sos, const std::vector<std::string>& exclude_finis,
+         const std::vector<std::string> custome_library_path, const std::vector<std::string>& ld_library_paths, const Resolver& resolver,
+         bool emit_section_header, LibraryPool* pool = nullptr);
+
+    // SetMemoryBudget limits the memory used by Link to roughly `budget`
+    // bytes. A quarter of it is used to hold relocations and the rest are
+    // spilled to a temporary file. Pages of each input are released once
+    // they are relocated and emitted. 0 means no limit.
+    void SetMemoryBudget(uint64_t budget) { memory_budget_ = budget; }
+
+    // SetIncremental makes Link reserve slack for each binary and save the
+    // layout to LayoutStateFilename. When the layout of the previous output
+    // still fits, Link reuses it and rewrites only the segments of changed
+    // binaries in place. Otherwise, Link writes the whole output.
+    void SetIncremental(bool incremental) { incremental_ = incremental; }
+
+    // SetStableLayout makes Link place each binary at an address derived
+    // from its soname with slack, and order symbols and relocations
+    // deterministically. A change in one binary then changes only a small
+    // part of the output. This cannot be used with SetIncremental.
+    void SetStableLayout(bool stable) { stable_layout_ = stable; }
+
+    // SetValidateEHFrame makes Link check every FDE of the inputs against
+    // their .eh_frame_hdr. This is for debugging sold and its inputs.
+    void SetValidateEHFrame(bool validate) { validate_eh_frame_ = validate; }
 
     void Link(const std::string& out_filename);
 
+    // Link writes the output to `fp`, which must be seekable. Incremental
+    // links are not supported.
+    void Link(FILE* fp);
+
     const std::map<std::string, std::string> filename_to_soname() { return filename_to_soname_; };
 
+    static std::vector<std::string> GetLdLibraryPathsFromEnv() {
+        std::vector<std::string> ld_library_paths;
+        if (const char* paths = getenv("LD_LIBRARY_PATH")) {
+            for (const std::string& path : SplitString(paths, ":")) {
+                ld_library_paths.push_back(path);
+            }
+        }
+        return ld_library_paths;
+    }
+
+    // ClosureDigest identifies the output of Link. It covers the paths and
+    // the contents of the main binary and all resolved libraries, and the
+    // options which affect the output.
+    std::string ClosureDigest() const;
+
 private:
+    // Build decides the layout and builds all tables of the output.
+    void Build();
     void Emit(const std::string& out_filename);
+    void Emit(FILE* fp);
+
+    // LayoutPlan is the file layout of the output. Each offset and size is
+    // decided once and read by the builders and the emitters afterwards.
+    // Sizes which depend only on the inputs are counted by PlanInputs. The
+    // tables at the head are placed once their sizes are fixed: the arrays
+    // by CollectArrays, the tables up to .dynstr by PlanTables and the rest
+    // by BuildLoads after .dynstr is frozen. BuildLoads freezes the plan.
+    struct LayoutPlan {
+        size_t num_phdrs{0};
+        uintptr_t tls_filesz{0};
+        uintptr_t tls_memsz{0};
+        uintptr_t ehframe_size{0};
+        uintptr_t mprotect_size{0};
+
+        Range init_array{0, 0};
+        Range fini_array{0, 0};
+        Range gnu_hash{0, 0};
+        Range symtab{0, 0};
+        Range versym{0, 0};
+        Range verneed{0, 0};
+        Range rel{0, 0};
+        Range strtab{0, 0};
+        Range dynamic{0, 0};
+        Range shstrtab{0, 0};
+        // The start of the segments of the inputs.
+        uintptr_t code_offset{0};
+        Range tls{0, 0};
+        Range ehframe{0, 0};
+        Range mprotect{0, 0};
+        uintptr_t shdr_offset{0};
+
+        bool frozen{false};
+    };
 
-    size_t CountPhdrs() const {
-        // DYNAMIC and its LOAD.
-        size_t num_phdrs = 2;
-        // INTERP and PHDR.
-        if (is_executable_) num_phdrs += 2;
-        // TLS and its LOAD.
-        if (tls_.memsz) num_phdrs += 2;
-        // PT_GNU_EH_FRAME and its PT_LOAD
-        num_phdrs += 2;
-        // GNU_STACK
-        num_phdrs++;
-        // GNU_RELRO
-        num_phdrs++;
-        // Normal PT_LOAD
-        for (ELFBinary* bin : link_binaries_) {
-            num_phdrs += bin->loads().size();
-        }
-        return num_phdrs;
-    }
+    // After returns the range of `size` bytes which follows `prev`.
+    static Range After(const Range& prev, uintptr_t size) { return Range{prev.end, prev.end + size}; }
+
+    void PlanInputs();
+    void PlanTables();
+
+    size_t CountPhdrs() const { return plan_.num_phdrs; }
 
     // We emit .init_array and .fini_array at the head of ELF file.
     // This is because we want to fix the addresses of arrays as much as possible to emit relocation entries easily.
-    uintptr_t InitArrayOffset() const { return AlignNext(sizeof(Elf_Ehdr) + sizeof(Elf_Phdr) * CountPhdrs(), 7); }
-    uintptr_t InitArraySize() const { return sizeof(uintptr_t) * init_array_.size(); }
+    uintptr_t InitArrayOffset() const { return plan_.init_array.start; }
+    uintptr_t InitArraySize() const { return plan_.init_array.size(); }
 
-    uintptr_t FiniArrayOffset() const { return InitArrayOffset() + InitArraySize(); }
-    uintptr_t FiniArraySize() const { return sizeof(uintptr_t) * fini_array_.size(); }
+    uintptr_t FiniArrayOffset() const { return plan_.fini_array.start; }
+    uintptr_t FiniArraySize() const { return plan_.fini_array.size(); }
 
-    uintptr_t GnuHashOffset() const { return FiniArrayOffset() + FiniArraySize(); }
-    uintptr_t GnuHashSize() const { return syms_.GnuHashSize(); }
+    uintptr_t GnuHashOffset() const { return plan_.gnu_hash.start; }
+    uintptr_t GnuHashSize() const { return plan_.gnu_hash.size(); }
 
-    uintptr_t SymtabOffset() const { return GnuHashOffset() + GnuHashSize(); }
-    uintptr_t SymtabSize() const { return syms_.size() * sizeof(Elf_Sym); }
+    uintptr_t SymtabOffset() const { return plan_.symtab.start; }
+    uintptr_t SymtabSize() const { return plan_.symtab.size(); }
 
-    uintptr_t VersymOffset() const { return SymtabOffset() + SymtabSize(); }
-    uintptr_t VersymSize() const { return version_.SizeVersym(); }
+    uintptr_t VersymOffset() const { return plan_.versym.start; }
+    uintptr_t VersymSize() const { return plan_.versym.size(); }
 
-    uintptr_t VerneedOffset() const { return VersymOffset() + VersymSize(); }
-    uintptr_t VerneedSize() const { return version_.SizeVerneed(); }
+    uintptr_t VerneedOffset() const { return plan_.verneed.start; }
+    uintptr_t VerneedSize() const { return plan_.verneed.size(); }
 
-    uintptr_t RelOffset() const { return VerneedOffset() + VerneedSize(); }
-    uintptr_t RelSize() const { return rels_.size() * sizeof(Elf_Rel); }
+    uintptr_t RelOffset() const { return plan_.rel.start; }
+    uintptr_t RelSize() const { return plan_.rel.size(); }
 
-    uintptr_t StrtabOffset() const { return RelOffset() + RelSize(); }
-    uintptr_t StrtabSize() const { return strtab_.size(); }
+    uintptr_t StrtabOffset() const { return plan_.strtab.start; }
+    uintptr_t StrtabSize() const { return plan_.strtab.size(); }
 
-    uintptr_t DynamicOffset() const { return StrtabOffset() + StrtabSize(); }
-    uintptr_t DynamicSize() const { return sizeof(Elf_Dyn) * dynamic_.size(); }
+    uintptr_t DynamicOffset() const { return plan_.dynamic.start; }
+    uintptr_t DynamicSize() const { return plan_.dynamic.size(); }
 
-    uintptr_t ShstrtabOffset() const { return DynamicOffset() + DynamicSize(); }
-    uintptr_t ShstrtabSize() const { return shdr_.ShstrtabSize(); }
+    uintptr_t ShstrtabOffset() const { return plan_.shstrtab.start; }
+    uintptr_t ShstrtabSize() const { return plan_.shstrtab.size(); }
 
-    uintptr_t CodeOffset() const { return AlignNext(ShstrtabOffset() + ShstrtabSize()); }
-    uintptr_t CodeSize() {
-        uintptr_t p = 0;
-        for (const Load& load : loads_) {
-            ELFBinary* bin = load.bin;
-            Elf_Phdr* phdr = load.orig;
-            p += (load.emit.p_offset + phdr->p_filesz);
-        }
-        return p;
-    }
+    uintptr_t CodeOffset() const { return plan_.code_offset; }
 
-    uintptr_t TLSOffset() const { return tls_file_offset_; }
-    uintptr_t TLSFileSize() const {
-        static uintptr_t s = 0;
-        if (s != 0) return s;
-        for (ELFBinary* bin : link_binaries_) {
-            for (Elf_Phdr* phdr : bin->phdrs()) {
-                if (phdr->p_type == PT_TLS) {
-                    s += phdr->p_filesz;
-                }
-            }
-        }
-        return s;
-    }
+    uintptr_t TLSOffset() const { return plan_.tls.start; }
+    uintptr_t TLSFileSize() const { return plan_.tls_filesz; }
+    uintptr_t TLSMemSize() const { return plan_.tls_memsz; }
 
-    uintptr_t EHFrameOffset() const { return AlignNext(TLSOffset() + TLSFileSize()); }
+    uintptr_t EHFrameOffset() const { return plan_.ehframe.start; }
     // We emit EHFrame whenever the number of FDEs is 0.
-    uintptr_t EHFrameSize() const {
-        static uintptr_t s = 0;
-        if (s != 0) return s;
+    uintptr_t EHFrameSize() const { return plan_.ehframe_size; }
+    // DecideMemOffset places .eh_frame_hdr before the inputs when some FDEs
+    // are too far from the end of them.
+    bool EHFrameBeforeInputs() const { return ehframe_offset_ < tls_offset_; }
 
-        int n_fdes = 0;
-        s = sizeof(EHFrameHeader::version) + sizeof(EHFrameHeader::eh_frame_ptr_enc) + sizeof(EHFrameHeader::fde_count_enc) +
-            sizeof(EHFrameHeader::table_enc) + sizeof(EHFrameHeader::eh_frame_ptr) + sizeof(EHFrameHeader::fde_count);
+    uintptr_t MemprotectOffset() const { return plan_.mprotect.start; }
+    uintptr_t MprotectSize() const { return plan_.mprotect_size; }
 
-        for (ELFBinary* bin : link_binaries_) {
-            for (Elf_Phdr* phdr : bin->phdrs()) {
-                if (phdr->p_type == PT_GNU_EH_FRAME) {
-                    n_fdes += bin->eh_frame_header()->fde_count;
-                }
-            }
-        }
-        s += n_fdes * (sizeof(EHFrameHeader::FDETableEntry::fde_ptr) + sizeof(EHFrameHeader::FDETableEntry::initial_loc));
-        return s;
-    }
-
-    uintptr_t MemprotectOffset() const { return mprotect_file_offset_; }
-    uintptr_t MprotectSize() const {
-        int n_memprotect = 0;
-        for (ELFBinary* bin : link_binaries_) {
-            for (Elf_Phdr* phdr : bin->phdrs()) {
-                if (phdr->p_type == PT_GNU_RELRO) {
-                    n_memprotect++;
-                }
-            }
-        }
-        if (machine_type == EM_X86_64) {
-            return sizeof(MprotectBuilder::memprotect_body_code_x86_64) * n_memprotect +
-                   sizeof(MprotectBuilder::memprotect_end_code_x86_64);
-        } else if (machine_type == EM_AARCH64) {
-            return MprotectBuilder::body_code_length_aarch64 * n_memprotect + MprotectBuilder::ret_code_length_aarch64;
-        } else {
-            CHECK(false) << SOLD_LOG_KEY(machine_type) << " is not supported.";
-        }
-    }
-    uintptr_t ShdrOffset() const { return MemprotectOffset() + MprotectSize(); }
+    uintptr_t ShdrOffset() const { return plan_.shdr_offset; }
 
     void BuildEhdr();
 
     void BuildLoads();
 
     void BuildEHFrameHeader() {
-        for (const ELFBinary* bin : link_binaries_) {
-            for (const Elf_Phdr* phdr : bin->phdrs()) {
-                if (phdr->p_type == PT_GNU_EH_FRAME) {
-                    // The order of calls of ehframe_builder_.Add is important
-                    // because the entries in the table must be sorted by the
-                    // initial location value.
-                    ehframe_builder_.Add(bin->name(), *bin->eh_frame_header(), bin->AddrFromOffset(phdr->p_offset), offsets_[bin],
-                                         ehframe_offset_);
-                }
-            }
+        for (const ELFBinary* bin : layout_order_) {
+            const EHFrameHeader& efh = *bin->eh_frame_header();
+            if (!efh.fde_count) continue;
+            ehframe_builder_.Add(bin->name(), efh, efh.table_base, offsets_[bin], ehframe_offset_);
         }
+        ehframe_builder_.Finalize();
         SOLD_CHECK_EQ(EHFrameSize(), ehframe_builder_.Size());
     }
 
@@ -204,6 +235,29 @@ private:
         interp_offset_ = AddStr(interp);
     }
 
+    // Offsets returned by AddStr and DT_STRSZ refer to .dynstr before its
+    // tails are merged. TranslateStrtabOffsets fixes them after strtab_ is
+    // frozen.
+    void TranslateStrtabOffsets() {
+        syms_.TranslateNames(strtab_);
+        for (Elf_Dyn& dyn : dynamic_) {
+            switch (dyn.d_tag) {
+                case DT_NEEDED:
+                case DT_SONAME:
+                case DT_RPATH:
+                case DT_RUNPATH:
+                    dyn.d_un.d_val = strtab_.Translate(dyn.d_un.d_val);
+                    break;
+                case DT_STRSZ:
+                    dyn.d_un.d_val = strtab_.size();
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (is_executable_) interp_offset_ = strtab_.Translate(interp_offset_);
+    }
+
     void BuildArrays();
 
     void BuildDynamic();
@@ -236,9 +290,7 @@ private:
 
     void EmitRel(FILE* fp) {
         CHECK(ftell(fp) == RelOffset());
-        for (const Elf_Rel& rel : rels_) {
-            Write(fp, rel);
-        }
+        rels_.Emit(fp);
     }
 
     void EmitArrays(FILE* fp) {
@@ -265,14 +317,24 @@ private:
     }
 
     void EmitCode(FILE* fp) {
+        EmitPad(fp, CodeOffset());
         CHECK(ftell(fp) == CodeOffset());
         for (const Load& load : loads_) {
             ELFBinary* bin = load.bin;
             Elf_Phdr* phdr = load.orig;
+            if (unchanged_binaries_.count(bin)) {
+                // The output already has this segment.
+                CHECK(fseek(fp, load.slot.end, SEEK_SET) == 0);
+                continue;
+            }
             LOG(INFO) << "Emitting code of " << bin->name() << " from " << HexString(ftell(fp)) << " => " << HexString(load.emit.p_offset)
                       << " + " << HexString(phdr->p_filesz);
             EmitPad(fp, load.emit.p_offset);
-            WriteBuf(fp, bin->head() + phdr->p_offset, phdr->p_filesz);
+            bin->Advise(phdr->p_offset, phdr->p_filesz, MADV_SEQUENTIAL);
+            overlays_[bin].Emit(fp, bin->head(), phdr->p_offset, phdr->p_filesz);
+            if (memory_budget_) bin->Advise(phdr->p_offset, phdr->p_filesz, MADV_DONTNEED);
+            // Clear the rest of the slot, which may have an old segment.
+            if (incremental_) EmitPad(fp, load.slot.end);
         }
     }
 
@@ -281,7 +343,7 @@ private:
         EmitPad(fp, TLSOffset());
         CHECK(ftell(fp) == TLSOffset());
         for (TLS::Data data : tls_.data) {
-            WriteBuf(fp, data.start, data.size);
+            overlays_[data.bin].Emit(fp, data.bin->head(), data.start - reinterpret_cast<const uint8_t*>(data.bin->head()), data.size);
         }
     }
 
@@ -304,9 +366,37 @@ private:
         shdr_.EmitShdrs(fp);
     }
 
-    uintptr_t TLSMemSize() const;
     void DecideMemOffset();
 
+    // AddSlack returns the end of a slot for [start, end) with the slack
+    // for incremental links.
+    static uintptr_t AddSlack(uintptr_t start, uintptr_t end) {
+        return AlignNext(end + std::max<uintptr_t>((end - start) / 8, LINUX_PAGE_SIZE));
+    }
+    bool LoadsFitIn(const LayoutState& layout);
+
+    // StableMemSlotSize returns the size of the memory slot for a binary of
+    // `size` bytes in the stable layout. This is a power of two so that a
+    // binary can grow a lot without moving.
+    static uintptr_t StableMemSlotSize(uintptr_t size) {
+        uintptr_t slot = 0x10000;
+        while (slot < size + size / 8) slot *= 2;
+        return slot;
+    }
+    // StableFileSlotSize returns the size of the file slot for `size` bytes
+    // in the stable layout. The contents do not depend on file offsets, so
+    // finer size classes (eighths of a power of two) are used to keep the
+    // output small.
+    static uintptr_t StableFileSlotSize(uintptr_t size) {
+        size += std::max<uintptr_t>(size / 8, LINUX_PAGE_SIZE);
+        uintptr_t granule = LINUX_PAGE_SIZE;
+        while (granule * 16 <= size) granule *= 2;
+        return AlignNext(size, granule - 1);
+    }
+    uintptr_t DecideStableMemOffset();
+    void DecideUnchangedBinaries(const std::string& out_filename);
+    void WriteLayoutState(const std::string& out_filename);
+
     void CollectArrays();
 
     // CollectSymbols collects all symbols in .dynsym of link_binaries_. When
@@ -352,44 +442,69 @@ private:
     void CopyPublicSymbols();
 
     void Relocate() {
-        for (ELFBinary* bin : link_binaries_) {
+        // Count the relocations of the output to allocate rels_ at once. Each
+        // slot of the arrays may have one more relocation (see MapRelocation).
+        size_t num_rels = init_array_.size() + fini_array_.size();
+        for (ELFBinary* bin : layout_order_) num_rels += bin->num_rels() + bin->num_plt_rels();
+        rels_.reserve(num_rels);
+
+        for (ELFBinary* bin : layout_order_) {
             RelocateBinary(bin);
         }
     }
 
     void RelocateBinary(ELFBinary* bin) {
         CHECK(bin->symtab());
+        // The size of .dynsym is unknown without section headers, so the
+        // symbols referred by relocations bound it.
+        uint32_t max_sym_index = 0;
+        auto bound = [&max_sym_index](const Elf_Rel* rels, size_t num) {
+            for (size_t i = 0; i < num; ++i) max_sym_index = std::max<uint32_t>(max_sym_index, ELF_R_SYM(rels[i].r_info));
+        };
+        bound(bin->rel(), bin->num_rels());
+        bound(bin->plt_rel(), bin->num_plt_rels());
+        sym_handles_.assign(max_sym_index + 1, SymbolHandle());
+
         RelocateSymbols(bin, bin->rel(), bin->num_rels());
         RelocateSymbols(bin, bin->plt_rel(), bin->num_plt_rels());
-    }
-
-    void RelocateSymbols(ELFBinary* bin, const Elf_Rel* rels, size_t num) {
-        if (!rels) CHECK_EQ(0, num);
-        uintptr_t offset = offsets_[bin];
-        if (bin->ehdr()->e_machine == EM_X86_64) {
-            for (size_t i = 0; i < num; ++i) {
-                RelocateSymbol_x86_64(bin, &rels[i], offset);
-            }
-        } else if (bin->ehdr()->e_machine == EM_AARCH64) {
-            for (size_t i = 0; i < num; ++i) {
-                RelocateSymbol_aarch64(bin, &rels[i], offset);
-            }
-        } else {
-            CHECK(false) << "sold does not support " << SOLD_LOG_KEY(bin->ehdr()->e_machine) << ".";
+        if (memory_budget_) {
+            // The relocation tables of bin are not read anymore.
+            auto release = [bin](const Elf_Rel* rels, size_t num) {
+                if (rels) bin->Advise(reinterpret_cast<const char*>(rels) - bin->head(), num * sizeof(Elf_Rel), MADV_DONTNEED);
+            };
+            release(bin->rel(), bin->num_rels());
+            release(bin->plt_rel(), bin->num_plt_rels());
         }
     }
 
-    void RelocateSymbol_x86_64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset);
+    // RelocateSymbols appends the relocations of the output for `rels` of
+    // `bin` to rels_.
+    void RelocateSymbols(ELFBinary* bin, const Elf_Rel* rels, size_t num);
+
+    template <class Arch>
+    void RelocateSymbols(ELFBinary* bin, const Elf_Rel* rels, size_t num);
+
+    // SymbolHandle caches the resolution of a symbol of the binary being
+    // relocated. Relocations referring to the same symbol share it so that
+    // the name and the version are looked up only once.
+    struct SymbolHandle {
+        bool resolved{false};
+        bool defined{false};
+        uintptr_t val_or_index{0};
+        bool copy_resolved{false};
+        uintptr_t copy_index{0};
+    };
 
-    void RelocateSymbol_aarch64(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset);
+    // ResolveSymbol and ResolveCopySymbol are SymtabBuilder::Resolve and
+    // SymtabBuilder::ResolveCopy for symbol `index` of `bin` through
+    // sym_handles_.
+    bool ResolveSymbol(ELFBinary* bin, uint32_t index, uintptr_t* val_or_index);
+    uintptr_t ResolveCopySymbol(ELFBinary* bin, uint32_t index);
 
-    void InitLdLibraryPaths() {
-        if (const char* paths = getenv("LD_LIBRARY_PATH")) {
-            for (const std::string& path : SplitString(paths, ":")) {
-                ld_library_paths_.push_back(path);
-            }
-        }
-    }
+    size_t MapRelocation(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset, Elf_Rel* newrels);
+
+    template <class Arch>
+    void RelocateSymbol(ELFBinary* bin, const Elf_Rel* rel, uintptr_t offset);
 
     std::string ResolveRunPathVariables(const ELFBinary* binary, const std::string& runpath);
 
@@ -397,14 +512,6 @@ private:
 
     void ResolveLibraryPaths(ELFBinary* root_binary);
 
-    bool Exists(const std::string& filename) {
-        struct stat st;
-        if (stat(filename.c_str(), &st) != 0) {
-            return false;
-        }
-        return (st.st_mode & S_IFMT) & S_IFREG;
-    }
-
     bool ShouldLink(const std::string& soname);
 
     uintptr_t AddStr(const std::string& s) { return strtab_.Add(s); }
@@ -413,6 +520,8 @@ private:
         ELFBinary* bin;
         Elf_Phdr* orig;
         Elf_Phdr emit;
+        // The file range reserved for this segment in incremental links.
+        Range slot;
     };
 
     std::vector<std::string> EXCLUDE_SHARED_OBJECTS = {
@@ -436,27 +545,57 @@ private:
     };
     Elf64_Half machine_type;
     std::unique_ptr<ELFBinary> main_binary_;
+    // pool_ is own_pool_ unless a pool is given to the constructor.
+    std::unique_ptr<LibraryPool> own_pool_;
+    LibraryPool* pool_;
     std::vector<std::string> ld_library_paths_;
     const std::vector<std::string> exclude_sos_;
     const std::vector<std::string> exclude_finis_;
     const std::vector<std::string> custome_library_path_;
-    std::map<std::string, std::unique_ptr<ELFBinary>> libraries_;
+    const Resolver resolver_;
+    // Libraries returned by resolver_.
+    std::vector<std::unique_ptr<ELFBinary>> resolved_libraries_;
+    // Libraries are owned by pool_ or resolved_libraries_. Ones in pool_ may
+    // be shared with other Sold instances. We must not modify them.
+    // Libraries from pool_ not in link_binaries_ are summaries without
+    // contents (see ReadELFSummary).
+    std::map<std::string, ELFBinary*> libraries_;
     std::vector<ELFBinary*> link_binaries_;
+    // Symbols of each binary in link_binaries_ relocated by LoadDynSymtab.
+    // Syminfo::sym points to an element of relocated_syms_.
+    std::map<const ELFBinary*, std::vector<Syminfo>> bin_to_syms_;
+    std::deque<Elf_Sym> relocated_syms_;
+    // Indexed by the symbol index of the binary being relocated.
+    std::vector<SymbolHandle> sym_handles_;
+    // Modifications to the contents of link_binaries_.
+    std::map<const ELFBinary*, Overlay> overlays_;
     std::map<const ELFBinary*, uintptr_t> offsets_;
     std::map<std::string, std::string> filename_to_soname_;
     std::map<std::string, std::string> soname_to_filename_;
-    uintptr_t tls_file_offset_{0};
-    uintptr_t ehframe_file_offset_{0};
-    uintptr_t mprotect_file_offset_{0};
+    LayoutPlan plan_;
     uintptr_t tls_offset_{0};
     uintptr_t ehframe_offset_{0};
     uintptr_t mprotect_offset_{0};
     bool is_executable_{false};
     bool emit_section_header_;
+    uint64_t memory_budget_{0};
+
+    bool incremental_{false};
+    // The layout of the previous output. This is reset when it cannot be
+    // reused.
+    std::unique_ptr<LayoutState> prev_layout_;
+    std::map<const ELFBinary*, Range> mem_slots_;
+    // Binaries whose segments in the previous output are reused.
+    std::set<const ELFBinary*> unchanged_binaries_;
+
+    bool stable_layout_{false};
+    bool validate_eh_frame_{false};
+    // link_binaries_ sorted by their addresses in the output.
+    std::vector<ELFBinary*> layout_order_;
 
     uintptr_t interp_offset_;
     SymtabBuilder syms_;
-    std::vector<Elf_Rel> rels_;
+    RelocationTable rels_;
     StrtabBuilder strtab_;
     VersionBuilder version_;
     EHFrameBuilder ehframe_builder_;
@@ -13,9 +13,45 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include "link_server.h"
+#include "output_cache.h"
+#include "output_verifier.h"
 #include "sold.h"
 
+#include <dirent.h>
 #include <getopt.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+// ParseSize parses a size such as 4096, 512K, 64M and 1G.
+bool ParseSize(const char* str, uint64_t* size) {
+    char* end;
+    uint64_t v = strtoull(str, &end, 10);
+    if (end == str) return false;
+    switch (*end) {
+        case 'G':
+            v <<= 10;
+            // fall through
+        case 'M':
+            v <<= 10;
+            // fall through
+        case 'K':
+            v <<= 10;
+            end++;
+            break;
+    }
+    if (*end != '\0') return false;
+    *size = v;
+    return true;
+}
 
 void print_help(std::ostream& os) {
     os << R"(usage: sold [option] [input]
@@ -26,15 +62,159 @@ Options:
 -e, --exclude-so EXCLUDE_FILE   Specify the ELF file to exclude (e.g. libmax.so) 
 -L, --custom-library-path PATH  Use PATH instead of the default path such as /usr/lib
 --section-headers               Emit section headers
---check-output                  Check the output using sold itself
+--check-output                  Verify the structure of the output and report problems as JSON lines.
+                                Without -o, verify the input instead of linking it
+--validate-eh-frame             Check every FDE of inputs against .eh_frame_hdr (for debugging)
 --exclude-from-fini             Do not use .fini_array of the ELF file
+--metadata-cache-dir DIR        Cache parsed metadata of input libraries in DIR
+--cache-dir DIR                 Reuse outputs in DIR when the inputs and options are unchanged
+--cache-size SIZE               Limit the total size of outputs in --cache-dir (e.g. 512M, default: 1G)
+--cache-stats                   Show statistics of --cache-dir and exit
+--batch MANIFEST                Link all pairs of INPUT and OUTPUT in MANIFEST. When MANIFEST is a
+                                directory, link all shared objects in it into the -o directory
+-j, --jobs N                    Run N links in parallel in --batch mode (default: the number of CPUs)
+--memory-budget SIZE            Spill relocations to a temporary file and release inputs early to keep
+                                the memory usage of each link around SIZE (e.g. 512M)
+--incremental                   Reuse the layout of the previous output and rewrite only the segments of
+                                changed inputs
+--stable-layout                 Place each library at an address derived from its soname so that a change
+                                in one library makes a small binary delta of the output
+--server SOCKET                 Serve links requested with --connect on the Unix socket SOCKET, keeping
+                                parsed libraries in memory
+--connect SOCKET                Run this link in the server on SOCKET, or locally when no server answers
 
 The last argument is interpreted as SOURCE_FILE when -i option isn't given.
 )" << std::endl;
 }
 
-int main(int argc, char* const argv[]) {
-    google::InitGoogleLogging(argv[0]);
+struct Options {
+    std::vector<std::string> exclude_sos;
+    std::vector<std::string> exclude_finis;
+    std::vector<std::string> custome_library_path;
+    bool emit_section_header = false;
+    bool check_output = false;
+    std::string cache_dir;
+    uint64_t cache_size = 1ULL << 30;
+    uint64_t memory_budget = 0;
+    bool incremental = false;
+    bool stable_layout = false;
+    bool validate_eh_frame = false;
+    std::vector<std::string> ld_library_paths;
+};
+
+// VerifyOutput reports problems of `filename` to stderr as JSON lines and
+// returns false when there is any.
+bool VerifyOutput(const std::string& filename) {
+    OutputVerifier verifier(filename);
+    if (verifier.Verify().empty()) return true;
+    verifier.WriteJSON(std::cerr);
+    return false;
+}
+
+bool LinkOne(const Options& opts, LibraryPool* pool, const std::string& input_file, const std::string& output_file) {
+    Sold sold(ReadELF(input_file, pool->metadata_cache()), opts.exclude_sos, opts.exclude_finis, opts.custome_library_path,
+              opts.ld_library_paths, Sold::Resolver(), opts.emit_section_header, pool);
+    sold.SetMemoryBudget(opts.memory_budget);
+    sold.SetIncremental(opts.incremental);
+    sold.SetStableLayout(opts.stable_layout);
+    sold.SetValidateEHFrame(opts.validate_eh_frame);
+    if (opts.cache_dir.empty()) {
+        sold.Link(output_file);
+    } else {
+        OutputCache cache(opts.cache_dir, opts.cache_size);
+        const std::string key = sold.ClosureDigest();
+        if (!cache.Fetch(key, output_file)) {
+            sold.Link(output_file);
+            cache.Insert(key, output_file);
+        }
+    }
+
+    return !opts.check_output || VerifyOutput(output_file);
+}
+
+bool IsSharedObject(const std::string& filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    Elf_Ehdr ehdr;
+    if (!ifs.read(reinterpret_cast<char*>(&ehdr), sizeof(ehdr))) return false;
+    return ELFBinary::IsELF(reinterpret_cast<const char*>(&ehdr)) && ehdr.e_ident[EI_CLASS] == ELFCLASS64 && ehdr.e_type == ET_DYN;
+}
+
+// ReadBatchJobs reads pairs of (input, output) from `manifest`. Each line of
+// a manifest file is "INPUT OUTPUT" and lines starting with '#' are
+// ignored. When `manifest` is a directory, all shared objects in it are
+// linked into `output_dir` with the same names.
+bool ReadBatchJobs(const std::string& manifest, const std::string& output_dir, std::vector<std::pair<std::string, std::string>>* jobs) {
+    if (DIR* d = opendir(manifest.c_str())) {
+        if (output_dir.empty()) {
+            closedir(d);
+            std::cerr << "--batch with a directory requires -o OUTPUT_DIR." << std::endl;
+            return false;
+        }
+        while (struct dirent* ent = readdir(d)) {
+            const std::string input = manifest + "/" + ent->d_name;
+            if (ent->d_type == DT_DIR || !IsSharedObject(input)) continue;
+            jobs->emplace_back(input, output_dir + "/" + ent->d_name);
+        }
+        closedir(d);
+        std::sort(jobs->begin(), jobs->end());
+        return true;
+    }
+
+    std::ifstream ifs(manifest);
+    if (!ifs) {
+        std::cerr << "Cannot open " << manifest << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int lineno = 1; std::getline(ifs, line); lineno++) {
+        std::istringstream iss(line);
+        std::string input, output, rest;
+        if (!(iss >> input) || input[0] == '#') continue;
+        if (!(iss >> output) || (iss >> rest)) {
+            std::cerr << manifest << ":" << lineno << ": expected INPUT OUTPUT" << std::endl;
+            return false;
+        }
+        jobs->emplace_back(input, output);
+    }
+    return true;
+}
+
+// RunBatch links all jobs with `num_threads` threads sharing one
+// LibraryPool. Returns false when --check-output finds a problem in any of
+// the outputs.
+bool RunBatch(const Options& opts, LibraryPool* pool, const std::vector<std::pair<std::string, std::string>>& jobs, int num_threads) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool> ok{true};
+    auto worker = [&opts, pool, &jobs, &next, &ok]() {
+        for (size_t i; (i = next++) < jobs.size();) {
+            LOG(INFO) << "Batch link: " << jobs[i].first << " => " << jobs[i].second;
+            if (!LinkOne(opts, pool, jobs[i].first, jobs[i].second)) ok = false;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) threads.emplace_back(worker);
+    for (std::thread& t : threads) t.join();
+    return ok;
+}
+
+// AbsolutePath returns `path` relative to the current directory.
+std::string AbsolutePath(const std::string& path) {
+    if (path.empty() || path[0] == '/') return path;
+    char cwd[PATH_MAX];
+    CHECK(getcwd(cwd, sizeof(cwd))) << strerror(errno);
+    return std::string(cwd) + "/" + path;
+}
+
+// Run runs the command line `args`. In a server, `server_pool` is the pool
+// of the server and `ld_library_paths` comes from the client.
+int Run(const std::vector<std::string>& args, LibraryPool* server_pool, const std::vector<std::string>& ld_library_paths) {
+    std::vector<char*> argv_buf;
+    for (const std::string& arg : args) argv_buf.push_back(const_cast<char*>(arg.c_str()));
+    argv_buf.push_back(nullptr);
+    const int argc = args.size();
+    char* const* argv = argv_buf.data();
+    // Reinitialize getopt for each request in a server.
+    optind = 0;
 
     static option long_options[] = {
         {"help", no_argument, nullptr, 'h'},
@@ -42,37 +222,91 @@ int main(int argc, char* const argv[]) {
         {"output-file", required_argument, nullptr, 'o'},
         {"exclude-so", required_argument, nullptr, 'e'},
         {"custom-library-path", required_argument, nullptr, 'L'},
+        {"jobs", required_argument, nullptr, 'j'},
         {"section-headers", no_argument, nullptr, 1},
         {"check-output", no_argument, nullptr, 2},
         {"exclude-from-fini", required_argument, nullptr, 3},
+        {"metadata-cache-dir", required_argument, nullptr, 4},
+        {"cache-dir", required_argument, nullptr, 5},
+        {"cache-size", required_argument, nullptr, 6},
+        {"cache-stats", no_argument, nullptr, 7},
+        {"batch", required_argument, nullptr, 8},
+        {"memory-budget", required_argument, nullptr, 9},
+        {"incremental", no_argument, nullptr, 10},
+        {"stable-layout", no_argument, nullptr, 11},
+        {"server", required_argument, nullptr, 12},
+        {"connect", required_argument, nullptr, 13},
+        {"validate-eh-frame", no_argument, nullptr, 14},
         {0, 0, 0, 0},
     };
 
     std::string input_file;
     std::string output_file;
-    std::vector<std::string> exclude_sos;
-    std::vector<std::string> exclude_finis;
-    std::vector<std::string> custome_library_path;
-    bool emit_section_header = false;
-    bool check_output = false;
+    Options opts;
+    opts.ld_library_paths = ld_library_paths;
+    std::string metadata_cache_dir;
+    std::string server_socket;
+    std::string connect_socket;
+    bool cache_stats = false;
+    std::string batch;
+    int num_jobs = std::max(1U, std::thread::hardware_concurrency());
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "hi:o:e:", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "hi:o:e:j:", long_options, nullptr)) != -1) {
         switch (opt) {
             case 1:
-                emit_section_header = true;
+                opts.emit_section_header = true;
                 break;
             case 2:
-                check_output = true;
+                opts.check_output = true;
                 break;
             case 3:
-                exclude_finis.push_back(optarg);
+                opts.exclude_finis.push_back(optarg);
+                break;
+            case 4:
+                metadata_cache_dir = optarg;
+                break;
+            case 5:
+                opts.cache_dir = optarg;
+                break;
+            case 6:
+                if (!ParseSize(optarg, &opts.cache_size)) {
+                    std::cerr << "Invalid --cache-size: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 7:
+                cache_stats = true;
+                break;
+            case 8:
+                batch = optarg;
+                break;
+            case 9:
+                if (!ParseSize(optarg, &opts.memory_budget)) {
+                    std::cerr << "Invalid --memory-budget: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 10:
+                opts.incremental = true;
+                break;
+            case 11:
+                opts.stable_layout = true;
+                break;
+            case 12:
+                server_socket = optarg;
+                break;
+            case 13:
+                connect_socket = optarg;
+                break;
+            case 14:
+                opts.validate_eh_frame = true;
                 break;
             case 'e':
-                exclude_sos.push_back(optarg);
+                opts.exclude_sos.push_back(optarg);
                 break;
             case 'L':
-                custome_library_path.emplace_back(optarg);
+                opts.custome_library_path.emplace_back(optarg);
                 break;
             case 'i':
                 input_file = optarg;
@@ -80,6 +314,13 @@ int main(int argc, char* const argv[]) {
             case 'o':
                 output_file = optarg;
                 break;
+            case 'j':
+                num_jobs = atoi(optarg);
+                if (num_jobs <= 0) {
+                    std::cerr << "Invalid --jobs: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
             case 'h':
                 print_help(std::cout);
                 return 0;
@@ -93,19 +334,72 @@ int main(int argc, char* const argv[]) {
         input_file = argv[optind++];
     }
 
+    if (server_pool) {
+        // --connect is the request itself.
+        if (!server_socket.empty()) {
+            std::cerr << "--server cannot be requested to a server." << std::endl;
+            return 1;
+        }
+        if (!metadata_cache_dir.empty()) std::cerr << "--metadata-cache-dir is ignored. Give it to --server instead." << std::endl;
+    } else if (!server_socket.empty()) {
+        LibraryPool pool(AbsolutePath(metadata_cache_dir));
+        return RunServer(server_socket, &pool, [&pool](const std::vector<std::string>& args, const std::vector<std::string>& ld_library_paths) {
+            return Run(args, &pool, ld_library_paths);
+        });
+    } else if (!connect_socket.empty()) {
+        int code;
+        if (RunClient(connect_socket, args, &code)) return code;
+        LOG(INFO) << "No server on " << connect_socket << ", linking locally";
+    }
+
+    if (cache_stats) {
+        if (opts.cache_dir.empty()) {
+            std::cerr << "--cache-stats requires --cache-dir." << std::endl;
+            return 1;
+        }
+        std::cout << OutputCache(opts.cache_dir, opts.cache_size).ShowStats();
+        return 0;
+    }
+
+    if (opts.incremental && !opts.cache_dir.empty()) {
+        std::cerr << "--incremental cannot be used with --cache-dir." << std::endl;
+        return 1;
+    }
+    if (opts.incremental && opts.stable_layout) {
+        std::cerr << "--incremental cannot be used with --stable-layout." << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<LibraryPool> local_pool;
+    LibraryPool* pool = server_pool;
+    if (!pool) {
+        local_pool.reset(new LibraryPool(metadata_cache_dir));
+        pool = local_pool.get();
+    }
+
+    if (!batch.empty()) {
+        std::vector<std::pair<std::string, std::string>> jobs;
+        if (!ReadBatchJobs(batch, output_file, &jobs)) return 1;
+        return RunBatch(opts, pool, jobs, num_jobs) ? 0 : 1;
+    }
+
+    if (output_file == "" && opts.check_output && !input_file.empty()) {
+        return VerifyOutput(input_file) ? 0 : 1;
+    }
     if (output_file == "") {
         std::cerr << "You must specify the output file." << std::endl;
         return 1;
     }
+    // ReadELF exits on errors, which would kill a server.
+    if (access(input_file.c_str(), R_OK) != 0) {
+        std::cerr << "Cannot read the input file " << input_file << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
 
-    Sold sold(input_file, exclude_sos, exclude_finis, custome_library_path, emit_section_header);
-    sold.Link(output_file);
+    return LinkOne(opts, pool, input_file, output_file) ? 0 : 1;
+}
 
-    if (check_output) {
-        std::string dummy = output_file + ".dummy-for-check-output";
-        Sold check(output_file, exclude_sos, exclude_finis, custome_library_path, emit_section_header);
-        check.Link(dummy);
-        std::remove(dummy.c_str());
-    }
-    return 0;
+int main(int argc, char* const argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    return Run(std::vector<std::string>(argv, argv + argc), nullptr, Sold::GetLdLibraryPathsFromEnv());
 }
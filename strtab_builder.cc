@@ -15,33 +15,121 @@
 
 #include "strtab_builder.h"
 
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
 #include "utils.h"
 
-uintptr_t StrtabBuilder::Add(const std::string& s) {
-    std::string t = s;
+namespace {
+
+constexpr size_t kArenaChunkSize = 64 * 1024;
+
+bool EndsWith(std::string_view s, std::string_view suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+std::string_view StrtabBuilder::Rename(std::string_view s) const {
     auto it = rename_mapping_.find(s);
-    if (it != rename_mapping_.end()) t = it->second;
+    return it == rename_mapping_.end() ? s : std::string_view(it->second);
+}
 
+std::string_view StrtabBuilder::Store(std::string_view s) {
+    if (s.size() > arena_left_) {
+        const size_t chunk_size = std::max(kArenaChunkSize, s.size());
+        arena_.emplace_back(new char[chunk_size]);
+        arena_cur_ = arena_.back().get();
+        arena_left_ = chunk_size;
+    }
+    memcpy(arena_cur_, s.data(), s.size());
+    std::string_view stored(arena_cur_, s.size());
+    arena_cur_ += s.size();
+    arena_left_ -= s.size();
+    return stored;
+}
+
+uintptr_t StrtabBuilder::Add(std::string_view s) {
     CHECK(!is_freezed_);
-    if (cache.find(t) != cache.end()) {
-        return cache[t];
+    s = Rename(s);
+    auto found = index_.find(s);
+    if (found != index_.end()) {
+        return entries_[found->second].pos;
     }
-    uintptr_t pos = static_cast<uintptr_t>(strtab_.size());
-    strtab_ += t;
-    strtab_ += '\0';
-    cache[t] = pos;
+    const uintptr_t pos = unmerged_size_;
+    const std::string_view stored = Store(s);
+    index_.emplace(stored, entries_.size());
+    entries_.push_back(Entry{stored, pos, pos});
+    unmerged_size_ += s.size() + 1;
     return pos;
 }
 
-uintptr_t StrtabBuilder::GetPos(const std::string& s) {
-    std::string t = s;
-    auto it = rename_mapping_.find(s);
-    if (it != rename_mapping_.end()) t = it->second;
-
-    if (cache.find(t) != cache.end()) {
-        return cache[t];
-    } else {
-        LOG(FATAL) << t << " is not in StrtabBuilder.";
+uintptr_t StrtabBuilder::GetPos(std::string_view s) const {
+    s = Rename(s);
+    auto found = index_.find(s);
+    if (found == index_.end()) {
+        LOG(FATAL) << s << " is not in StrtabBuilder.";
         exit(1);
     }
+    const Entry& e = entries_[found->second];
+    return is_freezed_ ? e.final_pos : e.pos;
+}
+
+uintptr_t StrtabBuilder::Translate(uintptr_t pos) const {
+    CHECK(is_freezed_);
+    auto found = std::lower_bound(entries_.begin(), entries_.end(), pos, [](const Entry& e, uintptr_t p) { return e.pos < p; });
+    CHECK(found != entries_.end() && found->pos == pos) << "No string starts at " << pos << " in StrtabBuilder.";
+    return found->final_pos;
+}
+
+// MergeTails sets owner[i] to the entry whose bytes hold the i-th string.
+// Sorted by reversed text, all strings which end with `s` immediately follow
+// `s`, so it is enough to compare each string with the last kept one while
+// walking the sorted list backwards.
+void StrtabBuilder::MergeTails(std::vector<size_t>& owner) const {
+    std::vector<size_t> order;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        // Keep the empty string on its own byte so offset 0 stays "".
+        if (!entries_[i].str.empty()) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        const std::string_view x = entries_[a].str;
+        const std::string_view y = entries_[b].str;
+        return std::lexicographical_compare(x.rbegin(), x.rend(), y.rbegin(), y.rend());
+    });
+
+    const size_t kNone = entries_.size();
+    size_t last = kNone;
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        if (last != kNone && EndsWith(entries_[last].str, entries_[*it].str)) {
+            owner[*it] = last;
+        } else {
+            last = *it;
+        }
+    }
+}
+
+void StrtabBuilder::Freeze() {
+    if (is_freezed_) return;
+    is_freezed_ = true;
+
+    std::vector<size_t> owner(entries_.size());
+    std::iota(owner.begin(), owner.end(), 0);
+    if (merge_tails_) MergeTails(owner);
+
+    strtab_.reserve(unmerged_size_);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (owner[i] != i) continue;
+        entries_[i].final_pos = strtab_.size();
+        strtab_.append(entries_[i].str);
+        strtab_ += '\0';
+    }
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& o = entries_[owner[i]];
+        entries_[i].final_pos = o.final_pos + o.str.size() - entries_[i].str.size();
+    }
+    if (merge_tails_) {
+        LOG(INFO) << "StrtabBuilder: merged tails " << unmerged_size_ << " => " << strtab_.size() << " bytes";
+    }
 }
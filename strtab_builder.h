@@ -15,28 +15,64 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+// StrtabBuilder builds a string table such as .dynstr. Each string is copied
+// once into an arena and deduplicated through a hash map of views into it.
+// Freeze lays the table out. With SetMergeTails, a string which is a suffix
+// of another one (e.g. "foo" in "_Zfoo") shares its bytes, so offsets
+// returned by Add must be converted with Translate after Freeze.
 class StrtabBuilder {
 public:
     StrtabBuilder() {}
-    StrtabBuilder(std::map<std::string, std::string> rename_mapping) : rename_mapping_(rename_mapping) {}
+    StrtabBuilder(const std::map<std::string, std::string>& rename_mapping)
+        : rename_mapping_(rename_mapping.begin(), rename_mapping.end()) {}
 
-    uintptr_t Add(const std::string& s);
+    // Add returns the offset of `s` in the table without tail merging.
+    uintptr_t Add(std::string_view s);
 
-    uintptr_t GetPos(const std::string& s);
+    // GetPos returns the offset of an added string. After Freeze, it is the
+    // offset in the final table.
+    uintptr_t GetPos(std::string_view s) const;
 
-    void Freeze() { is_freezed_ = true; }
+    // Translate maps an offset returned by Add to the final table.
+    uintptr_t Translate(uintptr_t pos) const;
 
-    size_t size() const { return strtab_.size(); }
+    void SetMergeTails(bool merge_tails) { merge_tails_ = merge_tails; }
+
+    void Freeze();
+
+    size_t size() const { return is_freezed_ ? strtab_.size() : unmerged_size_; }
 
     const void* data() const { return strtab_.data(); }
 
 private:
+    struct Entry {
+        std::string_view str;
+        uintptr_t pos;
+        uintptr_t final_pos;
+    };
+
+    std::string_view Rename(std::string_view s) const;
+    std::string_view Store(std::string_view s);
+    void MergeTails(std::vector<size_t>& owner) const;
+
+    // Entries in the order of Add, so `pos` is increasing.
+    std::vector<Entry> entries_;
+    std::unordered_map<std::string_view, size_t> index_;
+    std::vector<std::unique_ptr<char[]>> arena_;
+    char* arena_cur_{nullptr};
+    size_t arena_left_{0};
+    uintptr_t unmerged_size_{0};
+
     std::string strtab_;
-    std::map<std::string, uintptr_t> cache;
     bool is_freezed_{false};
-    const std::map<std::string, std::string> rename_mapping_;
+    bool merge_tails_{false};
+    const std::map<std::string, std::string, std::less<>> rename_mapping_;
 };
@@ -19,7 +19,8 @@
 #include <algorithm>
 #include <functional>
 #include <limits>
-#include <set>
+#include <numeric>
+#include <tuple>
 
 SymtabBuilder::SymtabBuilder() {
     Syminfo si;
@@ -28,26 +29,96 @@ SymtabBuilder::SymtabBuilder() {
     si.version = "";
     si.versym = VER_NDX_LOCAL;
     si.sym = NULL;
+    si.gnu_hash = GnuHashKey(si.name);
 
     Symbol sym{};
 
     AddSym(si);
-    CHECK(syms_.emplace(std::make_tuple("", "", ""), sym).second);
+    AddName(si.name, si.gnu_hash)->resolved.push_back(ResolvedSym{"", "", sym});
+}
+
+SymtabBuilder::SrcSym* SymtabBuilder::NameEntry::FindSrc(const std::string& soname, const std::string& version) {
+    for (SrcSym& s : srcs) {
+        if (s.soname == soname && s.version == version) return &s;
+    }
+    return nullptr;
+}
+
+SymtabBuilder::Symbol* SymtabBuilder::NameEntry::FindResolved(const std::string& soname, const std::string& version) {
+    for (ResolvedSym& r : resolved) {
+        if (r.soname == soname && r.version == version) return &r.sym;
+    }
+    return nullptr;
+}
+
+// The Bloom filter sets two bits for each name like .gnu.hash does.
+bool SymtabBuilder::BloomMayContain(uint32_t gnu_hash) const {
+    const uint64_t word = bloom_[(gnu_hash >> 7) & (bloom_.size() - 1)];
+    return (word >> ((gnu_hash >> 1) & 63) & 1) && (word >> ((gnu_hash >> 26) & 63) & 1);
+}
+
+SymtabBuilder::NameEntry* SymtabBuilder::FindName(const std::string& name, uint32_t gnu_hash) {
+    if (slots_.empty() || !BloomMayContain(gnu_hash)) return nullptr;
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = SlotHash(gnu_hash) & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots_[i];
+        if (!slot.entry) return nullptr;
+        if (slot.gnu_hash == gnu_hash && names_[slot.entry - 1].name == name) return &names_[slot.entry - 1];
+    }
+}
+
+SymtabBuilder::NameEntry* SymtabBuilder::AddName(const std::string& name, uint32_t gnu_hash) {
+    CHECK(names_.size() < std::numeric_limits<uint32_t>::max());
+    names_.emplace_back();
+    names_.back().name = name;
+    names_.back().gnu_hash = gnu_hash;
+    // Keep the load factor at most 1/2.
+    if (names_.size() * 2 > slots_.size()) {
+        Rehash(std::max<size_t>(slots_.size() * 2, 1024));
+    } else {
+        InsertSlot(names_.size() - 1);
+    }
+    return &names_.back();
+}
+
+SymtabBuilder::NameEntry* SymtabBuilder::FindOrAddName(const std::string& name, uint32_t gnu_hash) {
+    NameEntry* e = FindName(name, gnu_hash);
+    return e ? e : AddName(name, gnu_hash);
+}
+
+void SymtabBuilder::InsertSlot(size_t n) {
+    const uint32_t gnu_hash = names_[n].gnu_hash;
+    const size_t mask = slots_.size() - 1;
+    size_t i = SlotHash(gnu_hash) & mask;
+    while (slots_[i].entry) i = (i + 1) & mask;
+    slots_[i] = Slot{gnu_hash, static_cast<uint32_t>(n + 1)};
+    bloom_[(gnu_hash >> 7) & (bloom_.size() - 1)] |= (uint64_t{1} << ((gnu_hash >> 1) & 63)) | (uint64_t{1} << ((gnu_hash >> 26) & 63));
+}
+
+// Rehash rebuilds the table and the Bloom filter, which has 4 bits per slot.
+void SymtabBuilder::Rehash(size_t capacity) {
+    slots_.assign(capacity, Slot{0, 0});
+    bloom_.assign(capacity / 16, 0);
+    for (size_t n = 0; n < names_.size(); ++n) InsertSlot(n);
 }
 
 void SymtabBuilder::SetSrcSyms(std::vector<Syminfo> syms) {
     for (const auto& s : syms) {
-        auto found = src_syms_.find({s.name, s.soname, s.version});
+        NameEntry* e = FindOrAddName(s.name, s.gnu_hash);
+        SrcSym src{s.soname, s.version, s.versym, s.sym};
+
         // TODO(akirakawata) Do we need this if? LoadDynSymtab should returns
-        // unique symbols therefore found == src_syms_.end() is true always.
-        if (found == src_syms_.end() || found->second.second == NULL || !IsDefined(*found->second.second)) {
-            src_syms_[{s.name, s.soname, s.version}] = {s.versym, s.sym};
+        // unique symbols therefore found == nullptr is true always.
+        SrcSym* found = e->FindSrc(s.soname, s.version);
+        if (found == nullptr) {
+            e->srcs.push_back(src);
+        } else if (found->sym == NULL || !IsDefined(*found->sym)) {
+            *found = src;
         }
 
-        auto found_fallback = src_fallback_syms_.find(s.name);
-        if ((s.versym & VERSYM_HIDDEN) == 0 && (found_fallback == src_fallback_syms_.end() || found_fallback->second.second == NULL ||
-                                                !IsDefined(*found_fallback->second.second))) {
-            src_fallback_syms_[s.name] = {s.versym, s.sym};
+        if ((s.versym & VERSYM_HIDDEN) == 0 && (!e->has_fallback || e->fallback.sym == NULL || !IsDefined(*e->fallback.sym))) {
+            e->has_fallback = true;
+            e->fallback = src;
         }
     }
 }
@@ -64,7 +135,8 @@ uintptr_t SymtabBuilder::AddSym(const Syminfo& sym) {
 // to sym_ and exposed_syms_ and fills the index of the added symbol to
 // val_or_index.
 // TODO(akawashiro) Rename syms_.
-bool SymtabBuilder::Resolve(const std::string& name, const std::string& soname, const std::string version, uintptr_t& val_or_index) {
+bool SymtabBuilder::Resolve(const std::string& name, uint32_t gnu_hash, const std::string& soname, const std::string version,
+                            uintptr_t& val_or_index) {
     Symbol sym{};
     sym.sym.st_name = 0;
     sym.sym.st_info = 0;
@@ -73,25 +145,23 @@ bool SymtabBuilder::Resolve(const std::string& name, const std::string& soname,
     sym.sym.st_value = 0;
     sym.sym.st_size = 0;
 
-    auto found = syms_.find({name, soname, version});
-    if (found != syms_.end()) {
-        sym = found->second;
+    NameEntry* e = FindName(name, gnu_hash);
+    Symbol* found = e ? e->FindResolved(soname, version) : nullptr;
+    if (found) {
+        sym = *found;
     } else {
         Elf_Versym versym = 0;
         Elf_Sym* symp = nullptr;
 
-        {
-            auto found = src_syms_.find({name, soname, version});
-            if (found != src_syms_.end()) {
-                versym = found->second.first;
-                symp = found->second.second;
-            } else {
-                auto found_fallback = src_fallback_syms_.find(name);
-                if (found_fallback != src_fallback_syms_.end()) {
-                    LOG(INFO) << "Use fallback version of " << name;
-                    versym = found_fallback->second.first;
-                    symp = found_fallback->second.second;
-                }
+        if (e) {
+            const SrcSym* src = e->FindSrc(soname, version);
+            if (src == nullptr && e->has_fallback) {
+                LOG(INFO) << "Use fallback version of " << name;
+                src = &e->fallback;
+            }
+            if (src != nullptr) {
+                versym = src->versym;
+                symp = src->sym;
             }
         }
 
@@ -101,15 +171,16 @@ bool SymtabBuilder::Resolve(const std::string& name, const std::string& soname,
                 LOG(INFO) << "Symbol (" << name << ", " << soname << ", " << version << ") found";
             } else {
                 LOG(INFO) << "Symbol (undef/weak) (" << name << ", " << soname << ", " << version << ") found";
-                Syminfo s{name, soname, version, versym, NULL};
+                Syminfo s{name, soname, version, versym, NULL, gnu_hash};
                 sym.index = AddSym(s);
-                CHECK(syms_.emplace(std::make_tuple(name, soname, version), sym).second);
+                e->resolved.push_back(ResolvedSym{soname, version, sym});
             }
         } else {
             LOG(INFO) << "Symbol (" << name << ", " << soname << ", " << version << ") not found";
-            Syminfo s{name, soname, version, VER_NDX_LOCAL, NULL};
+            Syminfo s{name, soname, version, VER_NDX_LOCAL, NULL, gnu_hash};
             sym.index = AddSym(s);
-            CHECK(syms_.emplace(std::make_tuple(name, soname, version), sym).second);
+            if (!e) e = AddName(name, gnu_hash);
+            e->resolved.push_back(ResolvedSym{soname, version, sym});
         }
     }
 
@@ -123,7 +194,7 @@ bool SymtabBuilder::Resolve(const std::string& name, const std::string& soname,
 }
 
 // Returns the index of symbol(name, soname, version)
-uintptr_t SymtabBuilder::ResolveCopy(const std::string& name, const std::string& soname, const std::string version) {
+uintptr_t SymtabBuilder::ResolveCopy(const std::string& name, uint32_t gnu_hash, const std::string& soname, const std::string version) {
     // TODO(hamaji): Refactor.
     Symbol sym{};
     sym.sym.st_name = 0;
@@ -133,34 +204,32 @@ uintptr_t SymtabBuilder::ResolveCopy(const std::string& name, const std::string&
     sym.sym.st_value = 0;
     sym.sym.st_size = 0;
 
-    auto found = syms_.find({name, soname, version});
-    if (found != syms_.end()) {
-        sym = found->second;
+    NameEntry* e = FindName(name, gnu_hash);
+    Symbol* found = e ? e->FindResolved(soname, version) : nullptr;
+    if (found) {
+        sym = *found;
     } else {
         Elf_Versym versym = 0;
         Elf_Sym* symp = nullptr;
 
-        {
-            auto found = src_syms_.find({name, soname, version});
-            if (found != src_syms_.end()) {
-                versym = found->second.first;
-                symp = found->second.second;
-            } else {
-                auto found_fallback = src_fallback_syms_.find(name);
-                if (found_fallback != src_fallback_syms_.end()) {
-                    LOG(INFO) << "Use fallback version of " << name;
-                    versym = found_fallback->second.first;
-                    symp = found_fallback->second.second;
-                }
+        if (e) {
+            const SrcSym* src = e->FindSrc(soname, version);
+            if (src == nullptr && e->has_fallback) {
+                LOG(INFO) << "Use fallback version of " << name;
+                src = &e->fallback;
+            }
+            if (src != nullptr) {
+                versym = src->versym;
+                symp = src->sym;
             }
         }
 
         if (symp != nullptr) {
             LOG(INFO) << "Symbol " << name << " found for copy";
             sym.sym = *symp;
-            Syminfo s{name, soname, version, versym, NULL};
+            Syminfo s{name, soname, version, versym, NULL, gnu_hash};
             sym.index = AddSym(s);
-            CHECK(syms_.emplace(std::make_tuple(name, soname, version), sym).second);
+            e->resolved.push_back(ResolvedSym{soname, version, sym});
         } else {
             LOG(INFO) << "Symbol " << name << " not found for copy";
             CHECK(false);
@@ -170,14 +239,42 @@ uintptr_t SymtabBuilder::ResolveCopy(const std::string& name, const std::string&
     return sym.index;
 }
 
+std::vector<uintptr_t> SymtabBuilder::Sort() {
+    CHECK(symtab_.empty());
+    auto key = [](const Syminfo& s) { return std::tie(s.name, s.soname, s.version); };
+    auto less = [&key](const Syminfo& a, const Syminfo& b) { return key(a) < key(b); };
+
+    // The first one is the null symbol.
+    std::vector<uintptr_t> order(exposed_syms_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin() + 1, order.end(), [this, &less](uintptr_t a, uintptr_t b) { return less(exposed_syms_[a], exposed_syms_[b]); });
+
+    std::vector<uintptr_t> old_to_new(order.size());
+    std::vector<Syminfo> sorted;
+    for (uintptr_t old_index : order) {
+        old_to_new[old_index] = sorted.size();
+        sorted.push_back(exposed_syms_[old_index]);
+    }
+    exposed_syms_.swap(sorted);
+    for (NameEntry& e : names_) {
+        for (ResolvedSym& r : e.resolved) r.sym.index = old_to_new[r.sym.index];
+    }
+
+    // Public symbols are not referenced by relocations. Keep the first one
+    // of duplicated symbols as MergePublicSymbols does.
+    std::stable_sort(public_syms_.begin(), public_syms_.end(), less);
+    return old_to_new;
+}
+
 // Make a new symbol table(symtab_) from exposed_syms_.
 void SymtabBuilder::Build(StrtabBuilder& strtab, VersionBuilder& version) {
     for (const Syminfo& s : exposed_syms_) {
         LOG(INFO) << "SymtabBuilder::Build " << SOLD_LOG_KEY(s);
 
-        auto found = syms_.find({s.name, s.soname, s.version});
-        CHECK(found != syms_.end());
-        Elf_Sym sym = found->second.sym;
+        NameEntry* e = FindName(s.name, s.gnu_hash);
+        Symbol* found = e ? e->FindResolved(s.soname, s.version) : nullptr;
+        CHECK(found);
+        Elf_Sym sym = found->sym;
         sym.st_name = strtab.Add(s.name);
         // TODO(akawashiro)
         // I fill st_shndx with a dummy value which is not special section index.
@@ -189,6 +286,12 @@ void SymtabBuilder::Build(StrtabBuilder& strtab, VersionBuilder& version) {
     }
 }
 
+void SymtabBuilder::TranslateNames(const StrtabBuilder& strtab) {
+    for (Elf_Sym& sym : symtab_) {
+        sym.st_name = strtab.Translate(sym.st_name);
+    }
+}
+
 // Pushes all public_syms_ into exposed_syms_ and symtab_.
 // TODO(akawashiro) Do we need changing exposed_syms_ here?
 void SymtabBuilder::MergePublicSymbols(StrtabBuilder& strtab, VersionBuilder& version) {
@@ -203,10 +306,17 @@ void SymtabBuilder::MergePublicSymbols(StrtabBuilder& strtab, VersionBuilder& ve
     gnu_hash_.maskwords = 1;
     gnu_hash_.shift2 = 1;
 
-    // exposed_sym_name_vers is used to avoid duplicated symbol
-    std::set<std::tuple<std::string, std::string, std::string>> exposed_sym_name_vers;
+    // NameEntry::exposed is used to avoid duplicated symbol
+    auto insert_exposed = [this](const Syminfo& s) {
+        std::vector<std::pair<std::string, std::string>>& exposed = FindOrAddName(s.name, s.gnu_hash)->exposed;
+        for (const auto& p : exposed) {
+            if (p.first == s.soname && p.second == s.version) return false;
+        }
+        exposed.emplace_back(s.soname, s.version);
+        return true;
+    };
     for (const Syminfo& s : exposed_syms_) {
-        CHECK(exposed_sym_name_vers.insert({s.name, s.soname, s.version}).second) << SOLD_LOG_KEY(s.name);
+        CHECK(insert_exposed(s)) << SOLD_LOG_KEY(s.name);
     }
 
     for (const auto& p : public_syms_) {
@@ -221,9 +331,9 @@ void SymtabBuilder::MergePublicSymbols(StrtabBuilder& strtab, VersionBuilder& ve
         // After I make complete section headers, I should fill it with the right section index.
         sym->st_shndx = 1;
 
-        Syminfo s{p.name, p.soname, p.version, p.versym, sym};
+        Syminfo s{p.name, p.soname, p.version, p.versym, sym, p.gnu_hash};
 
-        if (exposed_sym_name_vers.insert({s.name, s.soname, s.version}).second) {
+        if (insert_exposed(s)) {
             exposed_syms_.push_back(s);
             symtab_.push_back(*sym);
 
@@ -15,7 +15,7 @@
 
 #pragma once
 
-#include <map>
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -30,14 +30,24 @@ public:
 
     void SetSrcSyms(std::vector<Syminfo> syms);
 
-    bool Resolve(const std::string& name, const std::string& filename, const std::string version_name, uintptr_t& val_or_index);
+    // `gnu_hash` must be GnuHashKey(name).
+    bool Resolve(const std::string& name, uint32_t gnu_hash, const std::string& filename, const std::string version_name,
+                 uintptr_t& val_or_index);
 
-    uintptr_t ResolveCopy(const std::string& name, const std::string& filename, const std::string version_name);
+    uintptr_t ResolveCopy(const std::string& name, uint32_t gnu_hash, const std::string& filename, const std::string version_name);
+
+    // Sort orders symbols by (name, soname, version) so that the output does
+    // not depend on the order of references. Returns the map from old indices
+    // to new ones, which must be applied to relocations.
+    std::vector<uintptr_t> Sort();
 
     void Build(StrtabBuilder& strtab, VersionBuilder& version);
 
     void MergePublicSymbols(StrtabBuilder& strtab, VersionBuilder& version);
 
+    // TranslateNames updates st_name of symtab_ once strtab is frozen.
+    void TranslateNames(const StrtabBuilder& strtab);
+
     void AddPublicSymbol(Syminfo s) { public_syms_.push_back(s); }
 
     uintptr_t size() const { return symtab_.size() + public_syms_.size(); }
@@ -56,12 +66,59 @@ private:
         uintptr_t index;
     };
 
-    // map from (name, soname, version) to (Versym, Sym*)
-    std::map<std::tuple<std::string, std::string, std::string>, std::pair<Elf_Versym, Elf_Sym*> > src_syms_;
-    // map from name to (Versym, Sym*)
-    // We use src_fallback_syms_ when we don't have version information.
-    std::map<std::string, std::pair<Elf_Versym, Elf_Sym*> > src_fallback_syms_;
-    std::map<std::tuple<std::string, std::string, std::string>, Symbol> syms_;
+    struct SrcSym {
+        std::string soname;
+        std::string version;
+        Elf_Versym versym;
+        Elf_Sym* sym;
+    };
+
+    struct ResolvedSym {
+        std::string soname;
+        std::string version;
+        Symbol sym;
+    };
+
+    // NameEntry holds everything about a symbol name. Names have only a few
+    // versions, so they are searched linearly.
+    struct NameEntry {
+        std::string name;
+        uint32_t gnu_hash{0};
+        // Symbols of the inputs by (soname, version).
+        std::vector<SrcSym> srcs{};
+        // We use the fallback when we don't have version information.
+        bool has_fallback{false};
+        SrcSym fallback{};
+        // Symbols resolved for the output by (soname, version).
+        std::vector<ResolvedSym> resolved{};
+        // (soname, version) in exposed_syms_. Used by MergePublicSymbols.
+        std::vector<std::pair<std::string, std::string>> exposed{};
+
+        SrcSym* FindSrc(const std::string& soname, const std::string& version);
+        Symbol* FindResolved(const std::string& soname, const std::string& version);
+    };
+
+    // FindName and AddName look up names_ through an open-addressing table
+    // keyed on the GNU hash of names, which the inputs already have in
+    // .gnu.hash. A Bloom filter in front of the table answers most lookups of
+    // names only in excluded libraries without probing the table.
+    NameEntry* FindName(const std::string& name, uint32_t gnu_hash);
+    NameEntry* AddName(const std::string& name, uint32_t gnu_hash);
+    NameEntry* FindOrAddName(const std::string& name, uint32_t gnu_hash);
+    bool BloomMayContain(uint32_t gnu_hash) const;
+    void InsertSlot(size_t n);
+    void Rehash(size_t capacity);
+    static uint32_t SlotHash(uint32_t gnu_hash) { return gnu_hash * 0x9e3779b1; }
+
+    struct Slot {
+        uint32_t gnu_hash;
+        // 1 + the index in names_, or 0 for an empty slot.
+        uint32_t entry;
+    };
+
+    std::deque<NameEntry> names_;
+    std::vector<Slot> slots_;
+    std::vector<uint64_t> bloom_;
 
     std::vector<Syminfo> exposed_syms_;
     std::vector<Elf_Sym> symtab_;
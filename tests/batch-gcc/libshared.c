@@ -0,0 +1,5 @@
+int ver_value(void);
+
+int shared_value(void) {
+    return ver_value() + 2;
+}
@@ -0,0 +1,3 @@
+int ver_value(void) {
+    return 40;
+}
@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+int shared_value(void);
+
+int main() {
+    printf("%s %d\n", NAME, shared_value());
+    return 0;
+}
@@ -0,0 +1,32 @@
+#! /bin/bash -eu
+
+# Links two executables and a library sharing libshared.so and the
+# versioned libver.so.1 in one --batch run, and compares the outputs with
+# links in separate processes.
+gcc -fPIC -shared -Wl,-soname,libver.so.1 -Wl,--version-script,libver.map -o libver.so.1 libver.c
+gcc -fPIC -shared -Wl,-soname,libshared.so -o libshared.so libshared.c libver.so.1
+gcc -Wl,--hash-style=gnu -DNAME='"main1"' -o main1.out main.c libshared.so -Wl,-rpath-link,.
+gcc -Wl,--hash-style=gnu -DNAME='"main2"' -o main2.out main.c libshared.so -Wl,-rpath-link,.
+
+rm -rf out libs libs_out
+mkdir -p out libs libs_out
+cp libshared.so libs/
+cat > manifest <<EOS
+# Executables
+main1.out out/main1.soldout
+main2.out out/main2.soldout
+EOS
+
+LD_LIBRARY_PATH=. ../../build/sold --batch manifest -j 2 --section-headers --check-output
+test "$(./out/main1.soldout)" = "main1 42"
+test "$(./out/main2.soldout)" = "main2 42"
+
+LD_LIBRARY_PATH=. ../../build/sold --batch libs -o libs_out --section-headers --check-output
+test -f libs_out/libshared.so
+
+for name in main1 main2; do
+    LD_LIBRARY_PATH=. ../../build/sold $name.out -o out/$name.single.soldout --section-headers
+    cmp out/$name.soldout out/$name.single.soldout
+done
+LD_LIBRARY_PATH=. ../../build/sold libs/libshared.so -o out/libshared.single.so --section-headers
+cmp libs_out/libshared.so out/libshared.single.so
@@ -0,0 +1,5 @@
+int value = 42;
+
+int get_value() {
+    return value;
+}
@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+int get_value();
+
+int main() {
+    printf("%d\n", get_value());
+    return 0;
+}
@@ -0,0 +1,28 @@
+#! /bin/bash -eu
+
+gcc -fPIC -shared -Wl,-soname,libvalue.so -o libvalue.so libvalue.c
+gcc -Wl,--hash-style=gnu -o main.out main.c libvalue.so
+
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --check-output
+./main.soldout
+# Without -o, --check-output only verifies its input.
+../../build/sold --check-output main.soldout
+
+# poke FILE OFFSET HEX_BYTES overwrites bytes of FILE in place.
+poke() {
+    printf "$3" | dd of="$1" bs=1 seek="$2" conv=notrunc status=none
+}
+
+# Point the first relocation of .rela.dyn far out of any PT_LOAD.
+cp main.soldout bad_reloc.soldout
+rela=$(readelf -SW main.soldout | sed -n 's/.*\.rela\.dyn *RELA *[0-9a-f]* \([0-9a-f]*\) .*/\1/p')
+poke bad_reloc.soldout $((16#${rela})) '\xf0\xff\xff\xff\xff\xff\xff\x7f'
+(! ../../build/sold --check-output bad_reloc.soldout 2> bad_reloc.json)
+grep -q '"check":"relocation","address":"0x7FFFFFFFFFFFFFF0","message":"R_X86_64_RELATIVE writes out of writable PT_LOAD"' bad_reloc.json
+
+# Point the FDE of the first .eh_frame_hdr entry far out of the file.
+cp main.soldout bad_eh_frame_hdr.soldout
+eh_frame_hdr=$(readelf -lW main.soldout | sed -n 's/^ *GNU_EH_FRAME *0x\([0-9a-f]*\) .*/\1/p')
+poke bad_eh_frame_hdr.soldout $((16#${eh_frame_hdr} + 16)) '\x00\x00\x00\x40'
+(! ../../build/sold --check-output bad_eh_frame_hdr.soldout 2> bad_eh_frame_hdr.json)
+grep -q '"check":"eh_frame_hdr",.*"message":"FDE of entry 0 is not mapped"' bad_eh_frame_hdr.json
@@ -0,0 +1,11 @@
+// Each name is a suffix of the next one, so .dynstr of the output can keep
+// only the longest one.
+int value(void) {
+    return 1;
+}
+int get_value(void) {
+    return value() + 1;
+}
+int reset_get_value(void) {
+    return get_value() + 1;
+}
@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+int value(void);
+int get_value(void);
+int reset_get_value(void);
+
+int main() {
+    printf("%d %d %d\n", value(), get_value(), reset_get_value());
+    return 0;
+}
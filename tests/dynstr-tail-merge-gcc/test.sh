@@ -0,0 +1,23 @@
+#! /bin/bash -eu
+
+gcc -fPIC -shared -Wl,-soname,libvalue.so -o libvalue.so.original libvalue.c
+gcc -Wl,--hash-style=gnu -o main.out main.c libvalue.so.original
+../../build/sold -i libvalue.so.original -o libvalue.so.soldout --section-headers --check-output
+ln -sf libvalue.so.soldout libvalue.so
+test "$(LD_LIBRARY_PATH=. ./main.out)" = "1 2 3"
+
+# value and get_value are exported but stored only as tails of
+# reset_get_value.
+readelf --dyn-syms -W libvalue.so.soldout | awk '{print $8}' > dynsyms
+grep -qx value dynsyms
+grep -qx get_value dynsyms
+grep -qx reset_get_value dynsyms
+readelf -p .dynstr libvalue.so.soldout | sed -n 's/^ *\[ *[0-9a-f]*\]  //p' > dynstrs
+grep -qx reset_get_value dynstrs
+(! grep -qx get_value dynstrs)
+(! grep -qx value dynstrs)
+
+# DT_STRSZ must be the size of .dynstr after its tails are merged.
+strsz=$(readelf -dW libvalue.so.soldout | sed -n 's/.*(STRSZ) *\([0-9]*\) (bytes)/\1/p')
+dynstr=$(readelf -SW libvalue.so.soldout | sed -n 's/.*\.dynstr *STRTAB *[0-9a-f]* [0-9a-f]* \([0-9a-f]*\) .*/\1/p')
+[ "${strsz}" = "$((16#${dynstr}))" ]
@@ -0,0 +1,6 @@
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+void throw_exception_fuga();
+void catch_exception_fuga();
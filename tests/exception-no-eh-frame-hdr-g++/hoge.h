@@ -0,0 +1,6 @@
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+void throw_exception_hoge();
+void catch_exception_hoge();
@@ -0,0 +1,15 @@
+#! /bin/bash -eu
+
+# The libraries do not have PT_GNU_EH_FRAME, so sold has to build the table
+# of .eh_frame_hdr from their .eh_frame.
+g++ -fPIC -shared -o libfuga.so -Wl,-soname,libfuga.so -Wl,--no-eh-frame-hdr fuga.cc
+g++ -fPIC -shared -o libhoge.so.original -Wl,-soname,libhoge.so -Wl,--no-eh-frame-hdr hoge.cc libfuga.so
+g++ main.cc -o main.out libhoge.so.original libfuga.so
+LD_LIBRARY_PATH=. ../../build/sold -i libhoge.so.original -o libhoge.so.soldout --section-headers --check-output
+
+# Use sold
+ln -sf libhoge.so.soldout libhoge.so
+# Use original
+# ln -sf libhoge.so.original libhoge.so
+
+LD_LIBRARY_PATH=. ./main.out
@@ -0,0 +1,18 @@
+#include "base.h"
+
+static int add_impl(int a, int b) {
+    return a + b;
+}
+
+static void* resolve_add() {
+    return add_impl;
+}
+
+// Calls and pointers to a local ifunc are resolved by R_X86_64_IRELATIVE.
+__attribute__((visibility("hidden"))) int add(int a, int b) __attribute__((ifunc("resolve_add")));
+
+int (*add_ptr)(int, int) = add;
+
+int base_add(int a, int b) {
+    return add(a, b) + add_ptr(a, b);
+}
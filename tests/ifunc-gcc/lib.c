@@ -0,0 +1,5 @@
+#include "lib.h"
+
+int lib_add(int a, int b) {
+    return base_add(a, b);
+}
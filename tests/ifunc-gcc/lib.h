@@ -0,0 +1,3 @@
+#include "base.h"
+
+int lib_add(int a, int b);
@@ -0,0 +1,10 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lib.h"
+
+int main() {
+    if (lib_add(3, 4) != 14) abort();
+    puts("OK");
+    return 0;
+}
@@ -0,0 +1,5 @@
+const char pad[PAD] = {VALUE};
+
+int value(void) {
+    return pad[0] + pad[PAD - 1];
+}
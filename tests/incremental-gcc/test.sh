@@ -0,0 +1,36 @@
+#! /bin/bash -eu
+
+build_lib() {
+    gcc -fPIC -shared -Wl,-soname,libval.so -DVALUE=$1 -DPAD=$2 -o libval.so libval.c
+}
+
+file_offsets() {
+    readelf -lW $1 | awk '$1 == "LOAD" { print $2 }'
+}
+
+build_lib 1 16
+gcc -Wl,--hash-style=gnu -o main.out main.c libval.so
+
+rm -f main.soldout main.soldout.sold-layout
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --incremental --check-output
+test -f main.soldout.sold-layout
+test "$(./main.soldout)" = 1
+file_offsets main.soldout > first.offsets
+
+# The grown library fits in the slack of the previous layout, where a fresh
+# layout would move the segments after it.
+build_lib 2 6000
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --incremental --check-output
+test "$(./main.soldout)" = 2
+file_offsets main.soldout | cmp first.offsets -
+rm -f fresh.soldout fresh.soldout.sold-layout
+LD_LIBRARY_PATH=. ../../build/sold main.out -o fresh.soldout --section-headers --incremental
+(! file_offsets fresh.soldout | cmp -s first.offsets -)
+
+# The library outgrows its slot, so the layout is built from scratch.
+build_lib 3 100000
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --incremental --check-output
+test "$(./main.soldout)" = 3
+rm -f fresh.soldout fresh.soldout.sold-layout
+LD_LIBRARY_PATH=. ../../build/sold main.out -o fresh.soldout --section-headers --incremental
+cmp main.soldout fresh.soldout
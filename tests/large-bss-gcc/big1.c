@@ -0,0 +1,9 @@
+#include <stdio.h>
+
+// 1.5GiB of .bss, which does not take space in the files.
+static char big1[3ULL << 29];
+
+void touch_big1(void) {
+    big1[sizeof(big1) - 1] = 1;
+    printf("big1 %d\n", big1[sizeof(big1) - 1]);
+}
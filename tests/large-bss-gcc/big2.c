@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+// 3GiB of .bss, which does not take space in the files.
+static char big2[3ULL << 30];
+
+// `callback` throws, so the unwinder looks up the FDE of this function,
+// which is 1.5GiB away from the one of main.
+void touch_big2(void (*callback)(void)) {
+    big2[sizeof(big2) - 1] = 1;
+    printf("big2 %d\n", big2[sizeof(big2) - 1]);
+    callback();
+}
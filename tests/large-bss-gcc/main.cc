@@ -0,0 +1,23 @@
+#include <stdio.h>
+
+#include <stdexcept>
+
+extern "C" {
+void touch_big1(void);
+void touch_big2(void (*callback)(void));
+}
+
+static void Throw() {
+    throw std::runtime_error("thrown through big2");
+}
+
+int main() {
+    touch_big1();
+    try {
+        touch_big2(Throw);
+    } catch (const std::runtime_error& e) {
+        printf("caught: %s\n", e.what());
+        return 0;
+    }
+    return 1;
+}
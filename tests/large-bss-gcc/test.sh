@@ -0,0 +1,11 @@
+#! /bin/bash -eu
+
+# The output spans more than 4GiB, so offsets in it do not fit in 32 bits.
+# The FDEs of main and libbig2 are 1.5GiB apart, so .eh_frame_hdr has to be
+# placed before the inputs for its 32 bit entries.
+gcc -fPIC -shared -o libbig1.so -Wl,-soname,libbig1.so big1.c
+gcc -fPIC -fexceptions -shared -o libbig2.so -Wl,-soname,libbig2.so big2.c
+g++ main.cc -o main.out -L. -lbig1 -lbig2
+
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --check-output
+./main.soldout | grep "caught: thrown through big2"
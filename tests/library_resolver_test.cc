@@ -0,0 +1,76 @@
+//
+// library_resolver_test
+//
+// This program checks LibraryResolver finds the library given as the
+// argument through an ld.so.cache in the new format made by ldconfig, and
+// finds it again after it is removed and reinstalled.
+//
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "library_resolver.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, const char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <shared object with DT_SONAME>" << std::endl;
+        return 1;
+    }
+
+    const std::string original = argv[1];
+    const std::string soname = original.substr(original.rfind('/') + 1);
+    Elf_Ehdr ehdr;
+    {
+        std::ifstream ifs(original, std::ios::binary);
+        CHECK(ifs.read(reinterpret_cast<char*>(&ehdr), sizeof(ehdr))) << original;
+    }
+
+    char tmpl[] = "/tmp/library_resolver_testXXXXXX";
+    CHECK(mkdtemp(tmpl)) << strerror(errno);
+    const std::string dir = tmpl;
+    const std::string lib = dir + "/" + soname;
+    const std::string ldsocache = dir + "/ld.so.cache";
+    {
+        std::ofstream conf(dir + "/ld.so.conf");
+        conf << dir << std::endl;
+    }
+    const std::string cp = "cp " + original + " " + lib;
+    CHECK(system(cp.c_str()) == 0) << cp;
+    // -X keeps the symlinks in `dir` as they are.
+    const std::string ldconfig = "/sbin/ldconfig -X -C " + ldsocache + " -f " + dir + "/ld.so.conf";
+    CHECK(system(ldconfig.c_str()) == 0) << ldconfig;
+
+    // The entry is stale until the library is reinstalled. `dir` is not a
+    // search path, so only ld.so.cache can find the library.
+    const std::string moved = lib + ".moved";
+    CHECK(rename(lib.c_str(), moved.c_str()) == 0) << strerror(errno);
+    LibraryResolver resolver(ehdr.e_machine, ldsocache);
+    std::vector<std::string> candidates = resolver.FindCandidates(soname, {}, true);
+    CHECK(candidates.empty()) << candidates[0];
+
+    CHECK(rename(moved.c_str(), lib.c_str()) == 0) << strerror(errno);
+    candidates = resolver.FindCandidates(soname, {}, true);
+    CHECK(candidates.size() == 1 && candidates[0] == lib) << candidates.size();
+
+    const std::string rm = "rm -rf " + dir;
+    CHECK(system(rm.c_str()) == 0) << rm;
+    std::cout << "OK" << std::endl;
+}
@@ -0,0 +1,129 @@
+//
+// libsold_test
+//
+// This program links the executable given as the argument through libsold.h
+// from a file descriptor, from memory and with a resolver, runs the outputs,
+// and checks a broken input is reported as an error.
+//
+// Copyright (C) 2021 The sold authors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "libsold.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include "utils.h"
+
+namespace {
+
+// ReadFile reads `filename` into a buffer aligned to 8 bytes.
+std::vector<uint64_t> ReadFile(const std::string& filename, size_t* size) {
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    CHECK(ifs) << filename;
+    *size = ifs.tellg();
+    std::vector<uint64_t> buf((*size + 7) / 8);
+    ifs.seekg(0);
+    CHECK(ifs.read(reinterpret_cast<char*>(buf.data()), *size)) << filename;
+    return buf;
+}
+
+void WriteAndRun(const std::string& filename, const std::vector<char>& output) {
+    {
+        std::ofstream ofs(filename, std::ios::binary);
+        CHECK(ofs.write(output.data(), output.size())) << filename;
+    }
+    CHECK(chmod(filename.c_str(), 0755) == 0) << filename << ": " << strerror(errno);
+    CHECK(system(filename.c_str()) == 0) << filename << " failed";
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <executable>" << std::endl;
+        return 1;
+    }
+
+    const std::string filename = argv[1];
+    SoldInput input;
+    input.name = filename;
+    input.fd = open(filename.c_str(), O_RDONLY);
+    CHECK(input.fd >= 0) << filename << ": " << strerror(errno);
+
+    // Libraries are found through the runpath ($ORIGIN) of the input.
+    const std::string out_filename = filename + "_libsold";
+    const int out_fd = open(out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    CHECK(out_fd >= 0) << out_filename << ": " << strerror(errno);
+    SoldStatus status = SoldLink(input, SoldOptions(), out_fd);
+    CHECK(status.ok) << status.error;
+    close(out_fd);
+    close(input.fd);
+    CHECK(system(out_filename.c_str()) == 0) << out_filename << " failed";
+
+    // The same input in memory makes the same output.
+    size_t size;
+    const std::vector<uint64_t> exe = ReadFile(filename, &size);
+    std::vector<char> output;
+    status = SoldLink(SoldInput{filename, exe.data(), size}, SoldOptions(), &output);
+    CHECK(status.ok) << status.error;
+    size_t fd_size;
+    const std::vector<uint64_t> fd_output = ReadFile(out_filename, &fd_size);
+    CHECK(fd_size == output.size() && memcmp(fd_output.data(), output.data(), fd_size) == 0) << "outputs differ";
+
+    // A resolver supplies the test libraries from memory, which $ORIGIN of
+    // a name in a missing directory cannot find.
+    const std::string dir = filename.substr(0, filename.rfind('/') + 1);
+    std::map<std::string, std::pair<std::vector<uint64_t>, size_t>> libs;
+    for (const char* lib : {"libtest_lib.so", "libtest_base.so"}) {
+        auto& buf = libs[lib];
+        buf.first = ReadFile(dir + lib, &buf.second);
+    }
+    int num_resolved = 0;
+    SoldOptions options;
+    options.resolver = [&libs, &num_resolved](const std::string& needed, SoldInput* input) {
+        auto found = libs.find(needed);
+        if (found == libs.end()) return false;
+        num_resolved++;
+        *input = SoldInput{"/nonexistent/" + needed, found->second.first.data(), found->second.second};
+        return true;
+    };
+    const SoldInput moved{"/nonexistent/test_exe", exe.data(), size};
+    status = SoldLink(moved, options, &output);
+    CHECK(status.ok) << status.error;
+    WriteAndRun(filename + "_libsold_resolver", output);
+    // The resolver ran in the forked child.
+    CHECK(num_resolved == 0) << num_resolved;
+
+    options.in_process = true;
+    status = SoldLink(moved, options, &output);
+    CHECK(status.ok) << status.error;
+    CHECK(num_resolved == 2) << num_resolved;
+
+    // A broken input must not kill the caller.
+    alignas(8) const char garbage[] = "\x7f" "ELF garbage";
+    status = SoldLink(SoldInput{"garbage", garbage, sizeof(garbage)}, SoldOptions(), &output);
+    CHECK(!status.ok) << "garbage was linked";
+    CHECK(!status.error.empty());
+    std::cout << "garbage: " << status.error << std::endl;
+
+    std::cout << "OK" << std::endl;
+}
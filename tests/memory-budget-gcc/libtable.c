@@ -0,0 +1,12 @@
+static int one(void) { return 1; }
+static int two(void) { return 2; }
+static int three(void) { return 3; }
+
+// Each entry needs a relocation.
+int (*const table[])(void) = {one, two, three, one, two, three};
+
+int sum(void) {
+    int s = 0;
+    for (unsigned i = 0; i < sizeof(table) / sizeof(table[0]); i++) s += table[i]();
+    return s;
+}
@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+int sum(void);
+
+int main() {
+    printf("%d\n", sum());
+    return 0;
+}
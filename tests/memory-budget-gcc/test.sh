@@ -0,0 +1,12 @@
+#! /bin/bash -eu
+
+gcc -fPIC -shared -Wl,-soname,libtable.so -o libtable.so libtable.c
+gcc -Wl,--hash-style=gnu -o main.out main.c libtable.so
+
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --check-output
+test "$(./main.soldout)" = 12
+
+# A budget too small for one relocation spills all of them to a temporary
+# file, which must not change the output.
+LD_LIBRARY_PATH=. ../../build/sold main.out -o budget.soldout --section-headers --memory-budget 1 --check-output
+cmp main.soldout budget.soldout
@@ -0,0 +1,53 @@
+#! /bin/bash -eu
+
+build_lib() {
+    gcc -fPIC -shared -Wl,-soname,libvalue.so -DVALUE=$1 -o libvalue.so libvalue.c
+}
+
+# entry_inode shows the inode of the summary of libvalue.so. A hit keeps
+# the summary and a store replaces it with a new file.
+entry_inode() {
+    stat -c %i $(grep -l "${PWD}/libvalue.so" cache/*.meta)
+}
+
+build_lib 1
+gcc -Wl,--hash-style=gnu -o main.out main.c libvalue.so
+rm -rf cache
+LD_LIBRARY_PATH=. ../../build/sold main.out -o uncached.soldout --section-headers
+
+# A store followed by a hit makes the same output as an uncached link.
+LD_LIBRARY_PATH=. ../../build/sold main.out -o store.soldout --section-headers --metadata-cache-dir cache --check-output
+inode=$(entry_inode)
+LD_LIBRARY_PATH=. ../../build/sold main.out -o hit.soldout --section-headers --metadata-cache-dir cache --check-output
+[ "$(entry_inode)" = "${inode}" ]
+cmp uncached.soldout store.soldout
+cmp uncached.soldout hit.soldout
+
+# A new mtime throws the summary away.
+touch -d "1 hour ago" libvalue.so
+LD_LIBRARY_PATH=. ../../build/sold main.out -o touched.soldout --section-headers --metadata-cache-dir cache
+[ "$(entry_inode)" != "${inode}" ]
+cmp uncached.soldout touched.soldout
+
+# A library rebuilt with different contents of the same size is linked
+# from its new contents.
+build_lib 2
+inode=$(entry_inode)
+LD_LIBRARY_PATH=. ../../build/sold main.out -o rebuilt.soldout --section-headers --metadata-cache-dir cache --check-output
+[ "$(entry_inode)" != "${inode}" ]
+test "$(LD_LIBRARY_PATH=. ./rebuilt.soldout)" = 2
+
+# Concurrent links storing the same summaries see only complete ones.
+rm -rf cache
+pids=
+for i in 1 2 3 4; do
+    LD_LIBRARY_PATH=. ../../build/sold main.out -o concurrent$i.soldout --section-headers --metadata-cache-dir cache &
+    pids="${pids} $!"
+done
+for pid in ${pids}; do
+    wait ${pid}
+done
+for i in 1 2 3 4; do
+    cmp rebuilt.soldout concurrent$i.soldout
+done
+[ -z "$(ls cache | grep -v '\.meta$')" ]
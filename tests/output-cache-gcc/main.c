@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+int value(void);
+
+int main() {
+    printf("%d\n", value());
+    return 0;
+}
@@ -0,0 +1,31 @@
+#! /bin/bash -eu
+
+build_lib() {
+    gcc -fPIC -shared -Wl,-soname,libvalue.so -DVALUE=$1 -o libvalue.so libvalue.c
+}
+
+build_lib 1
+gcc -Wl,--hash-style=gnu -o main.out main.c libvalue.so
+rm -rf cache
+LD_LIBRARY_PATH=. ../../build/sold main.out -o uncached.soldout --section-headers
+
+# A miss links and stores the output.
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --cache-dir cache --check-output
+grep -qx "misses 1" cache/stats
+grep -qx "hits 0" cache/stats
+cmp uncached.soldout main.soldout
+
+# A hit replaces the output with a new file instead of writing to it.
+inode=$(stat -c %i main.soldout)
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --cache-dir cache
+grep -qx "hits 1" cache/stats
+[ "$(stat -c %i main.soldout)" != "${inode}" ]
+cmp uncached.soldout main.soldout
+test "$(LD_LIBRARY_PATH=. ./main.soldout)" = 1
+
+# A changed input misses.
+build_lib 2
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --cache-dir cache
+grep -qx "misses 2" cache/stats
+grep -qx "hits 1" cache/stats
+test "$(LD_LIBRARY_PATH=. ./main.soldout)" = 2
@@ -0,0 +1,3 @@
+int max(int a, int b) {
+    return (a < b) ? b : a;
+}
@@ -0,0 +1 @@
+extern int max(int a, int b);
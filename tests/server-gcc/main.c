@@ -0,0 +1,7 @@
+#include <stdio.h>
+#include "libmax.h"
+
+int main() {
+    printf("max(1,2) = %d\n", max(1, 2));
+    return 0;
+}
@@ -0,0 +1,31 @@
+#! /bin/bash -eu
+
+gcc -fPIC -c -o libmax.o libmax.c
+gcc -Wl,--hash-style=gnu -shared -Wl,-soname,libmax.so -o libmax.so libmax.o
+gcc -Wl,--hash-style=gnu -o main.out main.c libmax.so
+mkdir -p sub
+cp main.out libmax.so sub/
+
+rm -f sold.sock
+../../build/sold --server sold.sock &
+server=$!
+trap 'kill ${server}' EXIT
+for i in $(seq 100); do [ -S sold.sock ] && break; sleep 0.1; done
+[ "$(stat -c %a sold.sock)" = 600 ]
+worker=$(cat /proc/${server}/task/${server}/children | tr -d " ")
+
+# --metadata-cache-dir is reported as ignored only by the server.
+(cd sub && LD_LIBRARY_PATH=. ../../../build/sold --connect ../sold.sock --metadata-cache-dir mdc main.out -o main.soldout --check-output 2> stderr)
+grep -q "is ignored" sub/stderr
+LD_LIBRARY_PATH=sub ./sub/main.soldout
+
+# The request must not change the working directory of the server.
+[ "$(readlink /proc/${worker}/cwd)" = "$(pwd)" ]
+
+# Errors in requests are returned to the client without killing the worker.
+(! LD_LIBRARY_PATH=. ../../build/sold --connect sold.sock --cache-size bogus main.out -o bogus.soldout)
+(! LD_LIBRARY_PATH=. ../../build/sold --connect sold.sock no-such-file -o bogus.soldout)
+[ "$(cat /proc/${server}/task/${server}/children | tr -d " ")" = "${worker}" ]
+
+LD_LIBRARY_PATH=. ../../build/sold --connect sold.sock main.out -o main.soldout --check-output
+LD_LIBRARY_PATH=. ./main.soldout
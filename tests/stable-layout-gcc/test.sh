@@ -0,0 +1,15 @@
+#! /bin/bash -eu
+
+gcc -fPIC -c -o libmax.o libmax.c
+gcc -Wl,--hash-style=gnu -shared -Wl,-soname,libmax.so -o libmax.so libmax.o
+gcc -Wl,--hash-style=gnu -o main.out main.c libmax.so
+
+rm -rf cache
+LD_LIBRARY_PATH=. ../../build/sold main.out -o stable.soldout --stable-layout --check-output
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --cache-dir cache
+(! cmp -s main.soldout stable.soldout)
+
+# The output cached without --stable-layout must not be reused with it.
+LD_LIBRARY_PATH=. ../../build/sold main.out -o cached.soldout --cache-dir cache --stable-layout
+cmp stable.soldout cached.soldout
+LD_LIBRARY_PATH=. ./cached.soldout
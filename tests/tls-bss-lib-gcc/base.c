@@ -0,0 +1,13 @@
+__thread int base_data = 5;
+__thread int shared_bss;
+// The hidden alias is accessed in the local dynamic model, whose offset is
+// remapped apart from the symbol used by main.
+extern __thread int local_bss __attribute__((alias("shared_bss"), visibility("hidden")));
+
+int base_data_value(void) {
+    return base_data;
+}
+
+int shared_bss_value(void) {
+    return local_bss;
+}
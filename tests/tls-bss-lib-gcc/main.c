@@ -0,0 +1,12 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+extern __thread int shared_bss;
+int shared_bss_value(void);
+int base_data_value(void);
+
+int main() {
+    shared_bss = 42;
+    printf("%d %d\n", shared_bss_value(), base_data_value());
+    return shared_bss_value() == 42 && base_data_value() == 5 ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+#! /bin/bash -eu
+
+gcc -fPIC -shared -Wl,-soname,libbase.so -o libbase.so base.c
+gcc -Wl,--hash-style=gnu -o main.out main.c libbase.so
+
+LD_LIBRARY_PATH=. ../../build/sold main.out -o main.soldout --section-headers --check-output
+./main.soldout
@@ -0,0 +1,10 @@
+#include "base.h"
+
+__thread int base_i = 3;
+__thread int base_j;
+
+static __thread int base_local = 5;
+
+int base_local_value() {
+    return base_local++;
+}
@@ -0,0 +1,4 @@
+extern __thread int base_i;
+extern __thread int base_j;
+
+int base_local_value();
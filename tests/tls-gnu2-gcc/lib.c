@@ -0,0 +1,9 @@
+#include "lib.h"
+
+static __thread int lib_local = 7;
+static __thread int lib_local_bss;
+
+int lib_value() {
+    lib_local_bss += base_i;
+    return lib_local + lib_local_bss + base_j + base_local_value();
+}
@@ -0,0 +1,14 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lib.h"
+
+int main() {
+    base_j = 11;
+    // 7 + 3 + 11 + 5
+    if (lib_value() != 26) abort();
+    // 7 + 6 + 11 + 6
+    if (lib_value() != 30) abort();
+    puts("OK");
+    return 0;
+}
@@ -0,0 +1,15 @@
+#! /bin/bash -eu
+
+# Accesses to TLS variables with -mtls-dialect=gnu2 use R_X86_64_TLSDESC
+# relocations in both generic and local dynamic models.
+gcc -fPIC -mtls-dialect=gnu2 -c -o lib.o lib.c
+gcc -fPIC -mtls-dialect=gnu2 -c -o base.o base.c
+gcc -Wl,--hash-style=gnu -shared -Wl,-soname,base.so -o base.so base.o
+gcc -Wl,--hash-style=gnu -shared -Wl,-soname,lib.so -o lib.so lib.o base.so
+
+mkdir -p sold_out
+LD_LIBRARY_PATH=. ../../build/sold lib.so -o sold_out/lib.so --section-headers --check-output
+readelf -r sold_out/lib.so | grep -q R_X86_64_TLSDESC
+
+gcc -Wl,--hash-style=gnu -o main.out main.c sold_out/lib.so
+LD_LIBRARY_PATH=sold_out ./main.out
@@ -50,6 +50,9 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "utils.h"
+#include <unistd.h>
+
+#include <atomic>
 #include <iomanip>
 
 std::vector<std::string> SplitString(const std::string& str, const std::string& sep) {
@@ -70,6 +73,11 @@ bool HasPrefix(const std::string& str, const std::string& prefix) {
     return size_diff >= 0 && str.substr(0, prefix.size()) == prefix;
 }
 
+std::string TempSuffix() {
+    static std::atomic<uint64_t> counter{0};
+    return ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+}
+
 uintptr_t AlignNext(uintptr_t a, uintptr_t mask) {
     return (a + mask) & ~mask;
 }
@@ -84,9 +92,9 @@ void EmitZeros(FILE* fp, uintptr_t cnt) {
 }
 
 void EmitPad(FILE* fp, uintptr_t to) {
-    uint pos = ftell(fp);
+    long pos = ftell(fp);
     CHECK_GE(pos, 0);
-    CHECK_LE(pos, to);
+    CHECK_LE(static_cast<uintptr_t>(pos), to);
     EmitZeros(fp, to - pos);
 }
 
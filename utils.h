@@ -133,6 +133,10 @@ std::vector<std::string> SplitString(const std::string& str, const std::string&
 
 bool HasPrefix(const std::string& str, const std::string& prefix);
 
+// TempSuffix returns a suffix for temporary files which is unique among
+// threads and processes, e.g., ".tmp.1234.5".
+std::string TempSuffix();
+
 template <class T>
 void Write(FILE* fp, const T& v) {
     CHECK(fwrite(&v, sizeof(v), 1, fp) == 1);
@@ -163,6 +167,8 @@ struct Syminfo {
     std::string version;
     Elf_Versym versym;
     Elf_Sym* sym;
+    // GnuHashKey of name.
+    uint32_t gnu_hash{0};
 };
 
 std::string ShowDynamicEntryType(int type);
@@ -207,6 +213,10 @@ struct EHFrameHeader {
         uint64_t extended_length;
         int32_t CIE_delta;
         int32_t initial_loc;
+        // Decoded with the encoding in the CIE.
+        uint64_t pc_range;
+        // The index of the CIE of this FDE in `cies`.
+        uint32_t cie_index;
     };
 
     uint8_t version;
@@ -216,9 +226,13 @@ struct EHFrameHeader {
 
     int32_t eh_frame_ptr;
     uint32_t fde_count;
+    // The address which the table is relative to: the address of
+    // .eh_frame_hdr, or 0 when the table is built from .eh_frame.
+    Elf_Addr table_base;
 
     std::vector<FDETableEntry> table;
     std::vector<FDE> fdes;
+    // Thousands of FDEs share a few CIEs, so each CIE is kept once.
     std::vector<CIE> cies;
 };
 
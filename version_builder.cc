@@ -77,6 +77,14 @@ void VersionBuilder::EmitVersym(FILE* fp) {
 }
 
 void VersionBuilder::EmitVerneed(FILE* fp, StrtabBuilder& strtab) {
+    std::vector<std::string_view> names;
+    for (const auto& m1 : data) {
+        for (const auto& m2 : m1.second) names.push_back(m2.first);
+    }
+    std::vector<uint32_t> hashes(names.size());
+    CalcHashes(names.data(), names.size(), hashes.data());
+
+    size_t n_names = 0;
     int n_verneed = 0;
     for (const auto& m1 : data) {
         n_verneed++;
@@ -95,7 +103,7 @@ void VersionBuilder::EmitVerneed(FILE* fp, StrtabBuilder& strtab) {
             n_vernaux++;
 
             Elf_Vernaux a;
-            a.vna_hash = CalcHash(m2.first);
+            a.vna_hash = hashes[n_names++];
             a.vna_flags = VER_FLG_WEAK;
             a.vna_other = m2.second;
             a.vna_name = strtab.GetPos(m2.first);